@@ -0,0 +1,573 @@
+#include "batch.h"
+
+#include <geogram/basic/process.h>
+#include <geogram/mesh/mesh.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "io.h"
+#include "matfp/geogram/RPD.h"
+#include "medial_sphere.h"
+#include "params.h"
+#include "profiler.h"
+#include "shrinking.h"
+#include "triangulation.h"
+
+namespace {
+
+// Wall time and memory of one pipeline phase
+struct PhaseRecord {
+  std::string name;
+  double seconds = 0.;
+  double rss_mb = 0.;       // resident set size at the end of the phase
+  double peak_rss_mb = 0.;  // process peak so far
+};
+
+double current_rss_mb() {
+  long pages = 0, resident = 0;
+  FILE* f = fopen("/proc/self/statm", "r");
+  if (f == nullptr) return 0.;
+  if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+  fclose(f);
+  return double(resident) * double(sysconf(_SC_PAGESIZE)) / (1024. * 1024.);
+}
+
+double peak_rss_mb() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.;
+  return double(usage.ru_maxrss) / 1024.;  // KB on Linux
+}
+
+/**
+ * @brief Times consecutive phases, start() ends the previous one.
+ */
+class PhaseTimer {
+ public:
+  void start(const std::string& name) {
+    stop();
+    current_ = name;
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  void stop() {
+    if (current_.empty()) return;
+    PhaseRecord record;
+    record.name = current_;
+    record.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start_)
+                         .count();
+    record.rss_mb = current_rss_mb();
+    record.peak_rss_mb = peak_rss_mb();
+    printf("[batch] %-10s %9.3fs, rss %.1f MB, peak %.1f MB\n",
+           record.name.c_str(), record.seconds, record.rss_mb,
+           record.peak_rss_mb);
+    records_.push_back(record);
+    current_.clear();
+  }
+
+  const std::vector<PhaseRecord>& records() const { return records_; }
+
+ private:
+  std::string current_;
+  std::chrono::steady_clock::time_point start_;
+  std::vector<PhaseRecord> records_;
+};
+
+bool parse_bool(const std::string& value, bool& result) {
+  if (value == "1" || value == "true" || value == "on") {
+    result = true;
+    return true;
+  }
+  if (value == "0" || value == "false" || value == "off") {
+    result = false;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Sets one option given its key (long option without "--").
+ */
+bool set_batch_option(const std::string& key, const std::string& value,
+                      BatchOptions& options);
+
+bool load_batch_config(const std::string& path, BatchOptions& options) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    printf("[batch] cannot open config %s\n", path.c_str());
+    return false;
+  }
+  std::string line;
+  int line_no = 0;
+  while (std::getline(file, line)) {
+    line_no++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) line.erase(hash);
+    size_t eq = line.find('=');
+    std::istringstream key_ss(line.substr(0, eq));
+    std::string key, value;
+    key_ss >> key;
+    if (key.empty()) continue;
+    if (eq != std::string::npos) {
+      std::istringstream value_ss(line.substr(eq + 1));
+      value_ss >> value;
+    }
+    if (eq == std::string::npos || key == "config" ||
+        !set_batch_option(key, value, options)) {
+      printf("[batch] %s:%d: invalid line\n", path.c_str(), line_no);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool set_batch_option(const std::string& key, const std::string& value,
+                      BatchOptions& options) {
+  if (key == "input") {
+    options.input_path = value;
+  } else if (key == "spheres") {
+    options.spheres_path = value;
+  } else if (key == "sphere-type") {
+    return parse_bool(value, options.is_load_type);
+  } else if (key == "out") {
+    options.output_prefix = value;
+  } else if (key == "summary") {
+    options.summary_path = value;
+  } else if (key == "trace") {
+    options.trace_path = value;
+  } else if (key == "threads") {
+    options.nb_threads = std::atoi(value.c_str());
+  } else if (key == "parallel") {
+    return parse_bool(value, options.is_parallel_rpd);
+  } else if (key == "check-sr") {
+    return parse_bool(value, options.is_check_SR);
+  } else if (key == "precision") {
+    if (value == "exact")
+      options.precision = matfp::RPD_EXACT;
+    else if (value == "filtered")
+      options.precision = matfp::RPD_FILTERED;
+    else if (value == "fast")
+      options.precision = matfp::RPD_FAST;
+    else
+      return false;
+  } else if (key == "validate-precision") {
+    return parse_bool(value, options.is_validate_precision);
+  } else if (key == "validate-load") {
+    return parse_bool(value, options.is_validate_load);
+  } else if (key == "volumetric") {
+    return parse_bool(value, options.is_volumetric);
+  } else if (key == "refine") {
+    options.nb_refine_rounds = std::atoi(value.c_str());
+  } else if (key == "rpd-stream") {
+    options.rpd_stream_path = value;
+  } else if (key == "config") {
+    return load_batch_config(value, options);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Sets the 8 bbox points of params from the surface bbox,
+ * as load_tet() does for tet meshes.
+ */
+void set_bbox_from_mesh(const GEO::Mesh& sf_mesh, Parameter& params) {
+  std::vector<float> vertices(3 * sf_mesh.vertices.nb());
+  for (GEO::index_t v = 0; v < sf_mesh.vertices.nb(); v++) {
+    const double* p = sf_mesh.vertices.point_ptr(v);
+    for (int j = 0; j < 3; j++) vertices[3 * v + j] = p[j];
+  }
+  float xmin, ymin, zmin, xmax, ymax, zmax;
+  get_bbox(vertices, xmin, ymin, zmin, xmax, ymax, zmax, params.bbox_diag_l);
+  params.bb_points.clear();
+  for (int i = 0; i < 8; i++) {
+    params.bb_points.push_back((i & 1) ? xmax : xmin);
+    params.bb_points.push_back((i & 2) ? ymax : ymin);
+    params.bb_points.push_back((i & 4) ? zmax : zmin);
+  }
+}
+
+/**
+ * @brief Loads the surface mesh, and the tets too if tet_mesh is not null.
+ */
+bool load_input(const std::string& path, GEO::Mesh& sf_mesh,
+                Parameter& params, GEO::Mesh* tet_mesh = nullptr) {
+  std::string ext = get_file_ext(path);
+  if (ext != "tet" && ext != "vtk") {
+    if (tet_mesh != nullptr) {
+      printf("[batch] %s: not a tet mesh\n", path.c_str());
+      return false;
+    }
+    if (!load_surface_mesh(path, sf_mesh)) return false;
+    set_bbox_from_mesh(sf_mesh, params);
+    return true;
+  }
+  std::vector<float> tet_vertices;
+  std::vector<int> tet_indices;
+  if (!load_tet(path, tet_vertices, tet_indices, true /*normalize*/, params))
+    return false;
+  std::vector<std::array<float, 3>> sf_vertices;
+  std::vector<std::array<int, 3>> sf_faces;
+  std::vector<int> sf_vs_2_tet_vs;
+  get_surface_from_tet(tet_vertices, tet_indices, sf_vertices, sf_faces,
+                       sf_vs_2_tet_vs);
+  load_sf_mesh_from_internal(sf_vertices, sf_faces, sf_vs_2_tet_vs, sf_mesh);
+  if (tet_mesh != nullptr)
+    load_tet_mesh_from_internal(tet_vertices, tet_indices, *tet_mesh);
+  return true;
+}
+
+/**
+ * @brief Pins at the centroids of the RPD polygons larger than
+ * REFINE_AREA_RATIO times the average one, where spheres are sparse.
+ */
+const double REFINE_AREA_RATIO = 4.;
+
+void get_refine_pins(const GEO::Mesh& sf_mesh, GEO::Mesh& rpd_mesh,
+                     std::vector<Vector3>& pins,
+                     std::vector<Vector3>& pin_normals,
+                     std::vector<int>& pin_fids) {
+  pins.clear();
+  pin_normals.clear();
+  pin_fids.clear();
+  if (rpd_mesh.facets.nb() == 0) return;
+  std::vector<double> areas(rpd_mesh.facets.nb());
+  double total = 0.;
+  for (GEO::index_t f = 0; f < rpd_mesh.facets.nb(); f++) {
+    areas[f] = GEO::Geom::mesh_facet_area(rpd_mesh, f);
+    total += areas[f];
+  }
+  const double min_area = REFINE_AREA_RATIO * total / areas.size();
+  GEO::Attribute<GEO::index_t> ref_facet(rpd_mesh.facets.attributes(),
+                                         "ref_facet");
+  for (GEO::index_t f = 0; f < rpd_mesh.facets.nb(); f++) {
+    if (areas[f] <= min_area) continue;
+    pins.push_back(GEO::Geom::mesh_facet_center(rpd_mesh, f));
+    pin_normals.push_back(get_mesh_facet_normal(sf_mesh, ref_facet[f]));
+    pin_fids.push_back(ref_facet[f]);
+  }
+}
+
+/**
+ * @brief Saves the non-empty volumetric RPD cells, one line per seed:
+ * "seed volume cx cy cz nb_adj adj_seed...", after a header line with
+ * the number of cells.
+ */
+bool save_rpd_cells(const std::string& path,
+                    const matfp::RPDVolumetricCells& cells) {
+  FILE* f = fopen(path.c_str(), "w");
+  if (f == nullptr) {
+    printf("[batch] cannot open cells %s\n", path.c_str());
+    return false;
+  }
+  fprintf(f, "%u\n", cells.nb_cells());
+  for (GEO::index_t seed = 0; seed < cells.volumes.size(); seed++) {
+    if (cells.volumes[seed] <= 0.) continue;
+    const GEO::vec3& c = cells.centroids[seed];
+    fprintf(f, "%u %.10g %.10g %.10g %.10g", seed, cells.volumes[seed], c.x,
+            c.y, c.z);
+    auto it = cells.seed_adj.find(seed);
+    if (it == cells.seed_adj.end()) {
+      fprintf(f, " 0\n");
+      continue;
+    }
+    fprintf(f, " %zu", it->second.size());
+    for (GEO::index_t adj : it->second) fprintf(f, " %u", adj);
+    fprintf(f, "\n");
+  }
+  bool ok = ferror(f) == 0;
+  ok = (fclose(f) == 0) && ok;
+  if (ok) printf("[batch] saved cells %s\n", path.c_str());
+  return ok;
+}
+
+// JSON string literal of s (quotes, backslashes and control characters)
+std::string json_string(const std::string& s) {
+  std::string out = "\"";
+  for (const char c : s) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if ((unsigned char)c < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+          out += buf;
+        } else {
+          out += c;
+        }
+    }
+  }
+  return out + "\"";
+}
+
+// rpd_cells is null if the volumetric RPD was not computed
+bool save_summary(const std::string& path, const BatchOptions& options,
+                  const GEO::Mesh& sf_mesh, size_t nb_spheres,
+                  size_t nb_rpd_facets,
+                  const matfp::RPDVolumetricCells* rpd_cells,
+                  const std::vector<PhaseRecord>& records) {
+  FILE* f = fopen(path.c_str(), "w");
+  if (f == nullptr) {
+    printf("[batch] cannot open summary %s\n", path.c_str());
+    return false;
+  }
+  double total = 0.;
+  for (const PhaseRecord& r : records) total += r.seconds;
+  fprintf(f, "{\n");
+  fprintf(f, "  \"input\": %s,\n", json_string(options.input_path).c_str());
+  fprintf(f, "  \"spheres\": %s,\n",
+          json_string(options.spheres_path).c_str());
+  fprintf(f, "  \"nb_threads\": %u,\n",
+          GEO::Process::maximum_concurrent_threads());
+  fprintf(f, "  \"nb_sf_facets\": %u,\n", sf_mesh.facets.nb());
+  fprintf(f, "  \"nb_spheres\": %zu,\n", nb_spheres);
+  fprintf(f, "  \"nb_rpd_facets\": %zu,\n", nb_rpd_facets);
+  if (rpd_cells != nullptr) {
+    fprintf(f, "  \"nb_rpd_cells\": %u,\n", rpd_cells->nb_cells());
+    fprintf(f, "  \"nb_rpd_polyhedra\": %u,\n", rpd_cells->nb_polyhedra);
+    fprintf(f, "  \"rpd_cells_volume\": %.10g,\n",
+            rpd_cells->total_volume());
+  }
+  fprintf(f, "  \"total_seconds\": %.6f,\n", total);
+  fprintf(f, "  \"peak_rss_mb\": %.3f,\n", peak_rss_mb());
+  fprintf(f, "  \"phases\": [\n");
+  for (size_t i = 0; i < records.size(); i++) {
+    const PhaseRecord& r = records[i];
+    fprintf(f,
+            "    {\"name\": %s, \"seconds\": %.6f, \"rss_mb\": %.3f, "
+            "\"peak_rss_mb\": %.3f}%s\n",
+            json_string(r.name).c_str(), r.seconds, r.rss_mb, r.peak_rss_mb,
+            i + 1 < records.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  bool ok = ferror(f) == 0;
+  ok = (fclose(f) == 0) && ok;
+  if (!ok) {
+    printf("[batch] cannot write summary %s\n", path.c_str());
+    return false;
+  }
+  printf("[batch] saved summary %s\n", path.c_str());
+  return true;
+}
+
+}  // namespace
+
+void print_batch_usage(const char* exe) {
+  printf("Usage: %s --headless [options] [<input mesh>]\n", exe);
+  printf("  --input <file>       surface mesh, or tet mesh (.tet/.vtk)\n");
+  printf("  --spheres <file>     medial spheres (.sph or .sphb), default: "
+         "shrinking balls from all surface facets\n");
+  printf("  --sphere-type <0|1>  spheres file has a type column\n");
+  printf("  --out <prefix>       writes <prefix>_rpd.geogram, "
+         "<prefix>_spheres.sph and <prefix>_cells.txt (volumetric)\n");
+  printf("  --summary <file>     timing/memory JSON "
+         "(default <prefix>_summary.json)\n");
+  printf("  --trace <file>       Chrome trace JSON (RPD_PROFILING builds)\n");
+  printf("  --threads <n>        number of threads (default all)\n");
+  printf("  --parallel <0|1>     parallel RPD (default 1)\n");
+  printf("  --check-sr <0|1>     radius of security (default 0)\n");
+  printf("  --precision <p>      exact, filtered or fast (default exact)\n");
+  printf("  --validate-precision <0|1>  compares RPD with exact "
+         "(default 0)\n");
+  printf("  --validate-load <0|1>  compares .tet/.vtk parsing with "
+         "std::ifstream (default 0)\n");
+  printf("  --volumetric <0|1>   volumetric RPD cells too, tet mesh input "
+         "only (default 0)\n");
+  printf("  --refine <n>         rounds of shrinking balls at large RPD "
+         "polygons, RT/RPD updated incrementally (default 0)\n");
+  printf("  --rpd-stream <file>  streams RPD polygons to a .rpdb file, "
+         "no RPD mesh is built\n");
+  printf("  --config <file>      'key = value' lines, keys as above\n");
+}
+
+bool parse_batch_options(int argc, char** argv, BatchOptions& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--headless") continue;
+    if (arg.compare(0, 2, "--") != 0) {
+      options.input_path = arg;
+      continue;
+    }
+    if (i + 1 >= argc ||
+        !set_batch_option(arg.substr(2), argv[i + 1], options)) {
+      printf("[batch] invalid argument %s\n", arg.c_str());
+      return false;
+    }
+    i++;
+  }
+  if (options.input_path.empty()) {
+    printf("[batch] --input is required\n");
+    return false;
+  }
+  return true;
+}
+
+int run_batch(const BatchOptions& options) {
+  if (options.nb_threads > 0)
+    GEO::Process::set_max_threads(GEO::index_t(options.nb_threads));
+
+  PhaseTimer timer;
+  GEO::Mesh sf_mesh, tet_mesh;
+  Parameter params;
+  timer.start("load");
+  if (options.is_validate_load && !validate_load_tet(options.input_path))
+    return 1;
+  if (!load_input(options.input_path, sf_mesh, params,
+                  options.is_volumetric ? &tet_mesh : nullptr)) {
+    printf("[batch] %s: could not load input\n", options.input_path.c_str());
+    return 1;
+  }
+
+  timer.start("spheres");
+  std::vector<MedialSphere> all_medial_spheres;
+  // sf_mesh is not reordered, facet ids must match the loaded mesh
+  AABBWrapper aabb_wrapper;
+  SphereSpatialHash sphere_hash;
+  const bool is_refine =
+      options.nb_refine_rounds > 0 && options.rpd_stream_path.empty();
+  if (options.spheres_path.empty() || is_refine)
+    aabb_wrapper.init_sf_mesh_and_tree(sf_mesh, false /*is_reorder*/);
+  if (!options.spheres_path.empty()) {
+    load_spheres_from_file(options.spheres_path.c_str(), all_medial_spheres,
+                           options.is_load_type);
+  } else {
+    std::vector<Vector3> pins, pin_normals;
+    std::vector<int> pin_fids;
+    get_facet_pins(sf_mesh, pins, pin_normals, pin_fids);
+    shrink_spheres(sf_mesh, aabb_wrapper, pins, pin_normals, pin_fids,
+                   all_medial_spheres, sphere_hash);
+  }
+  if (all_medial_spheres.empty()) {
+    printf("[batch] %s: no spheres\n", options.spheres_path.c_str());
+    return 1;
+  }
+
+  timer.start("rt");
+  RegularTriangulationNN_var rt = new RegularTriangulationNN();
+  generate_RT_CGAL_and_purge_spheres(params, all_medial_spheres, *rt);
+
+  matfp::RestrictedPowerDiagram_var rpd =
+      matfp::RestrictedPowerDiagram::create(rt.get(), &sf_mesh);
+  rpd->set_check_SR(options.is_check_SR);
+  rpd->set_keep_vertex_keys(is_refine);
+  matfp::RPDPrecision precision = matfp::RPDPrecision(options.precision);
+  if (options.is_validate_precision && precision != matfp::RPD_EXACT) {
+    timer.start("validate");
+    matfp::validate_RPD_precision(rpd.get(), precision,
+                                  options.is_parallel_rpd)
+        .print();
+  }
+
+  timer.start("rpd");
+  GEO::Mesh rpd_mesh;
+  std::map<GEO::index_t, std::set<GEO::index_t>> rpd_seed_adj;
+  std::map<GEO::index_t, std::set<GEO::index_t>> rpd_vs_bisectors;
+  size_t nb_rpd_facets = 0;
+  rpd->set_precision(precision);
+  if (!options.rpd_stream_path.empty()) {
+    // peak memory does not depend on the size of the RPD
+    matfp::RPDBinaryFileSink rpd_sink(options.rpd_stream_path);
+    rpd->compute_RPD_streaming(rpd_sink, options.is_parallel_rpd);
+    if (!rpd_sink.ok()) return 1;
+    nb_rpd_facets = size_t(rpd_sink.nb_polygons());
+  } else {
+    rpd->compute_RPD(rpd_mesh, &rpd_seed_adj, &rpd_vs_bisectors, 0, false,
+                     false, options.is_parallel_rpd);
+    nb_rpd_facets = rpd_mesh.facets.nb();
+  }
+
+  // spheres are only appended, RT and RPD are updated where they changed
+  if (options.nb_refine_rounds > 0 && !is_refine)
+    printf("[batch] --refine is ignored with --rpd-stream\n");
+  if (is_refine) sphere_hash.build(all_medial_spheres);
+  for (int round = 1; is_refine && round <= options.nb_refine_rounds;
+       round++) {
+    timer.start("refine " + std::to_string(round));
+    std::vector<Vector3> pins, pin_normals;
+    std::vector<int> pin_fids;
+    get_refine_pins(sf_mesh, rpd_mesh, pins, pin_normals, pin_fids);
+    const int nb_old = all_medial_spheres.size();
+    shrink_spheres(sf_mesh, aabb_wrapper, pins, pin_normals, pin_fids,
+                   all_medial_spheres, sphere_hash);
+    if ((int)all_medial_spheres.size() == nb_old) break;
+    std::vector<int> changed_ids;
+    for (int id = nb_old; id < (int)all_medial_spheres.size(); id++)
+      changed_ids.push_back(id);
+    std::set<int> changed_tags;
+    update_RT_CGAL_incremental(all_medial_spheres, changed_ids, *rt,
+                               changed_tags);
+    rpd->compute_RPD_incremental(rpd_mesh, &rpd_seed_adj, &rpd_vs_bisectors,
+                                 changed_tags);
+    nb_rpd_facets = rpd_mesh.facets.nb();
+  }
+
+  matfp::RPDVolumetricCells rpd_cells;
+  if (options.is_volumetric) {
+    timer.start("rpd volume");
+    matfp::RestrictedPowerDiagram_var rpd_volume =
+        matfp::RestrictedPowerDiagram::create(rt.get(), &tet_mesh);
+    rpd_volume->set_volumetric(true);
+    rpd_volume->set_check_SR(options.is_check_SR);
+    rpd_volume->set_precision(precision);
+    rpd_volume->compute_RPD_volumetric(rpd_cells, options.is_parallel_rpd);
+  }
+
+  if (!options.output_prefix.empty()) {
+    timer.start("output");
+    if (options.rpd_stream_path.empty())
+      save_sf_mesh_geogram(options.output_prefix + "_rpd.geogram", rpd_mesh);
+    std::string sphere_path = options.output_prefix + "_spheres.sph";
+    // spheres hidden by refine rounds are kept in all_medial_spheres
+    if (!save_spheres_sph(all_medial_spheres, sphere_path,
+                          options.is_load_type, true /*is_skip_deleted*/)) {
+      printf("[batch] cannot save spheres %s\n", sphere_path.c_str());
+      return 1;
+    }
+    if (options.is_volumetric &&
+        !save_rpd_cells(options.output_prefix + "_cells.txt", rpd_cells))
+      return 1;
+  }
+  timer.stop();
+
+  if (!options.trace_path.empty()) {
+    profiler::print_summary();
+    profiler::write_chrome_trace(options.trace_path);
+  }
+
+  size_t nb_spheres = 0;
+  for (const MedialSphere& msphere : all_medial_spheres)
+    if (!msphere.is_deleted) nb_spheres++;
+  std::string summary_path = options.summary_path;
+  if (summary_path.empty() && !options.output_prefix.empty())
+    summary_path = options.output_prefix + "_summary.json";
+  if (!summary_path.empty() &&
+      !save_summary(summary_path, options, sf_mesh, nb_spheres, nb_rpd_facets,
+                    options.is_volumetric ? &rpd_cells : nullptr,
+                    timer.records()))
+    return 1;
+  return 0;
+}
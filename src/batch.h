@@ -0,0 +1,47 @@
+#ifndef H_BATCH_H
+#define H_BATCH_H
+
+#include <string>
+#include <vector>
+
+// Options of the headless pipeline, from command line and/or config file
+struct BatchOptions {
+  std::string input_path;    // surface mesh, or tet mesh (.tet/.vtk)
+  std::string spheres_path;  // .sph text, or .sphb binary (sphere_file.h),
+                             // empty: shrinking balls (shrinking.h)
+  bool is_load_type = false;     // spheres file has a type column
+  std::string output_prefix;     // empty: no output files
+  std::string summary_path;      // empty: <output_prefix>_summary.json
+  std::string trace_path;        // Chrome trace, needs RPD_PROFILING
+  int nb_threads = 0;            // 0: all cores
+  bool is_parallel_rpd = true;
+  bool is_check_SR = false;
+  int precision = 0;  // matfp::RPDPrecision: 0 exact, 1 filtered, 2 fast
+  bool is_validate_precision = false;  // compares precision with exact
+  bool is_validate_load = false;  // compares .tet/.vtk parsing with ifstream
+  bool is_volumetric = false;  // volumetric RPD too, needs a tet mesh
+  int nb_refine_rounds = 0;  // RT and RPD updated incrementally
+  std::string rpd_stream_path;  // .rpdb, streams the RPD instead of
+                                // building its mesh (RPD_polygon_sink.h)
+};
+
+/**
+ * @brief Parses command line arguments of headless mode, a config file
+ * (--config) holds "key = value" lines with the same keys as the
+ * long options without "--". Later arguments override earlier ones.
+ *
+ * @return false on unknown or malformed arguments
+ */
+bool parse_batch_options(int argc, char** argv, BatchOptions& options);
+
+void print_batch_usage(const char* exe);
+
+/**
+ * @brief Runs load -> spheres -> RT -> RPD -> outputs without any GUI and
+ * writes the wall time and memory of each phase as JSON.
+ *
+ * @return 0 on success, as main()
+ */
+int run_batch(const BatchOptions& options);
+
+#endif  // H_BATCH_H
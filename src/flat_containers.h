@@ -0,0 +1,358 @@
+#ifndef H_FLAT_CONTAINERS_H
+#define H_FLAT_CONTAINERS_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Sorted-vector / CSR containers used by PowerCell, in place of std::map and
+// std::set of small nodes. clear() keeps capacity, so containers reused
+// across iterations stop allocating once warm.
+//
+// Multi-maps and groups are filled in bulk and sorted once, by finalize()
+// or lazily by the first query after an add. A container being filled must
+// not be queried from several threads before finalize(). Values of non-set
+// containers (IS_SET false) need no operator<, e.g. v2int.
+
+// Contiguous read-only range
+template <class T>
+class FlatSpan {
+ public:
+  FlatSpan() : begin_(nullptr), end_(nullptr) {}
+  FlatSpan(const T* b, const T* e) : begin_(b), end_(e) {}
+  const T* begin() const { return begin_; }
+  const T* end() const { return end_; }
+  size_t size() const { return end_ - begin_; }
+  bool empty() const { return begin_ == end_; }
+  const T& operator[](size_t i) const { return begin_[i]; }
+  // only for sorted spans (sets)
+  bool contains(const T& x) const {
+    return std::binary_search(begin_, end_, x);
+  }
+
+ private:
+  const T* begin_;
+  const T* end_;
+};
+
+/**
+ * @brief Sorted unique values (std::set).
+ */
+template <class T>
+class FlatSet {
+ public:
+  typedef typename std::vector<T>::const_iterator const_iterator;
+
+  bool insert(const T& x) {
+    auto it = std::lower_bound(values_.begin(), values_.end(), x);
+    if (it != values_.end() && !(x < *it)) return false;
+    values_.insert(it, x);
+    return true;
+  }
+  // bulk: one sort for all values
+  template <class IT>
+  void insert(IT first, IT last) {
+    values_.insert(values_.end(), first, last);
+    std::sort(values_.begin(), values_.end());
+    values_.erase(std::unique(values_.begin(), values_.end()), values_.end());
+  }
+  bool erase(const T& x) {
+    auto it = std::lower_bound(values_.begin(), values_.end(), x);
+    if (it == values_.end() || x < *it) return false;
+    values_.erase(it);
+    return true;
+  }
+  bool contains(const T& x) const {
+    return std::binary_search(values_.begin(), values_.end(), x);
+  }
+  size_t count(const T& x) const { return contains(x) ? 1 : 0; }
+  size_t size() const { return values_.size(); }
+  bool empty() const { return values_.empty(); }
+  void clear() { values_.clear(); }
+  const_iterator begin() const { return values_.begin(); }
+  const_iterator end() const { return values_.end(); }
+  bool operator==(const FlatSet& rhs) const { return values_ == rhs.values_; }
+  bool operator!=(const FlatSet& rhs) const { return values_ != rhs.values_; }
+
+ private:
+  std::vector<T> values_;
+};
+
+/**
+ * @brief Sorted (key, value) pairs with unique keys (std::map).
+ */
+template <class K, class V>
+class FlatMap {
+ public:
+  typedef std::pair<K, V> value_type;
+  typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+  V& operator[](const K& k) {
+    auto it = lower_bound(k);
+    if (it == data_.end() || k < it->first)
+      it = data_.insert(it, value_type(k, V()));
+    return it->second;
+  }
+  const V* find(const K& k) const {
+    auto it = std::lower_bound(
+        data_.begin(), data_.end(), k,
+        [](const value_type& a, const K& b) { return a.first < b; });
+    return (it == data_.end() || k < it->first) ? nullptr : &it->second;
+  }
+  bool contains(const K& k) const { return find(k) != nullptr; }
+  size_t count(const K& k) const { return contains(k) ? 1 : 0; }
+
+  /**
+   * @brief Sets all keys of [first, last) to v, one sort for all keys.
+   */
+  template <class IT>
+  void assign(IT first, IT last, const V& v) {
+    size_t n = data_.size();
+    for (IT it = first; it != last; ++it) data_.push_back(value_type(*it, v));
+    // new values first among equal keys, so that they win
+    std::rotate(data_.begin(), data_.begin() + n, data_.end());
+    std::stable_sort(
+        data_.begin(), data_.end(),
+        [](const value_type& a, const value_type& b) {
+          return a.first < b.first;
+        });
+    data_.erase(std::unique(data_.begin(), data_.end(),
+                            [](const value_type& a, const value_type& b) {
+                              return !(a.first < b.first) &&
+                                     !(b.first < a.first);
+                            }),
+                data_.end());
+  }
+
+  size_t size() const { return data_.size(); }
+  bool empty() const { return data_.empty(); }
+  void clear() { data_.clear(); }
+  const_iterator begin() const { return data_.begin(); }
+  const_iterator end() const { return data_.end(); }
+
+ private:
+  typename std::vector<value_type>::iterator lower_bound(const K& k) {
+    return std::lower_bound(
+        data_.begin(), data_.end(), k,
+        [](const value_type& a, const K& b) { return a.first < b; });
+  }
+
+  std::vector<value_type> data_;
+};
+
+/**
+ * @brief CSR key -> values (std::map<K, std::set<V>> if IS_SET, else
+ * std::map<K, std::vector<V>> with values in insertion order).
+ */
+template <class K, class V, bool IS_SET = true>
+class FlatMultiMap {
+ public:
+  void add(const K& k, const V& v) {
+    staged_.push_back(std::make_pair(k, v));
+    is_final_ = false;
+  }
+
+  // sorts staged pairs and builds the CSR arrays, staged pairs are kept so
+  // that add() can continue after finalize()
+  void finalize() { build(); }
+
+  FlatSpan<V> at(const K& k) const {
+    if (!is_final_) build();
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), k);
+    if (it == keys_.end() || k < *it) return FlatSpan<V>();
+    return values(it - keys_.begin());
+  }
+  bool contains(const K& k) const { return !at(k).empty(); }
+  bool contains(const K& k, const V& v) const { return at(k).contains(v); }
+
+  size_t nb_keys() const {
+    if (!is_final_) build();
+    return keys_.size();
+  }
+  const K& key(size_t i) const {
+    if (!is_final_) build();
+    return keys_[i];
+  }
+  FlatSpan<V> values(size_t i) const {
+    if (!is_final_) build();
+    return FlatSpan<V>(values_.data() + offsets_[i],
+                       values_.data() + offsets_[i + 1]);
+  }
+
+  void clear() {
+    staged_.clear();
+    keys_.clear();
+    offsets_.clear();
+    values_.clear();
+    is_final_ = true;
+  }
+
+ private:
+  void build() const {
+    if constexpr (IS_SET) {
+      std::sort(staged_.begin(), staged_.end(), less_pair);
+      staged_.erase(std::unique(staged_.begin(), staged_.end()),
+                    staged_.end());
+    } else {
+      std::stable_sort(staged_.begin(), staged_.end(), less_key);
+    }
+    keys_.clear();
+    offsets_.clear();
+    values_.clear();
+    values_.reserve(staged_.size());
+    for (const auto& kv : staged_) {
+      if (keys_.empty() || keys_.back() < kv.first) {
+        keys_.push_back(kv.first);
+        offsets_.push_back(values_.size());
+      }
+      values_.push_back(kv.second);
+    }
+    offsets_.push_back(values_.size());
+    is_final_ = true;
+  }
+
+  static bool less_key(const std::pair<K, V>& a, const std::pair<K, V>& b) {
+    return a.first < b.first;
+  }
+  static bool less_pair(const std::pair<K, V>& a, const std::pair<K, V>& b) {
+    return a.first < b.first || (!(b.first < a.first) && a.second < b.second);
+  }
+
+  // built by the first query after add(), hence mutable
+  mutable std::vector<std::pair<K, V>> staged_;
+  mutable std::vector<K> keys_;
+  mutable std::vector<std::uint32_t> offsets_;
+  mutable std::vector<V> values_;
+  mutable bool is_final_ = true;
+};
+
+/**
+ * @brief CSR list of groups (std::vector<std::set<V>> if IS_SET, else
+ * std::vector<std::vector<V>>).
+ */
+template <class V, bool IS_SET = true>
+class FlatGroups {
+ public:
+  FlatGroups() : offsets_(1, 0) {}
+
+  // starts a new group, add() appends to it
+  void new_group() {
+    offsets_.push_back(values_.size());
+    is_final_ = false;
+  }
+  void add(const V& v) {
+    assert(offsets_.size() > 1);
+    values_.push_back(v);
+    offsets_.back() = values_.size();
+    is_final_ = false;
+  }
+
+  // sorts and dedups values of each group (IS_SET only)
+  void finalize() { build(); }
+
+  size_t size() const { return offsets_.size() - 1; }
+  bool empty() const { return size() == 0; }
+  FlatSpan<V> operator[](size_t g) const {
+    if (!is_final_) build();
+    return FlatSpan<V>(values_.data() + offsets_[g],
+                       values_.data() + offsets_[g + 1]);
+  }
+  void clear() {
+    offsets_.resize(1);
+    values_.clear();
+    is_final_ = true;
+  }
+
+ private:
+  void build() const {
+    if constexpr (IS_SET) {
+      size_t nb = 0;
+      std::uint32_t begin = 0;
+      for (size_t g = 0; g + 1 < offsets_.size(); g++) {
+        auto first = values_.begin() + begin;
+        auto last = values_.begin() + offsets_[g + 1];
+        std::sort(first, last);
+        last = std::unique(first, last);
+        begin = offsets_[g + 1];
+        nb = std::move(first, last, values_.begin() + nb) - values_.begin();
+        offsets_[g + 1] = nb;
+      }
+      values_.resize(nb);
+    }
+    is_final_ = true;
+  }
+
+  // sorted by the first query after add(), hence mutable
+  mutable std::vector<std::uint32_t> offsets_;
+  mutable std::vector<V> values_;
+  mutable bool is_final_ = true;
+};
+
+/**
+ * @brief Key -> list of groups (std::map<K, std::vector<std::set<V>>> if
+ * IS_SET, else std::map<K, std::vector<std::vector<V>>>).
+ */
+template <class K, class V, bool IS_SET = true>
+class FlatKeyedGroups {
+ public:
+  // starts a new group of key k, add() appends to it
+  void new_group(const K& k) {
+    groups_.new_group();
+    group_keys_.push_back(k);
+    is_final_ = false;
+  }
+  void add(const V& v) { groups_.add(v); }
+
+  // groups of the same key become contiguous, in insertion order
+  void finalize() { build(); }
+
+  // number of groups of key k
+  size_t nb_groups(const K& k) const {
+    std::pair<size_t, size_t> r = range(k);
+    return r.second - r.first;
+  }
+  // i-th group of key k
+  FlatSpan<V> group(const K& k, size_t i) const {
+    return groups_[order_[range(k).first + i]];
+  }
+  bool contains(const K& k) const { return nb_groups(k) != 0; }
+  void clear() {
+    groups_.clear();
+    group_keys_.clear();
+    order_.clear();
+    is_final_ = true;
+  }
+
+ private:
+  void build() const {
+    groups_.finalize();
+    order_.resize(group_keys_.size());
+    for (std::uint32_t g = 0; g < order_.size(); g++) order_[g] = g;
+    std::stable_sort(order_.begin(), order_.end(),
+                     [this](std::uint32_t a, std::uint32_t b) {
+                       return group_keys_[a] < group_keys_[b];
+                     });
+    is_final_ = true;
+  }
+
+  std::pair<size_t, size_t> range(const K& k) const {
+    if (!is_final_) build();
+    auto less_key = [this](std::uint32_t g, const K& key) {
+      return group_keys_[g] < key;
+    };
+    auto first = std::lower_bound(order_.begin(), order_.end(), k, less_key);
+    auto last = first;
+    while (last != order_.end() && !(k < group_keys_[*last])) ++last;
+    return std::make_pair(first - order_.begin(), last - order_.begin());
+  }
+
+  // built by the first query after new_group(), hence mutable
+  mutable FlatGroups<V, IS_SET> groups_;
+  std::vector<K> group_keys_;
+  mutable std::vector<std::uint32_t> order_;  // group ids sorted by key
+  mutable bool is_final_ = true;
+};
+
+#endif  // H_FLAT_CONTAINERS_H
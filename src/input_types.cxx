@@ -1,5 +1,13 @@
 #include "input_types.h"
 
+#include <geogram/basic/geometry_nd.h>
+#include <geogram/basic/process.h>
+
+#include <algorithm>
+#include <cstdint>
+
+#include "profiler.h"
+
 void SurfaceMesh::reload_sf2tet_vs_mapping() {
   // load sf2tet_vs_mapping
   const GEO::Attribute<int> tet_vid_attr(this->vertices.attributes(),
@@ -126,4 +134,141 @@ void store_special_edge(const TetMesh& tet_mesh, const SurfaceMesh& sf_mesh,
   fe.adj_tan_points = {{get_mesh_facet_centroid(sf_mesh, adj_sf_fids[0]),
                         get_mesh_facet_centroid(sf_mesh, adj_sf_fids[1])}};
   feature_edges.push_back(fe);
-}
\ No newline at end of file
+}
+/////////////////////////////////////////////////////////////////////////////////////
+// AABBWrapper batch queries
+/////////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+// spreads the lower 21 bits of x to every third bit
+inline std::uint64_t morton_spread(std::uint64_t x) {
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffULL;
+  x = (x | x << 16) & 0x1f0000ff0000ffULL;
+  x = (x | x << 8) & 0x100f00f00f00f00fULL;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+  x = (x | x << 2) & 0x1249249249249249ULL;
+  return x;
+}
+
+// query ids sorted by Morton code, relative to the bbox of the points
+void morton_order(const Vector3* points, size_t nb,
+                  std::vector<GEO::index_t>& order) {
+  Vector3 bmin = points[0], bmax = points[0];
+  for (size_t i = 1; i < nb; i++) {
+    for (int k = 0; k < 3; k++) {
+      bmin[k] = std::min(bmin[k], points[i][k]);
+      bmax[k] = std::max(bmax[k], points[i][k]);
+    }
+  }
+  double scale = std::max(std::max(bmax[0] - bmin[0], bmax[1] - bmin[1]),
+                          bmax[2] - bmin[2]);
+  scale = scale > 0. ? double(0x1fffff) / scale : 0.;
+
+  std::vector<std::pair<std::uint64_t, GEO::index_t>> codes(nb);
+  GEO::parallel_for(0, GEO::index_t(nb), [&](GEO::index_t i) {
+    std::uint64_t code = 0;
+    for (int k = 0; k < 3; k++) {
+      double q = std::min((points[i][k] - bmin[k]) * scale, double(0x1fffff));
+      code |= morton_spread(std::uint64_t(q)) << k;
+    }
+    codes[i] = std::make_pair(code, i);
+  });
+  std::sort(codes.begin(), codes.end());
+  order.resize(nb);
+  for (size_t i = 0; i < nb; i++) order[i] = codes[i].second;
+}
+
+// same as the leaves of GEO::MeshFacetsAABB, so that a seeded query
+// starts from the exact distance the tree would compute for facet f
+inline double point_facet_sq_dist(const GEO::Mesh& mesh, const Vector3& p,
+                                  GEO::index_t f, Vector3& nearest_p) {
+  assert(mesh.facets.nb_vertices(f) == 3);
+  GEO::index_t c = mesh.facets.corners_begin(f);
+  const Vector3& p1 = mesh.vertices.point(mesh.facet_corners.vertex(c));
+  const Vector3& p2 = mesh.vertices.point(mesh.facet_corners.vertex(c + 1));
+  const Vector3& p3 = mesh.vertices.point(mesh.facet_corners.vertex(c + 2));
+  double l1, l2, l3;
+  return GEO::Geom::point_triangle_squared_distance(p, p1, p2, p3, nearest_p,
+                                                    l1, l2, l3);
+}
+
+}  // namespace
+
+void AABBWrapper::get_nearest_points_on_sf(const Vector3* points, size_t nb,
+                                           Vector3* nearest_points, int* fids,
+                                           double* sq_dists,
+                                           bool is_seeded) const {
+  PROFILE_ZONE("AABB batch nearest");
+  if (nb == 0) return;
+  std::vector<GEO::index_t> order;
+  morton_order(points, nb, order);
+
+  // each chunk is a run of neighboring queries, seeded one by the other
+  const GEO::index_t min_chunk_size = 256;
+  GEO::index_t nb_chunks = std::min<size_t>(
+      nb / min_chunk_size, 8 * GEO::Process::maximum_concurrent_threads());
+  nb_chunks = std::max<GEO::index_t>(nb_chunks, 1);
+  const GEO::Mesh& mesh = *sf_tree->mesh();
+
+  GEO::parallel_for(0, nb_chunks, [&](GEO::index_t c) {
+    size_t begin = nb * c / nb_chunks, end = nb * (c + 1) / nb_chunks;
+    GEO::index_t prev_f = GEO::NO_FACET;
+    for (size_t j = begin; j < end; j++) {
+      GEO::index_t i = order[j];
+      const Vector3& p = points[i];
+      Vector3 nearest_p;
+      double sq_dist = std::numeric_limits<double>::max();
+      GEO::index_t f = GEO::NO_FACET;
+      if (is_seeded && prev_f != GEO::NO_FACET) {
+        f = prev_f;
+        sq_dist = point_facet_sq_dist(mesh, p, f, nearest_p);
+        sf_tree->nearest_facet_with_hint(p, f, nearest_p, sq_dist);
+      } else {
+        f = sf_tree->nearest_facet(p, nearest_p, sq_dist);
+      }
+      prev_f = f;
+      if (nearest_points != nullptr) nearest_points[i] = nearest_p;
+      if (fids != nullptr) fids[i] = int(f);
+      if (sq_dists != nullptr) sq_dists[i] = sq_dist;
+    }
+  });
+}
+
+void AABBWrapper::get_nearest_points_on_sf(
+    const std::vector<Vector3>& points, std::vector<Vector3>& nearest_points,
+    std::vector<int>& fids, std::vector<double>& sq_dists,
+    bool is_seeded) const {
+  nearest_points.resize(points.size());
+  fids.resize(points.size());
+  sq_dists.resize(points.size());
+  get_nearest_points_on_sf(points.data(), points.size(), nearest_points.data(),
+                           fids.data(), sq_dists.data(), is_seeded);
+}
+
+void AABBWrapper::get_nearest_faces_sf(const std::vector<Vector3>& points,
+                                       std::vector<int>& fids,
+                                       bool is_seeded) const {
+  fids.resize(points.size());
+  get_nearest_points_on_sf(points.data(), points.size(), nullptr, fids.data(),
+                           nullptr, is_seeded);
+}
+
+void AABBWrapper::get_sq_dists_to_sf(const std::vector<Vector3>& points,
+                                     std::vector<double>& sq_dists,
+                                     bool is_seeded) const {
+  sq_dists.resize(points.size());
+  get_nearest_points_on_sf(points.data(), points.size(), nullptr, nullptr,
+                           sq_dists.data(), is_seeded);
+}
+
+void AABBWrapper::project_to_sf(std::vector<Vector3>& points,
+                                std::vector<double>& sq_dists,
+                                bool is_seeded) const {
+  // nearest points are written after all queries read the points
+  std::vector<Vector3> nearest_points(points.size());
+  sq_dists.resize(points.size());
+  get_nearest_points_on_sf(points.data(), points.size(), nearest_points.data(),
+                           nullptr, sq_dists.data(), is_seeded);
+  points.swap(nearest_points);
+}
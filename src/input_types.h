@@ -119,6 +119,35 @@ class AABBWrapper {
     sf_tree->nearest_facet(p, nearest_p, sq_dist);
     return sq_dist;
   }
+
+  /** Batch queries, see input_types.cxx **/
+  // Queries run in parallel, in Morton order of the points. By default all
+  // results are bit-for-bit the single query results. With is_seeded, each
+  // query starts from the facet found by the previous one (in Morton
+  // order), which bounds the search by its distance: squared distances are
+  // the same, but the facet and nearest point may differ between facets at
+  // exactly the same distance, so only use it when ties do not matter.
+  //
+  // nearest_points, fids and sq_dists can be nullptr, otherwise of size nb.
+  void get_nearest_points_on_sf(const Vector3 *points, size_t nb,
+                                Vector3 *nearest_points, int *fids,
+                                double *sq_dists, bool is_seeded = false) const;
+
+  void get_nearest_points_on_sf(const std::vector<Vector3> &points,
+                                std::vector<Vector3> &nearest_points,
+                                std::vector<int> &fids,
+                                std::vector<double> &sq_dists,
+                                bool is_seeded = false) const;
+  void get_nearest_faces_sf(const std::vector<Vector3> &points,
+                            std::vector<int> &fids,
+                            bool is_seeded = false) const;
+  void get_sq_dists_to_sf(const std::vector<Vector3> &points,
+                          std::vector<double> &sq_dists,
+                          bool is_seeded = false) const;
+  // projects all points, returns sq_dists
+  void project_to_sf(std::vector<Vector3> &points,
+                     std::vector<double> &sq_dists,
+                     bool is_seeded = false) const;
 };
 
 class SurfaceMesh : public GEO::Mesh {
@@ -1,12 +1,39 @@
 
 #include "io.h"
 
+#include <fcntl.h>
+#include <geogram/basic/process.h>
 #include <geogram/mesh/mesh_io.h>
 #include <geogram/mesh/mesh_reorder.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <bitset>
+#include <charconv>
+#include <cstring>
+#include <limits>
 
 #include "../extern/mshloader/MshLoader.h"
+#include "profiler.h"
+
+// enlarges the bbox of vertices by 0.1% of its max side
+static void pad_bbox(float& xmin, float& ymin, float& zmin, float& xmax,
+                     float& ymax, float& zmax, float& bbox_diag_l) {
+  float d = xmax - xmin;
+  d = std::max(d, ymax - ymin);
+  d = std::max(d, zmax - zmin);
+  d = 0.001f * d;
+  xmin -= d;
+  ymin -= d;
+  zmin -= d;
+  xmax += d;
+  ymax += d;
+  zmax += d;
+
+  bbox_diag_l = std::sqrt(std::pow(xmax - xmin, 2) + std::pow(ymax - ymin, 2) +
+                          std::pow(zmax - zmin, 2));
+}
 
 void get_bbox(const std::vector<float>& vertices, float& xmin, float& ymin,
               float& zmin, float& xmax, float& ymax, float& zmax,
@@ -23,19 +50,355 @@ void get_bbox(const std::vector<float>& vertices, float& xmin, float& ymin,
     ymax = std::max(ymax, vertices[3 * i + 1]);
     zmax = std::max(zmax, vertices[3 * i + 2]);
   }
-  float d = xmax - xmin;
-  d = std::max(d, ymax - ymin);
-  d = std::max(d, zmax - zmin);
-  d = 0.001f * d;
-  xmin -= d;
-  ymin -= d;
-  zmin -= d;
-  xmax += d;
-  ymax += d;
-  zmax += d;
+  pad_bbox(xmin, ymin, zmin, xmax, ymax, zmax, bbox_diag_l);
+}
 
-  bbox_diag_l = std::sqrt(std::pow(xmax - xmin, 2) + std::pow(ymax - ymin, 2) +
-                          std::pow(zmax - zmin, 2));
+namespace {
+
+// Read-only mmap of a whole file
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      size_ = size_t(st.st_size);
+      void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        data_ = static_cast<const char*>(data);
+        madvise(data, size_, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+  }
+  ~MappedFile() {
+    if (data_ != nullptr) munmap(const_cast<char*>(data_), size_);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool ok() const { return data_ != nullptr; }
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+inline bool is_space(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+inline const char* skip_spaces(const char* p, const char* end) {
+  while (p < end && is_space(*p)) p++;
+  return p;
+}
+
+inline const char* skip_token(const char* p, const char* end) {
+  while (p < end && !is_space(*p)) p++;
+  return p;
+}
+
+inline const char* next_line(const char* p, const char* end) {
+  const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+  return nl == nullptr ? end : nl + 1;
+}
+
+// Non-locale number parsers, return the end of the number or nullptr
+const char* parse_int(const char* p, const char* end, int& value) {
+  bool neg = (p < end && *p == '-');
+  if (p < end && (*p == '-' || *p == '+')) p++;
+  if (p == end || *p < '0' || *p > '9') return nullptr;
+  long long v = 0;
+  while (p < end && *p >= '0' && *p <= '9') v = 10 * v + (*p++ - '0');
+  value = int(neg ? -v : v);
+  return p;
+}
+
+// correctly rounded as strtof, i.e. as std::ifstream >> float
+const char* parse_float(const char* p, const char* end, float& value) {
+  // from_chars does not accept a leading '+'
+  if (p < end && *p == '+' && p + 1 < end && p[1] != '-') p++;
+  std::from_chars_result r = std::from_chars(p, end, value);
+  return r.ec == std::errc() ? r.ptr : nullptr;
+}
+
+/**
+ * @brief Parses whitespace separated tokens of [begin, end) in parallel.
+ *
+ * [begin, end) is split into nb_chunks line-aligned chunks. A first pass
+ * counts the tokens of each chunk, so each chunk knows the global index of
+ * its first token. Then handle(chunk, token, p, end) parses the token at p
+ * and returns the position after it (nullptr on error). Tokens after the
+ * first nb_tokens are ignored.
+ *
+ * @return false if there are less than nb_tokens tokens, or on error
+ */
+template <class HANDLE>
+bool parse_tokens_parallel(const char* begin, const char* end,
+                           size_t nb_tokens, GEO::index_t nb_chunks,
+                           HANDLE handle) {
+  std::vector<const char*> bounds(nb_chunks + 1, end);
+  bounds[0] = begin;
+  for (GEO::index_t c = 1; c < nb_chunks; c++) {
+    const char* p = begin + (end - begin) * size_t(c) / nb_chunks;
+    bounds[c] = std::max(bounds[c - 1], next_line(p, end));
+  }
+
+  std::vector<size_t> first_token(nb_chunks + 1, 0);
+  GEO::parallel_for(0, nb_chunks, [&](GEO::index_t c) {
+    size_t nb = 0;
+    const char* p = skip_spaces(bounds[c], bounds[c + 1]);
+    while (p < bounds[c + 1]) {
+      nb++;
+      p = skip_spaces(skip_token(p, bounds[c + 1]), bounds[c + 1]);
+    }
+    first_token[c + 1] = nb;
+  });
+  for (GEO::index_t c = 0; c < nb_chunks; c++)
+    first_token[c + 1] += first_token[c];
+  if (first_token[nb_chunks] < nb_tokens) {
+    printf("[load_tet] found %zu numbers, expected %zu\n",
+           first_token[nb_chunks], nb_tokens);
+    return false;
+  }
+
+  std::vector<char> chunk_ok(nb_chunks, 1);
+  GEO::parallel_for(0, nb_chunks, [&](GEO::index_t c) {
+    const char* e = bounds[c + 1];
+    const char* p = skip_spaces(bounds[c], e);
+    for (size_t t = first_token[c]; p < e && t < nb_tokens; t++) {
+      p = handle(c, t, p, e);
+      if (p == nullptr || (p < e && !is_space(*p))) {
+        chunk_ok[c] = 0;
+        return;
+      }
+      p = skip_spaces(p, e);
+    }
+  });
+  for (char ok : chunk_ok) {
+    if (!ok) {
+      printf("[load_tet] invalid number\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+// min xyz, max xyz
+typedef std::array<float, 6> BBox6;
+
+BBox6 empty_bbox() {
+  const float inf = std::numeric_limits<float>::infinity();
+  return {{inf, inf, inf, -inf, -inf, -inf}};
+}
+
+BBox6 merge_bboxes(const std::vector<BBox6>& bboxes) {
+  BBox6 result = empty_bbox();
+  for (const BBox6& b : bboxes) {
+    for (int j = 0; j < 3; j++) {
+      result[j] = std::min(result[j], b[j]);
+      result[j + 3] = std::max(result[j + 3], b[j + 3]);
+    }
+  }
+  return result;
+}
+
+GEO::index_t nb_parse_chunks(const char* begin, const char* end) {
+  // at least 1MB per chunk
+  size_t nb = size_t(end - begin) >> 20;
+  nb = std::min<size_t>(nb, 8 * GEO::Process::maximum_concurrent_threads());
+  return GEO::index_t(std::max<size_t>(nb, 1));
+}
+
+/**
+ * @brief Loads .tet ("nv nt", nv "x y z" lines, nt "4 a b c d" lines) or
+ * legacy .vtk (4 header lines, POINTS, CELLS) through mmap, numbers are
+ * parsed in parallel. Also computes the bbox of the vertices.
+ */
+bool load_tet_mapped(const std::string& filename, bool is_vtk,
+                     std::vector<float>& vertices, std::vector<int>& indices,
+                     BBox6& bbox) {
+  MappedFile file(filename);
+  if (!file.ok()) return false;
+  const char* p = file.begin();
+  const char* end = file.end();
+  int n_vertex = 0, n_tet = 0;
+  if (is_vtk) {
+    for (int i = 0; i < 4; ++i) p = next_line(p, end);  // skip first 4 lines
+    p = skip_token(skip_spaces(p, end), end);           // POINTS
+    p = parse_int(skip_spaces(p, end), end, n_vertex);
+  } else {
+    p = parse_int(skip_spaces(p, end), end, n_vertex);
+    if (p != nullptr) p = parse_int(skip_spaces(p, end), end, n_tet);
+  }
+  if (p == nullptr || n_vertex < 0 || n_tet < 0) {
+    printf("[load_tet] %s: invalid header\n", filename.c_str());
+    return false;
+  }
+  p = next_line(p, end);
+  vertices.resize(3 * size_t(n_vertex));
+
+  std::vector<BBox6> chunk_bbox;
+  auto parse_vertex = [&](GEO::index_t c, size_t t, const char* q,
+                          const char* e) {
+    float& v = vertices[t];
+    q = parse_float(q, e, v);
+    chunk_bbox[c][t % 3] = std::min(chunk_bbox[c][t % 3], v);
+    chunk_bbox[c][t % 3 + 3] = std::max(chunk_bbox[c][t % 3 + 3], v);
+    return q;
+  };
+  // "4 a b c d", vtk indices are shifted by -1 as before
+  const int index_offset = is_vtk ? -1 : 0;
+  auto parse_tet = [&](size_t t, const char* q, const char* e) {
+    int v = 0;
+    q = parse_int(q, e, v);
+    size_t lv = t % 5;
+    if (lv == 0) return v == 4 ? q : nullptr;  // only tets
+    indices[4 * (t / 5) + lv - 1] = v + index_offset;
+    return q;
+  };
+
+  if (!is_vtk) {
+    // vertices and tets are one stream of numbers
+    indices.resize(4 * size_t(n_tet));
+    const size_t nb_v_tokens = vertices.size();
+    GEO::index_t nb_chunks = nb_parse_chunks(p, end);
+    chunk_bbox.assign(nb_chunks, empty_bbox());
+    bool ok = parse_tokens_parallel(
+        p, end, nb_v_tokens + 5 * size_t(n_tet), nb_chunks,
+        [&](GEO::index_t c, size_t t, const char* q, const char* e) {
+          return t < nb_v_tokens ? parse_vertex(c, t, q, e)
+                                 : parse_tet(t - nb_v_tokens, q, e);
+        });
+    bbox = merge_bboxes(chunk_bbox);
+    return ok;
+  }
+
+  const char* cells = static_cast<const char*>(
+      memmem(p, end - p, "CELLS", 5));
+  if (cells == nullptr) {
+    printf("[load_tet] %s: no CELLS\n", filename.c_str());
+    return false;
+  }
+  GEO::index_t nb_chunks = nb_parse_chunks(p, cells);
+  chunk_bbox.assign(nb_chunks, empty_bbox());
+  if (!parse_tokens_parallel(p, cells, vertices.size(), nb_chunks,
+                             parse_vertex))
+    return false;
+  bbox = merge_bboxes(chunk_bbox);
+
+  p = parse_int(skip_spaces(cells + 5, end), end, n_tet);
+  if (p == nullptr || n_tet < 0) {
+    printf("[load_tet] %s: invalid CELLS\n", filename.c_str());
+    return false;
+  }
+  p = next_line(p, end);
+  const char* cells_end = static_cast<const char*>(
+      memmem(p, end - p, "CELL_TYPES", 10));
+  if (cells_end == nullptr) cells_end = end;
+  indices.resize(4 * size_t(n_tet));
+  return parse_tokens_parallel(
+      p, cells_end, 5 * size_t(n_tet), nb_parse_chunks(p, cells_end),
+      [&](GEO::index_t, size_t t, const char* q, const char* e) {
+        return parse_tet(t, q, e);
+      });
+}
+
+/**
+ * @brief vertices = scale * (vertices - min) in parallel, returns the bbox
+ * of the scaled vertices.
+ */
+BBox6 normalize_vertices(std::vector<float>& vertices, const float vmin[3],
+                         float scale_max, float maxside) {
+  const size_t n_vertex = vertices.size() / 3;
+  const GEO::index_t nb_chunks = GEO::index_t(std::max<size_t>(
+      std::min<size_t>(n_vertex >> 16,
+                       8 * GEO::Process::maximum_concurrent_threads()),
+      1));
+  std::vector<BBox6> chunk_bbox(nb_chunks, empty_bbox());
+  GEO::parallel_for(0, nb_chunks, [&](GEO::index_t c) {
+    size_t begin = n_vertex * c / nb_chunks;
+    size_t end = n_vertex * (c + 1) / nb_chunks;
+    BBox6& B = chunk_bbox[c];
+    for (size_t i = begin; i < end; i++) {
+      for (int j = 0; j < 3; j++) {
+        float& v = vertices[3 * i + j];
+        v = scale_max * (v - vmin[j]) / maxside;
+        B[j] = std::min(B[j], v);
+        B[j + 3] = std::max(B[j + 3], v);
+      }
+    }
+  });
+  return merge_bboxes(chunk_bbox);
+}
+
+// former std::ifstream parser of .tet/.vtk, reference of load_tet_mapped()
+bool load_tet_stream(const std::string& filename, bool is_vtk,
+                     std::vector<float>& vertices, std::vector<int>& indices) {
+  std::ifstream input(filename);
+  if (input.fail()) return false;
+  std::string s;
+  int n_vertex = 0, n_tet = 0, temp = 0;
+  if (is_vtk) {
+    for (int i = 0; i < 4; ++i) std::getline(input, s);  // skip first 4 lines
+    input >> s >> n_vertex >> s;
+  } else {
+    input >> n_vertex >> n_tet;
+  }
+  vertices.resize(3 * size_t(n_vertex));
+  for (int i = 0; i < n_vertex; ++i)
+    input >> vertices[3 * i] >> vertices[3 * i + 1] >> vertices[3 * i + 2];
+  if (is_vtk) input >> s >> n_tet >> s;
+  indices.resize(4 * size_t(n_tet));
+  for (int i = 0; i < n_tet; ++i) {
+    input >> temp >> indices[(i << 2)] >> indices[(i << 2) + 1] >>
+        indices[(i << 2) + 2] >> indices[(i << 2) + 3];
+    if (temp != 4) return false;
+    if (is_vtk)
+      for (uint j = 0; j < 4; ++j) --indices[(i << 2) + j];
+  }
+  return !input.fail();
+}
+
+}  // namespace
+
+bool validate_load_tet(const std::string& filename) {
+  PROFILE_ZONE("io validate_load_tet");
+  std::string ext = get_file_ext(filename);
+  if (ext != "tet" && ext != "vtk") {
+    printf("[load_tet] %s: only .tet/.vtk are parsed in parallel\n",
+           filename.c_str());
+    return true;
+  }
+  std::vector<float> vertices, vertices_ref;
+  std::vector<int> indices, indices_ref;
+  BBox6 bbox;
+  if (!load_tet_mapped(filename, ext == "vtk", vertices, indices, bbox) ||
+      !load_tet_stream(filename, ext == "vtk", vertices_ref, indices_ref)) {
+    printf("[load_tet] %s: could not parse\n", filename.c_str());
+    return false;
+  }
+  size_t nb_diff_v = 0, nb_diff_t = 0;
+  if (vertices.size() == vertices_ref.size()) {
+    for (size_t i = 0; i < vertices.size(); i++)
+      nb_diff_v += memcmp(&vertices[i], &vertices_ref[i], sizeof(float)) != 0;
+  }
+  if (indices.size() == indices_ref.size()) {
+    for (size_t i = 0; i < indices.size(); i++)
+      nb_diff_t += indices[i] != indices_ref[i];
+  }
+  bool ok = vertices.size() == vertices_ref.size() &&
+            indices.size() == indices_ref.size() && nb_diff_v == 0 &&
+            nb_diff_t == 0;
+  printf("[load_tet] %s vs ifstream: %zu/%zu vertices, %zu/%zu tets, "
+         "%zu coordinates and %zu indices differ: %s\n",
+         filename.c_str(), vertices.size() / 3, vertices_ref.size() / 3,
+         indices.size() / 4, indices_ref.size() / 4, nb_diff_v, nb_diff_t,
+         ok ? "same" : "DIFFERENT");
+  return ok;
 }
 
 // vertices: tet vertices
@@ -43,70 +406,36 @@ void get_bbox(const std::vector<float>& vertices, float& xmin, float& ymin,
 using namespace PyMesh;
 bool load_tet(const std::string& filename, std::vector<float>& vertices,
               std::vector<int>& indices, bool normalize, Parameter& params) {
-  std::string s;
-  int n_vertex, n_tet, temp;
-
-  std::ifstream input(filename);
-  if (input.fail()) return false;
-
+  PROFILE_ZONE("io load_tet");
+  float xmin, ymin, zmin, xmax, ymax, zmax;
   std::string ext = filename.substr(filename.find_last_of('.') + 1);
   if (ext == "msh") {
+    if (!std::ifstream(filename).good()) return false;
     MshLoader msh_loader(filename);
     vertices = msh_loader.get_nodes();
     indices = msh_loader.get_elements();
-    n_vertex = vertices.size() / 3;
-  } else if (ext == "tet") {
-    input >> n_vertex >> n_tet;
-    vertices.resize(3 * n_vertex);
-    indices.resize(n_tet << 2);
-
-    for (int i = 0; i < n_vertex; ++i)
-      input >> vertices[3 * i] >> vertices[3 * i + 1] >> vertices[3 * i + 2];
-
-    for (int i = 0; i < n_tet; ++i) {
-      input >> temp >> indices[(i << 2)] >> indices[(i << 2) + 1] >>
-          indices[(i << 2) + 2] >> indices[(i << 2) + 3];
-      assert(temp == 4);
-    }
-  } else if (ext == "vtk") {
-    for (int i = 0; i < 4; ++i) std::getline(input, s);  // skip first 4 lines
-
-    input >> s >> n_vertex >> s;
-    vertices.resize(3 * n_vertex);
-    for (int i = 0; i < n_vertex; ++i)
-      input >> vertices[3 * i] >> vertices[3 * i + 1] >> vertices[3 * i + 2];
-
-    input >> s >> n_tet >> s;
-    indices.resize(n_tet << 2);
-    for (int i = 0; i < n_tet; ++i) {
-      // A single left shift multiplies a binary number by 2:
-      input >> temp >> indices[(i << 2)] >> indices[(i << 2) + 1] >>
-          indices[(i << 2) + 2] >> indices[(i << 2) + 3];
-      assert(temp == 4);
-      for (uint j = 0; j < 4; ++j) --indices[(i << 2) + j];
-    }
+    get_bbox(vertices, xmin, ymin, zmin, xmax, ymax, zmax, params.bbox_diag_l);
+  } else if (ext == "tet" || ext == "vtk") {
+    BBox6 bbox;
+    if (!load_tet_mapped(filename, ext == "vtk", vertices, indices, bbox))
+      return false;
+    xmin = bbox[0], ymin = bbox[1], zmin = bbox[2];
+    xmax = bbox[3], ymax = bbox[4], zmax = bbox[5];
+    pad_bbox(xmin, ymin, zmin, xmax, ymax, zmax, params.bbox_diag_l);
   } else {
-    input.close();
     return false;
   }
-  input.close();
-  std::cout << "loaded tet_mesh #v: " << n_vertex
+  std::cout << "loaded tet_mesh #v: " << vertices.size() / 3
             << ", #t: " << indices.size() / 4 << std::endl;
 
   // normalize vertices between [0,1000]^3
-  float xmin, ymin, zmin, xmax, ymax, zmax;
-  get_bbox(vertices, xmin, ymin, zmin, xmax, ymax, zmax, params.bbox_diag_l);
   if (normalize) {
     float maxside = std::max(std::max(xmax - xmin, ymax - ymin), zmax - zmin);
-    // #pragma omp parallel for
-    for (int i = 0; i < n_vertex; i++) {
-      vertices[3 * i] = params.scale_max * (vertices[3 * i] - xmin) / maxside;
-      vertices[3 * i + 1] =
-          params.scale_max * (vertices[3 * i + 1] - ymin) / maxside;
-      vertices[3 * i + 2] =
-          params.scale_max * (vertices[3 * i + 2] - zmin) / maxside;
-    }
-    get_bbox(vertices, xmin, ymin, zmin, xmax, ymax, zmax, params.bbox_diag_l);
+    const float vmin[3] = {xmin, ymin, zmin};
+    BBox6 bbox = normalize_vertices(vertices, vmin, params.scale_max, maxside);
+    xmin = bbox[0], ymin = bbox[1], zmin = bbox[2];
+    xmax = bbox[3], ymax = bbox[4], zmax = bbox[5];
+    pad_bbox(xmin, ymin, zmin, xmax, ymax, zmax, params.bbox_diag_l);
     std::cerr << "bbox [" << xmin << ":" << xmax << "], [" << ymin << ":"
               << ymax << "], [" << zmin << ":" << zmax
               << "], bbox_diag_l: " << params.bbox_diag_l << std::endl;
@@ -194,6 +523,12 @@ void load_spheres_to_sites_given(std::vector<MedialSphere>& all_medial_spheres,
 void load_spheres_from_file(const char* filename,
                             std::vector<MedialSphere>& all_medial_spheres,
                             bool is_load_type) {
+  PROFILE_ZONE("io load_spheres");
+  if (get_file_ext(filename) == "sphb") {
+    if (!load_spheres_binary(filename, all_medial_spheres))
+      all_medial_spheres.clear();
+    return;
+  }
   std::ifstream file(filename);
   int dim, n_site;
   int type;
@@ -216,9 +551,6 @@ void load_spheres_from_file(const char* filename,
         msphere.type = SphereType(type);  // else as T2 sphere
     }
     all_medial_spheres.push_back(msphere);
-    printf("site %d has sphere: (%lf %lf %lf %lf), type: %d\n", i,
-           msphere.center[0], msphere.center[1], msphere.center[2],
-           msphere.radius, msphere.type);
   }
   file.close();
 }
@@ -259,19 +591,46 @@ void save_spheres_file(const std::vector<MedialSphere>& all_medial_spheres,
                        const std::string filename, bool is_save_type) {
   std::string sphere_path =
       "../out/sph/sph_" + filename + "_" + get_timestamp() + ".sph";
-  int n_site = all_medial_spheres.size();
+  save_spheres_sph(all_medial_spheres, sphere_path, is_save_type);
+}
+
+bool save_spheres_sph(const std::vector<MedialSphere>& all_medial_spheres,
+                      const std::string& sphere_path, bool is_save_type,
+                      bool is_skip_deleted) {
+  PROFILE_ZONE("io save_spheres");
+  int n_site = 0;
+  for (const auto& msphere : all_medial_spheres)
+    if (!is_skip_deleted || !msphere.is_deleted) n_site++;
   std::fstream file;
   file.open(sphere_path, std::ios_base::out);
+  if (!file.is_open()) return false;
   file << 4 << " " << n_site << std::endl;
-  for (int i = 0; i < n_site; i++) {
-    const auto& msphere = all_medial_spheres.at(i);
+  for (const auto& msphere : all_medial_spheres) {
+    if (is_skip_deleted && msphere.is_deleted) continue;
     file << msphere.center[0] << " " << msphere.center[1] << " "
          << msphere.center[2] << " " << msphere.radius;
     if (is_save_type) file << " " << msphere.type;
     file << std::endl;
   }
   file.close();
+  if (file.fail()) return false;
   printf("saved .sph file %s\n", sphere_path.c_str());
+  return true;
+}
+
+bool convert_spheres_file(const std::string& in_path,
+                          const std::string& out_path, bool is_type,
+                          bool is_quantized) {
+  std::vector<MedialSphere> all_medial_spheres;
+  load_spheres_from_file(in_path.c_str(), all_medial_spheres, is_type);
+  if (all_medial_spheres.empty()) {
+    printf("%s: no spheres loaded\n", in_path.c_str());
+    return false;
+  }
+  if (get_file_ext(out_path) == "sphb")
+    return save_spheres_binary(all_medial_spheres, out_path, is_type,
+                               is_quantized);
+  return save_spheres_sph(all_medial_spheres, out_path, is_type);
 }
 
 void load_v2tets(const std::vector<float>& vertices,
@@ -331,6 +690,7 @@ void load_surface_vertices(const std::vector<float>& vertices,
 }
 
 bool load_surface_mesh(const std::string& path, GEO::Mesh& input) {
+  PROFILE_ZONE("io load_surface_mesh");
   std::cout << "Loading mesh at" << path << std::endl;
   input.clear(false, false);
   const bool ok = GEO::mesh_load(path, input);
@@ -342,6 +702,7 @@ bool load_surface_mesh(const std::string& path, GEO::Mesh& input) {
  * Here we save the vertex's old id in tet_vertices as attributes
  */
 bool load_surface_mesh_geogram(const std::string& path, GEO::Mesh& input) {
+  PROFILE_ZONE("io load_surface_mesh");
   std::cout << "Loading mesh at" << path << std::endl;
   if (get_file_ext(path) != "geogram") {
     printf("Please use mesh format as .geogram");
@@ -409,6 +770,25 @@ void load_sf_mesh_from_internal(const std::vector<std::array<float, 3>>& points,
   input.facets.connect();
 }
 
+void load_tet_mesh_from_internal(const std::vector<float>& tet_vertices,
+                                 const std::vector<int>& tet_indices,
+                                 GEO::Mesh& tet_mesh) {
+  tet_mesh.clear(false, false);
+  tet_mesh.vertices.create_vertices(tet_vertices.size() / 3);
+  for (uint i = 0; i < tet_mesh.vertices.nb(); ++i) {
+    GEO::vec3& p = tet_mesh.vertices.point(i);
+    for (uint j = 0; j < 3; ++j) p[j] = tet_vertices[3 * i + j];
+  }
+  tet_mesh.cells.create_tets(tet_indices.size() / 4);
+  for (uint t = 0; t < tet_mesh.cells.nb(); ++t) {
+    for (uint lv = 0; lv < 4; ++lv) {
+      tet_mesh.cells.set_vertex(t, lv, tet_indices[4 * t + lv]);
+    }
+  }
+  // tet adjacency, traversed by the volumetric RPD
+  tet_mesh.cells.connect();
+}
+
 bool save_sf_mesh(const std::string sf_path, const GEO::Mesh& sf_mesh) {
   bool ok = GEO::mesh_save(sf_mesh, sf_path);
   std::cout << "saving sf_mesh ok: " << ok << std::endl;
@@ -416,6 +796,7 @@ bool save_sf_mesh(const std::string sf_path, const GEO::Mesh& sf_mesh) {
 }
 
 bool save_sf_mesh_geogram(const std::string sf_path, GEO::Mesh& sf_mesh) {
+  PROFILE_ZONE("io save_mesh");
   GEO::OutputGeoFile geo_file(sf_path);
   GEO::MeshIOFlags flags;
   flags.set_element(GEO::MeshElementsFlags::MESH_ALL_ELEMENTS);
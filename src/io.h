@@ -22,6 +22,7 @@
 #include "common_cxx.h"
 #include "medial_sphere.h"
 #include "params.h"
+#include "sphere_file.h"
 
 void get_bbox(const std::vector<float>& vertices, float& xmin, float& ymin,
               float& zmin, float& xmax, float& ymax, float& zmax,
@@ -30,11 +31,16 @@ void get_bbox(const std::vector<float>& vertices, float& xmin, float& ymin,
 bool load_tet(const std::string& filename, std::vector<float>& vertices,
               std::vector<int>& indices, bool normalize, Parameter& params);
 
+// parses .tet/.vtk with load_tet() and with the former std::ifstream
+// parser, returns false if any value differs bit-wise
+bool validate_load_tet(const std::string& filename);
+
 void load_spheres_to_sites_given(std::vector<MedialSphere>& all_medial_spheres,
                                  bool& site_is_transposed,
                                  std::vector<float>& site,
                                  std::vector<float>& site_weights, int& n_site);
 
+// .sph text, or .sphb binary (see sphere_file.h)
 void load_spheres_from_file(const char* filename,
                             std::vector<MedialSphere>& all_medial_spheres,
                             bool is_load_type);
@@ -44,6 +50,14 @@ void load_sites_from_file(bool& site_is_transposed, std::vector<float>& site,
                           const char* filename);
 void save_spheres_file(const std::vector<MedialSphere>& all_medial_spheres,
                        const std::string filename, bool is_save_type);
+bool save_spheres_sph(const std::vector<MedialSphere>& all_medial_spheres,
+                      const std::string& path, bool is_save_type,
+                      bool is_skip_deleted = false);
+
+// .sph <-> .sphb, format given by file extensions
+bool convert_spheres_file(const std::string& in_path,
+                          const std::string& out_path, bool is_type,
+                          bool is_quantized);
 
 void load_v2tets(const std::vector<float>& vertices,
                  const std::vector<int>& indices,
@@ -61,6 +75,11 @@ void load_sf_mesh_from_internal(const std::vector<std::array<float, 3>>& points,
                                 const std::vector<int>& input_vs_id_attr,
                                 GEO::Mesh& input);
 
+// tets as GEO::Mesh cells, e.g. for volumetric RPD
+void load_tet_mesh_from_internal(const std::vector<float>& tet_vertices,
+                                 const std::vector<int>& tet_indices,
+                                 GEO::Mesh& tet_mesh);
+
 // void write_convex_cells(std::vector<float3>& voro_points,
 //                         std::vector<std::array<int, 4>>& voro_tets,
 //                         std::vector<int>& voro_tets_sites);
@@ -12,6 +12,7 @@
 #include <sstream>
 #include <vector>
 
+#include "batch.h"
 #include "io.h"
 #include "main_gui_cxx.h"
 #include "params.h"
@@ -24,6 +25,30 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  // .sph <-> .sphb, e.g.: --convert-spheres in.sph out.sphb [type] [quantize]
+  if (argc >= 4 && std::string(argv[1]) == "--convert-spheres") {
+    bool is_type = false, is_quantized = false;
+    for (int i = 4; i < argc; i++) {
+      is_type |= std::string(argv[i]) == "type";
+      is_quantized |= std::string(argv[i]) == "quantize";
+    }
+    return convert_spheres_file(argv[2], argv[3], is_type, is_quantized) ? 0
+                                                                         : 1;
+  }
+
+  // headless pipeline, no GUI (see batch.h)
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) != "--headless") continue;
+    BatchOptions options;
+    if (!parse_batch_options(argc, argv, options)) {
+      print_batch_usage(argv[0]);
+      return 1;
+    }
+    GEO::initialize();
+    GEO::CmdLine::import_arg_group("algo");
+    return run_batch(options);
+  }
+
   std::string surface_path = argv[1];
   // read surface file from tetwild/ftetwild
   // this will make sure all geogram algoriths can be used
@@ -58,13 +58,37 @@
 
 #include "RPD_callback.h"
 #include "RPD_mesh_builder.h"
+#include "RPD_work_stealing.h"
 #include "common_cxx.h"
 #include "generic_RPD.h"
+#include "predicates.h"
+#include "profiler.h"
 
 namespace {
 using namespace GEO;
 using namespace matfp;
 
+// Number of facet chunks per thread, and minimum size of a chunk
+// (tetrahedra in volumetric mode)
+const index_t RPD_CHUNKS_PER_THREAD = 8;
+const index_t RPD_MIN_FACETS_PER_CHUNK = 64;
+
+/**
+ * \brief Restricted cells of the volumetric RPD computed by one part,
+ *  merged by RPD_3d_Impl::merge_RPD_volumetric_parts().
+ */
+struct RPDVolumetricPart {
+  /** \brief One non-empty (seed, tetrahedron) intersection. */
+  struct Piece {
+    index_t seed;
+    double volume;
+    vec3 moment;  // volume * centroid
+  };
+  std::vector<Piece> pieces;
+  // (seed, adjacent seed) through a bisector facet
+  std::vector<std::pair<index_t, index_t>> seed_pairs;
+};
+
 /**
  * \brief Generic implementation of RestrictedPowerDiagram.
  * \tparam DIM dimension
@@ -89,6 +113,9 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
   /** \brief Represents a point and its symbolic information. */
   typedef typename GenRestrictedPowerDiagram::Vertex Vertex;
 
+  /** \brief Intersection between a power cell and a tetrahedron. */
+  typedef typename GenRestrictedPowerDiagram::Polyhedron Polyhedron;
+
   /**
    * \brief Specifies the computation done by the threads.
    */
@@ -99,7 +126,9 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
     MT_INT_SMPLX, /**< Newton with integration simplex        */
     MT_POLYG,     /**< Polygon callback                       */
     MT_POLYH,     /**< Polyhedron callback                    */
-    MT_RPD_S_MESH /**< Build surfacic RPD Mesh                */
+    MT_RPD_S_MESH,   /**< Build surfacic RPD Mesh             */
+    MT_RPD_S_STREAM, /**< Stream surfacic RPD polygons        */
+    MT_RPD_V_CELLS   /**< Accumulate volumetric RPD cells     */
   };
 
   /**
@@ -126,7 +155,14 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
     simplex_func_ = nullptr;
     polygon_callback_ = nullptr;
     polyhedron_callback_ = nullptr;
-    build_rpd_ = nullptr;
+    part_builders_ = nullptr;
+    stream_sink_ = nullptr;
+    stream_mutex_ = nullptr;
+    stream_batch_corners_ = RPD_STREAM_BATCH_CORNERS;
+    volume_parts_ = nullptr;
+    keys_mesh_ = nullptr;
+    keys_nb_vertices_ = 0;
+    keys_nb_facets_ = 0;
     arg_vectors_ = nullptr;
     arg_scalars_ = nullptr;
     thread_mode_ = MT_NONE;
@@ -151,7 +187,14 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
     simplex_func_ = nullptr;
     polygon_callback_ = nullptr;
     polyhedron_callback_ = nullptr;
-    build_rpd_ = nullptr;
+    part_builders_ = nullptr;
+    stream_sink_ = nullptr;
+    stream_mutex_ = nullptr;
+    stream_batch_corners_ = RPD_STREAM_BATCH_CORNERS;
+    volume_parts_ = nullptr;
+    keys_mesh_ = nullptr;
+    keys_nb_vertices_ = 0;
+    keys_nb_facets_ = 0;
     arg_vectors_ = nullptr;
     arg_scalars_ = nullptr;
     thread_mode_ = MT_NONE;
@@ -223,9 +266,10 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
       polygon_callback_ = &polygon_callback;
       polygon_callback_->set_spinlocks(&spinlocks_);
       // Note: callback begin()/end() is called in for_each_polygon()
-      parallel_for(0, nb_parts(), [this](index_t i) { run_thread(i); });
+      run_parts("RPD polygons");
       polygon_callback_->set_spinlocks(nullptr);
     }
+    if (!is_slave_) print_clip_stats();
   }
 
   virtual void compute_with_polyhedron_callback(
@@ -245,7 +289,7 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
       polyhedron_callback_->set_spinlocks(&spinlocks_);
       // Note: callback begin()/end() is
       // called in for_each_polyhedron()
-      parallel_for(0, nb_parts(), [this](index_t i) { run_thread(i); });
+      run_parts("RPD polyhedra");
       polyhedron_callback_->set_spinlocks(nullptr);
     }
   }
@@ -273,7 +317,6 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
         : RPD(RPD_in), builder_(builder), current_facet_(-1) {
       // std::cout << "calling builder_.begin_surface() ...\n";
       builder_.begin_surface();
-      global_lock_ = GEOGRAM_SPINLOCK_INIT;
       // std::cout << "done calling builder_.begin_surface() ...\n";
     }
 
@@ -298,7 +341,7 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
      */
     void operator()(GEO::index_t v,
                     const typename GenRestrictedPowerDiagram::Polygon& P) {
-      GEO::Process::acquire_spinlock(global_lock_);
+      // Note: no lock, in parallel mode each part has its own BUILDER
       // std::cout << "In BuildRPD operator ..." << std::endl;
       // std::cout << "processing seed: " << (int) v << std::endl;
       index_t f = RPD.current_facet();
@@ -326,18 +369,97 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
       }
       builder_.end_facet();
 
-      GEO::Process::release_spinlock(global_lock_);
 
       // std::cout << "builder finish to build facet" << std::endl;
     }
 
    private:
-    Process::spinlock global_lock_;
     const GenRestrictedPowerDiagram& RPD;
     BUILDER& builder_;
     signed_index_t current_facet_;
   };
 
+  /********************************************************************/
+  /**
+   * \brief Implementation class for accumulating the volume, centroid
+   *    and adjacent seeds of each restricted cell.
+   * \details To be used as a template argument to
+   *    RPD::for_each_polyhedron(). Each intersection between a power
+   *    cell and a tetrahedron is decomposed into tetrahedra radiating
+   *    from one of its vertices. Facets with a positive id are bisector
+   *    facets, the id is 1 + the tag of the adjacent seed.
+   */
+  class AccumulateRPDCells {
+   public:
+    /**
+     * \brief Constructs a new AccumulateRPDCells.
+     * \param[in] part where the cells are stored
+     */
+    explicit AccumulateRPDCells(RPDVolumetricPart& part) : part_(part) {}
+
+    /**
+     * \brief The callback called for each restricted cell.
+     * \param[in] v index of current seed
+     * \param[in] t index of current tetrahedron
+     * \param[in] C intersection between the power cell of \p v
+     *  and tetrahedron \p t
+     */
+    void operator()(GEO::index_t v, GEO::index_t t, const Polyhedron& C) {
+      // Note: no lock, in parallel mode each part has its own storage
+      geo_argused(t);
+      const double* origin = nullptr;
+      for (index_t ct = 0; ct < C.max_t() && origin == nullptr; ++ct) {
+        if (C.triangle_is_used(ct)) origin = C.triangle_dual(ct).point();
+      }
+      if (origin == nullptr) {
+        return;  // empty cell
+      }
+      const vec3 p0(origin);
+      double volume = 0.0;
+      vec3 moment(0.0, 0.0, 0.0);
+      for (index_t cv = 0; cv < C.max_v(); ++cv) {
+        signed_index_t ct = C.vertex_triangle(cv);
+        if (ct == -1) {
+          continue;
+        }
+        signed_index_t id = C.vertex_id(cv);
+        if (id > 0) {
+          part_.seed_pairs.push_back(std::make_pair(v, index_t(id - 1)));
+        }
+        // Fan of the facet dual to cv
+        Polyhedron::Corner c1(index_t(ct),
+                              C.find_triangle_vertex(index_t(ct), cv));
+        Polyhedron::Corner c2 = c1;
+        C.move_to_next_around_vertex(c2);
+        Polyhedron::Corner c3 = c2;
+        C.move_to_next_around_vertex(c3);
+        const vec3 p1(C.triangle_dual(c1.t).point());
+        do {
+          const vec3 p2(C.triangle_dual(c2.t).point());
+          const vec3 p3(C.triangle_dual(c3.t).point());
+          double tet_volume = Geom::tetra_signed_volume(p0, p1, p2, p3);
+          volume += tet_volume;
+          moment += (0.25 * tet_volume) * (p0 + p1 + p2 + p3);
+          c2 = c3;
+          C.move_to_next_around_vertex(c3);
+        } while (c3 != c1);
+      }
+      // The sign depends on the orientation of the dual triangles
+      if (volume < 0.0) {
+        volume = -volume;
+        moment *= -1.0;
+      }
+      RPDVolumetricPart::Piece piece;
+      piece.seed = v;
+      piece.volume = volume;
+      piece.moment = moment;
+      part_.pieces.push_back(piece);
+    }
+
+   private:
+    RPDVolumetricPart& part_;
+  };
+
   // Empty class doing nothing but print
   // this is for dubug only
   class DebugBuildRPD {
@@ -843,28 +965,34 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
 
   /**
    * Helper function for building RPD surfacic mesh in parallel
+   * \details Each part fills its own RPDPartMeshBuilder without any lock,
+   *  part meshes are then merged by merge_RPD_part_meshes().
+   * \return false if no parts were created (caller should run sequentially)
    **/
-  virtual void build_rpd_mesh_surfacic(BuildRPD<RPDMeshBuilder>& build_rpd) {
-    // printf("calling build_rpd_mesh_surfacic ...\n");
+  virtual bool build_rpd_mesh_surfacic(
+      GEO::Mesh& M,
+      std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_seed_adj,
+      std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_vs_bisectors) {
     create_threads();
-    if (nb_parts() == 0) {
-      // printf("in build_rpd_mesh_surfacic nb_parts() == 0\n");
-      // PolygonCallbackAction action(RPD_,polygon_callback);
-      RPD_.for_each_polygon(build_rpd);
-    } else {
-      // printf("in build_rpd_mesh_surfacic nb_parts() != 0\n");
+    if (nb_parts() == 0) return false;
 
-      for (index_t t = 0; t < nb_parts(); t++) {
-        part(t).RPD_.set_symbolic(RPD_.symbolic());
-        part(t).RPD_.set_connected_components_priority(
-            RPD_.connected_components_priority());
-      }
-      // Note: we need global lock here, managed by BuildRPD
-      thread_mode_ = MT_RPD_S_MESH;
-      build_rpd_ = &build_rpd;
-      // Note: callback begin()/end() is called in for_each_polygon()
-      parallel_for(0, nb_parts(), [this](index_t i) { run_thread(i); });
+    for (index_t t = 0; t < nb_parts(); t++) {
+      part(t).RPD_.set_symbolic(RPD_.symbolic());
+      part(t).RPD_.set_connected_components_priority(
+          RPD_.connected_components_priority());
+    }
+    std::vector<RPDPartMeshBuilder> part_builders(nb_parts());
+    for (index_t t = 0; t < nb_parts(); t++) {
+      part_builders[t].reserve(mesh_->facets.nb() / nb_parts() + 1);
     }
+    thread_mode_ = MT_RPD_S_MESH;
+    part_builders_ = &part_builders;
+    run_parts("RPD mesh");
+    part_builders_ = nullptr;
+
+    merge_RPD_part_meshes(part_builders, M, rpd_seed_adj, rpd_vs_bisectors,
+                          keep_vertex_keys_ ? &last_vertex_keys_ : nullptr);
+    return true;
   }
 
   void compute_RPD(
@@ -873,37 +1001,267 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
       std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_vs_bisectors,
       GEO::coord_index_t dim, bool cell_borders_only,
       bool integration_simplices, bool is_parallel) override {
+    PROFILE_ZONE("RPD compute");
+    if (volumetric_) {
+      // no volumetric mesh, only the adjacency of the restricted cells
+      printf("computing RPD volumetric, seed adjacency only ...\n");
+      RPDVolumetricCells cells;
+      compute_RPD_volumetric(cells, is_parallel);
+      if (rpd_seed_adj != nullptr) *rpd_seed_adj = std::move(cells.seed_adj);
+      // bisectors are per vertex of M
+      if (rpd_vs_bisectors != nullptr) rpd_vs_bisectors->clear();
+      M.clear();
+      if (keys_mesh_ == &M) set_vertex_keys_mesh(nullptr);
+      return;
+    }
     bool sym = RPD_.symbolic();
     RPD_.set_symbolic(true);
-
-    if (volumetric_) {
-      printf("ERROR: cannot compute volumetric RPD.\n");
-      assert(false);
-    } else {  // surfacic
-
+    // seeds (x,y,z,w) read by all clipping predicates
+    if (!rt_->has_seed_cache()) rt_->build_seed_cache();
+    if (!rt_->has_neighbor_csr()) rt_->build_neighbor_csr();
+    // start points of seed location, see find_seed_near_point()
+    if (!rt_->has_seed_locator()) rt_->build_seed_locator();
+
+    if (is_parallel) {
+      printf("computing RPD surfacic in parallel ...\n");
+      is_parallel = build_rpd_mesh_surfacic(M, rpd_seed_adj, rpd_vs_bisectors);
+    }
+    if (!is_parallel) {
+      printf("computing RPD surfacic in sequence ...\n");
+      PROFILE_ZONE("RPD mesh sequential");
       matfp::RPDMeshBuilder builder(&M, mesh_, rpd_seed_adj, rpd_vs_bisectors);
       if (dim != 0) {
         builder.set_dimension(dim);
       }
+      builder.set_record_keys(keep_vertex_keys_);
       BuildRPD<RPDMeshBuilder> build_rpd_action(RPD_, builder);
+      RPD_.for_each_polygon(build_rpd_action);
+      if (keep_vertex_keys_) last_vertex_keys_ = builder.vertex_keys();
+    }
+    if (keep_vertex_keys_) {
+      set_vertex_keys_mesh(&M);
+    } else if (keys_mesh_ == &M) {
+      set_vertex_keys_mesh(nullptr);
+    }
 
-      if (is_parallel) {
-        printf("computing RPD surfacic in parallel ...\n");
-        build_rpd_mesh_surfacic(build_rpd_action);
-      } else {
-        printf("computing RPD surfacic in sequence ...\n");
-        RPD_.for_each_polygon(build_rpd_action);
+    // RPD_.for_each_polygon(
+    //     DebugBuildRPD()
+    // );
+
+    // printf("after for_each_polygon\n");
+    // std::cout << "in compute_RPD, finish for_each_polygon" << std::endl;
+
+    RPD_.set_symbolic(sym);
+    print_clip_stats();
+    M.show_stats("RPD");
+  }
+
+  void compute_RPD_streaming(RPDPolygonSink& sink, bool is_parallel,
+                             index_t batch_corners) override {
+    PROFILE_ZONE("RPD streaming");
+    geo_assert(!volumetric_);
+    bool sym = RPD_.symbolic();
+    // vertex keys are made from the symbolic information
+    RPD_.set_symbolic(true);
+    if (!rt_->has_seed_cache()) rt_->build_seed_cache();
+    if (!rt_->has_neighbor_csr()) rt_->build_neighbor_csr();
+    if (!rt_->has_seed_locator()) rt_->build_seed_locator();
+
+    sink.begin();
+    if (is_parallel) {
+      create_threads();
+      is_parallel = nb_parts() != 0;
+    }
+    if (is_parallel) {
+      printf("streaming RPD surfacic in parallel ...\n");
+      for (index_t t = 0; t < nb_parts(); t++) {
+        part(t).RPD_.set_symbolic(RPD_.symbolic());
+        part(t).RPD_.set_connected_components_priority(
+            RPD_.connected_components_priority());
       }
+      std::mutex sink_mutex;
+      thread_mode_ = MT_RPD_S_STREAM;
+      stream_sink_ = &sink;
+      stream_mutex_ = &sink_mutex;
+      stream_batch_corners_ = batch_corners;
+      run_parts("RPD stream");
+      stream_sink_ = nullptr;
+      stream_mutex_ = nullptr;
+    } else {
+      printf("streaming RPD surfacic in sequence ...\n");
+      PROFILE_ZONE("RPD stream sequential");
+      RPDStreamBuilder builder(sink, nullptr, batch_corners);
+      // BuildRPD flushes the last batch when going out of scope
+      BuildRPD<RPDStreamBuilder> build_rpd_action(RPD_, builder);
+      RPD_.for_each_polygon(build_rpd_action);
+    }
+    sink.end();
 
-      // RPD_.for_each_polygon(
-      //     DebugBuildRPD()
-      // );
+    RPD_.set_symbolic(sym);
+    print_clip_stats();
+  }
 
-      // printf("after for_each_polygon\n");
-      // std::cout << "in compute_RPD, finish for_each_polygon" << std::endl;
+  void compute_RPD_volumetric(RPDVolumetricCells& cells,
+                              bool is_parallel) override {
+    PROFILE_ZONE("RPD volumetric");
+    geo_assert(volumetric_);
+    geo_assert(mesh_->cells.nb() != 0 && mesh_->cells.are_simplices());
+    bool sym = RPD_.symbolic();
+    // side_exact() classifies cell vertices from their symbolic information
+    RPD_.set_symbolic(true);
+    if (!rt_->has_seed_cache()) rt_->build_seed_cache();
+    if (!rt_->has_neighbor_csr()) rt_->build_neighbor_csr();
+    if (!rt_->has_seed_locator()) rt_->build_seed_locator();
+
+    std::vector<RPDVolumetricPart> volume_parts;
+    if (is_parallel) {
+      create_threads();
+      is_parallel = nb_parts() != 0;
+    }
+    if (is_parallel) {
+      printf("computing RPD volumetric in parallel ...\n");
+      for (index_t t = 0; t < nb_parts(); t++) {
+        part(t).RPD_.set_symbolic(RPD_.symbolic());
+        part(t).RPD_.set_connected_components_priority(
+            RPD_.connected_components_priority());
+      }
+      volume_parts.resize(nb_parts());
+      thread_mode_ = MT_RPD_V_CELLS;
+      volume_parts_ = &volume_parts;
+      run_parts("RPD cells");
+      volume_parts_ = nullptr;
+    } else {
+      printf("computing RPD volumetric in sequence ...\n");
+      PROFILE_ZONE("RPD cells sequential");
+      volume_parts.resize(1);
+      AccumulateRPDCells accumulate(volume_parts[0]);
+      RPD_.for_each_polyhedron(accumulate);
     }
+    merge_RPD_volumetric_parts(volume_parts, cells);
 
     RPD_.set_symbolic(sym);
+    print_clip_stats();
+    cells.print();
+  }
+
+  /**
+   * \brief Sums the restricted cells of all parts per seed.
+   * \details A seed whose cell spans several tetrahedra ranges has
+   *  pieces in several parts.
+   */
+  void merge_RPD_volumetric_parts(std::vector<RPDVolumetricPart>& volume_parts,
+                                  RPDVolumetricCells& cells) {
+    PROFILE_ZONE("RPD volumetric merge");
+    index_t nb_seeds = index_t(rt_->get_nb_vertices());
+    cells.volumes.assign(nb_seeds, 0.0);
+    cells.centroids.assign(nb_seeds, vec3(0.0, 0.0, 0.0));
+    cells.seed_adj.clear();
+    cells.nb_polyhedra = 0;
+    // a bisector facet is seen once per tetrahedron it crosses
+    parallel_for(0, index_t(volume_parts.size()), [&](index_t p) {
+      std::vector<std::pair<index_t, index_t>>& pairs =
+          volume_parts[p].seed_pairs;
+      std::sort(pairs.begin(), pairs.end());
+      pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    });
+    for (const RPDVolumetricPart& vpart : volume_parts) {
+      cells.nb_polyhedra += index_t(vpart.pieces.size());
+      for (const RPDVolumetricPart::Piece& piece : vpart.pieces) {
+        cells.volumes[piece.seed] += piece.volume;
+        cells.centroids[piece.seed] += piece.moment;
+      }
+      for (const std::pair<index_t, index_t>& seed_pair : vpart.seed_pairs) {
+        cells.seed_adj[seed_pair.first].insert(seed_pair.second);
+        cells.seed_adj[seed_pair.second].insert(seed_pair.first);
+      }
+    }
+    for (index_t s = 0; s < nb_seeds; s++) {
+      if (cells.volumes[s] > 0.0) cells.centroids[s] /= cells.volumes[s];
+    }
+  }
+
+  // tests whether last_vertex_keys_ are the keys of the vertices of M,
+  // i.e. M is unchanged since compute_RPD() or compute_RPD_incremental()
+  bool has_vertex_keys(const GEO::Mesh& M) const {
+    return keys_mesh_ == &M && keys_nb_vertices_ == M.vertices.nb() &&
+           keys_nb_facets_ == M.facets.nb() &&
+           last_vertex_keys_.size() == M.vertices.nb();
+  }
+
+  void set_vertex_keys_mesh(const GEO::Mesh* M) {
+    keys_mesh_ = M;
+    keys_nb_vertices_ = (M == nullptr) ? 0 : M->vertices.nb();
+    keys_nb_facets_ = (M == nullptr) ? 0 : M->facets.nb();
+    if (M == nullptr) last_vertex_keys_.clear();
+  }
+
+  void compute_RPD_incremental(
+      GEO::Mesh& M,
+      std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_seed_adj,
+      std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_vs_bisectors,
+      const std::set<int>& changed_tags) override {
+    PROFILE_ZONE("RPD incremental");
+    if (volumetric_ || !has_vertex_keys(M) ||
+        !M.facets.attributes().is_defined("region") ||
+        !M.facets.attributes().is_defined("ref_facet")) {
+      printf("no previous RPD, compute RPD from scratch ...\n");
+      // keys are needed by the next call
+      bool keep_keys = keep_vertex_keys_;
+      keep_vertex_keys_ = !volumetric_;
+      compute_RPD(M, rpd_seed_adj, rpd_vs_bisectors);
+      keep_vertex_keys_ = keep_keys;
+      return;
+    }
+    if (!rt_->has_seed_cache()) rt_->build_seed_cache();
+    if (!rt_->has_neighbor_csr()) rt_->build_neighbor_csr();
+    if (!rt_->has_seed_locator()) rt_->build_seed_locator();
+
+    // changed seeds and their RT neighbors
+    std::vector<char> seed_is_dirty(rt_->get_nb_vertices(), 0);
+    for (const int tag : changed_tags) {
+      if (tag < 0 || tag >= rt_->get_nb_vertices()) continue;
+      seed_is_dirty[tag] = 1;
+      if (!rt_->is_in_rt(tag)) continue;
+      for (Vertex_handle_rt& n : rt_->get_neighbors(tag))
+        seed_is_dirty[n->info().tag] = 1;
+    }
+
+    // reference facets covered by a polygon of a dirty seed
+    std::vector<char> facet_is_dirty(mesh_->facets.nb(), 0);
+    {
+      Attribute<index_t> region(M.facets.attributes(), "region");
+      Attribute<index_t> ref_facet(M.facets.attributes(), "ref_facet");
+      for (index_t f = 0; f < M.facets.nb(); f++) {
+        // removed seeds may have tags beyond nb_vertices
+        if (region[f] >= seed_is_dirty.size() || seed_is_dirty[region[f]])
+          facet_is_dirty[ref_facet[f]] = 1;
+      }
+    }
+    index_t nb_dirty = 0;
+    for (char d : facet_is_dirty) nb_dirty += d;
+    printf("computing RPD incrementally for %u/%u facets ...\n", nb_dirty,
+           mesh_->facets.nb());
+
+    // previous polygons on clean facets + new polygons on dirty facets,
+    // vertices on the border are merged by symbolic key; dirty facets are
+    // clipped sequentially
+    std::vector<RPDPartMeshBuilder> splice(2);
+    splice[0].load_from_mesh(M, last_vertex_keys_, facet_is_dirty);
+    splice[1].reserve(nb_dirty);
+    bool sym = RPD_.symbolic();
+    RPD_.set_symbolic(true);
+    RPD_.set_facet_filter(&facet_is_dirty);
+    {
+      BuildRPD<RPDPartMeshBuilder> build_dirty(RPD_, splice[1]);
+      RPD_.for_each_polygon(build_dirty);
+    }
+    RPD_.set_facet_filter(nullptr);
+    RPD_.set_symbolic(sym);
+
+    merge_RPD_part_meshes(splice, M, rpd_seed_adj, rpd_vs_bisectors,
+                          &last_vertex_keys_);
+    set_vertex_keys_mesh(&M);
+    print_clip_stats();
     M.show_stats("RPD");
   }
 
@@ -939,6 +1297,9 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
     bool sym_backup = RPD_.symbolic();
     RPD_.set_symbolic(symbolic);
     RPD_.set_connected_components_priority(connected_comp_priority);
+    if (!rt_->has_seed_cache()) rt_->build_seed_cache();
+    if (!rt_->has_neighbor_csr()) rt_->build_neighbor_csr();
+    if (!rt_->has_seed_locator()) rt_->build_seed_locator();
     callback.begin();
     if (parallel) {
       compute_with_polygon_callback(callback);
@@ -958,6 +1319,9 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
     RPD_.set_symbolic(symbolic);
     RPD_.set_connected_components_priority(connected_comp_priority);
     callback.set_dimension(RPD_.mesh()->vertices.dimension());
+    if (!rt_->has_seed_cache()) rt_->build_seed_cache();
+    if (!rt_->has_neighbor_csr()) rt_->build_neighbor_csr();
+    if (!rt_->has_seed_locator()) rt_->build_seed_locator();
     callback.begin();
     if (parallel) {
       compute_with_polyhedron_callback(callback);
@@ -1001,13 +1365,68 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
         T.compute_with_polyhedron_callback(*polyhedron_callback_);
       } break;
       case MT_RPD_S_MESH: {
-        T.build_rpd_mesh_surfacic(*build_rpd_);
+        // BuildRPD ends the part surface when going out of scope
+        BuildRPD<RPDPartMeshBuilder> build_part(T.RPD_,
+                                                (*part_builders_)[t]);
+        T.RPD_.for_each_polygon(build_part);
+      } break;
+      case MT_RPD_S_STREAM: {
+        RPDStreamBuilder builder(*stream_sink_, stream_mutex_,
+                                 stream_batch_corners_);
+        BuildRPD<RPDStreamBuilder> build_part(T.RPD_, builder);
+        T.RPD_.for_each_polygon(build_part);
+      } break;
+      case MT_RPD_V_CELLS: {
+        AccumulateRPDCells accumulate((*volume_parts_)[t]);
+        T.RPD_.for_each_polyhedron(accumulate);
       } break;
       case MT_NONE:
         geo_assert_not_reached;
     }
   }
 
+  /**
+   * \brief Runs run_thread() on all parts with the work-stealing
+   *    scheduler and prints the timing of each part.
+   * \param[in] name prefix of the printed timings
+   */
+  void run_parts(const char* name) {
+    ChunkScheduler scheduler(nb_parts(), Process::maximum_concurrent_threads());
+    scheduler.run([this, name](index_t i) {
+      PROFILE_ZONE_ID(name, i);
+      run_thread(i);
+    });
+    scheduler.print_timings(name);
+  }
+
+  /**
+   * \brief Prints (and resets) the number of bisector clips done and
+   *    skipped by the radius of security, summed over all parts, and
+   *    the filter hit rates of the exact predicates.
+   * \details Does nothing unless compiled with -DRPD_STATS.
+   */
+  void print_clip_stats() {
+#ifdef RPD_STATS
+    GEO::uint64 nb_clips = RPD_.nb_clips();
+    GEO::uint64 nb_skipped = RPD_.nb_clips_skipped();
+    RPD_.reset_clip_stats();
+    for (index_t p = 0; p < nb_parts_; ++p) {
+      nb_clips += parts_[p].RPD_.nb_clips();
+      nb_skipped += parts_[p].RPD_.nb_clips_skipped();
+      parts_[p].RPD_.reset_clip_stats();
+    }
+    if (RPD_.exact_predicates()) {
+      matfp::PCK::show_power_side_stats();
+      matfp::PCK::reset_power_side_stats();
+    }
+    if (!RPD_.check_SR()) return;
+    GEO::uint64 total = nb_clips + nb_skipped;
+    printf("[RPD] security radius: %llu clips, %llu skipped (%.1f%%)\n",
+           (unsigned long long)nb_clips, (unsigned long long)nb_skipped,
+           total == 0 ? 0. : 100. * double(nb_skipped) / double(total));
+#endif  // RPD_STATS
+  }
+
   /********************************************************************/
 
   void set_delaunay(RegularTriangulationNN* rt) override {
@@ -1026,12 +1445,18 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
   }
 
   void set_exact_predicates(bool x) override {
-    RPD_.set_exact_predicates(x);
+    set_precision(x ? RPD_EXACT : RPD_FAST);
+  }
+
+  void set_precision(RPDPrecision x) override {
+    RPD_.set_precision(x);
     for (index_t p = 0; p < nb_parts_; ++p) {
-      parts_[p].set_exact_predicates(x);
+      parts_[p].set_precision(x);
     }
   }
 
+  RPDPrecision precision() const override { return RPD_.precision(); }
+
   void create_threads() override {
     // TODO: check if number of facets is not smaller than
     // number of threads
@@ -1040,15 +1465,28 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
     if (is_slave_ || facets_begin_ != -1 || facets_end_ != -1) {
       return;
     }
-    index_t nb_parts_in = Process::maximum_concurrent_threads();
+    // Over-decompose into many small Hilbert chunks, balanced at runtime
+    // by run_parts(). Dense regions of spheres (sharp features, concave
+    // lines) make some chunks much slower than others.
+    index_t nb_threads = Process::maximum_concurrent_threads();
+    index_t nb_parts_in = nb_threads;
+    index_t nb_elements = volumetric_ ? mesh_->cells.nb() : mesh_->facets.nb();
+    if (nb_threads > 1) {
+      nb_parts_in = std::min(nb_threads * RPD_CHUNKS_PER_THREAD,
+                             nb_elements / RPD_MIN_FACETS_PER_CHUNK);
+      nb_parts_in = std::max(nb_parts_in, nb_threads);
+    }
     if (nb_parts() != nb_parts_in) {
       if (nb_parts_in == 1) {
         delete_threads();
       } else {
         vector<index_t> facet_ptr;
         vector<index_t> tet_ptr;
-        mesh_partition(*mesh_, MESH_PARTITION_HILBERT, facet_ptr, tet_ptr,
-                       nb_parts_in);
+        {
+          PROFILE_ZONE("RPD partition");
+          mesh_partition(*mesh_, MESH_PARTITION_HILBERT, facet_ptr, tet_ptr,
+                         nb_parts_in);
+        }
         delete_threads();
         parts_ = new thisclass[nb_parts_in];
         nb_parts_ = nb_parts_in;
@@ -1060,23 +1498,25 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
           part(i).master_ = this;
           part(i).RPD_.set_mesh(mesh_);
           part(i).set_facets_range(facet_ptr[i], facet_ptr[i + 1]);
-          part(i).set_exact_predicates(RPD_.exact_predicates());
-          // part(i).set_volumetric(volumetric());
+          part(i).set_precision(RPD_.precision());
+          part(i).set_volumetric(volumetric());
           part(i).set_check_SR(RPD_.check_SR());
         }
-        // if(mesh_->cells.nb() != 0) {
-        //     for(index_t i = 0; i < nb_parts(); ++i) {
-        //         part(i).set_tetrahedra_range(
-        //             tet_ptr[i], tet_ptr[i + 1]
-        //         );
-        //     }
-        // }
+        if (mesh_->cells.nb() != 0) {
+          for (index_t i = 0; i < nb_parts(); ++i) {
+            part(i).set_tetrahedra_range(tet_ptr[i], tet_ptr[i + 1]);
+          }
+        }
         geo_assert(!Process::is_running_threads());
       }
     }
   }
 
   void set_volumetric(bool x) override {
+    // parts are chunks of facets or of tetrahedra
+    if (!is_slave_ && x != volumetric_) {
+      delete_threads();
+    }
     volumetric_ = x;
     for (index_t i = 0; i < nb_parts(); ++i) {
       part(i).set_volumetric(x);
@@ -1089,6 +1529,12 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
     facets_end_ = signed_index_t(facets_end);
   }
 
+  void set_tetrahedra_range(index_t tets_begin, index_t tets_end) override {
+    RPD_.set_tetrahedra_range(tets_begin, tets_end);
+    tets_begin_ = signed_index_t(tets_begin);
+    tets_end_ = signed_index_t(tets_end);
+  }
+
   void delete_threads() override {
     delete[] parts_;
     parts_ = nullptr;
@@ -1096,7 +1542,7 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
   }
 
   /**
-   * \brief Gets the number of parts (or number of threads).
+   * \brief Gets the number of parts (facet chunks, several per thread).
    */
   index_t nb_parts() const { return nb_parts_; }
 
@@ -1113,7 +1559,7 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
   /**
    * \copydoc RestrictedVoronoiDiagram::point_allocator()
    */
-  GEOGen::PointAllocator* point_allocator() override {
+  RPDPointArena* point_allocator() override {
     return RPD_.point_allocator();
   }
 
@@ -1147,7 +1593,24 @@ class RPD_3d_Impl : public matfp::RestrictedPowerDiagram {
   // NO implementation, use RVD
   RPDPolyhedronCGALCallback* polyhedron_callback_;
 
-  BuildRPD<RPDMeshBuilder>* build_rpd_;
+  // Build surfacic RPD mesh mode, one builder per part
+  std::vector<RPDPartMeshBuilder>* part_builders_;
+
+  // Streaming mode, shared by all parts
+  RPDPolygonSink* stream_sink_;
+  std::mutex* stream_mutex_;
+  index_t stream_batch_corners_;
+
+  // Volumetric RPD cells mode, one storage per part
+  std::vector<RPDVolumetricPart>* volume_parts_;
+
+  // symbolic key of each vertex of the last computed RPD mesh,
+  // used by compute_RPD_incremental()
+  std::vector<RPDVertexKey> last_vertex_keys_;
+  // mesh the keys belong to, and its size when they were computed
+  const GEO::Mesh* keys_mesh_;
+  index_t keys_nb_vertices_;
+  index_t keys_nb_facets_;
 
   // master stores argument for compute_centroids() and
   // compute_CVT_func_grad() to pass it to the parts.
@@ -1200,6 +1663,130 @@ RestrictedPowerDiagram* RestrictedPowerDiagram::create(
 
 RestrictedPowerDiagram::~RestrictedPowerDiagram() {}
 
+namespace {
+
+typedef std::map<GEO::index_t, std::set<GEO::index_t>> SeedAdjacency;
+
+// computes the RPD with one precision, returns the wall time
+double compute_RPD_with_precision(RestrictedPowerDiagram* rpd,
+                                  RPDPrecision precision, bool is_parallel,
+                                  GEO::Mesh& M, SeedAdjacency& seed_adj) {
+  SeedAdjacency vs_bisectors;
+  rpd->set_precision(precision);
+  std::int64_t start = profiler::now_ns();
+  rpd->compute_RPD(M, &seed_adj, &vs_bisectors, 0, false, false, is_parallel);
+  return double(profiler::now_ns() - start) * 1e-9;
+}
+
+// number of polygons per seed ("region" facet attribute)
+std::map<GEO::index_t, index_t> count_seed_polygons(GEO::Mesh& M) {
+  std::map<GEO::index_t, index_t> counts;
+  Attribute<GEO::index_t> region(M.facets.attributes(), "region");
+  for (index_t f = 0; f < M.facets.nb(); ++f) counts[region[f]]++;
+  return counts;
+}
+
+// pairs (i,j) of adj1 not in adj2, each pair counted once (i < j)
+index_t count_missing_pairs(const SeedAdjacency& adj1,
+                            const SeedAdjacency& adj2) {
+  index_t nb = 0;
+  for (const auto& seed_neighs : adj1) {
+    auto it = adj2.find(seed_neighs.first);
+    for (GEO::index_t neigh : seed_neighs.second) {
+      if (neigh <= seed_neighs.first) continue;
+      if (it == adj2.end() || it->second.count(neigh) == 0) nb++;
+    }
+  }
+  return nb;
+}
+
+index_t count_pairs(const SeedAdjacency& adj) {
+  return count_missing_pairs(adj, SeedAdjacency());
+}
+
+}  // namespace
+
+RPDPrecisionReport validate_RPD_precision(RestrictedPowerDiagram* rpd,
+                                          RPDPrecision precision,
+                                          bool is_parallel) {
+  PROFILE_ZONE("RPD validate precision");
+  RPDPrecision old_precision = rpd->precision();
+  // temporary meshes are not used by compute_RPD_incremental()
+  bool old_keep_keys = rpd->keep_vertex_keys();
+  rpd->set_keep_vertex_keys(false);
+  RPDPrecisionReport report;
+  report.precision = precision;
+
+  GEO::Mesh M_exact, M;
+  SeedAdjacency adj_exact, adj;
+  report.seconds_exact = compute_RPD_with_precision(
+      rpd, RPD_EXACT, is_parallel, M_exact, adj_exact);
+  report.seconds =
+      compute_RPD_with_precision(rpd, precision, is_parallel, M, adj);
+  rpd->set_precision(old_precision);
+  rpd->set_keep_vertex_keys(old_keep_keys);
+
+  report.nb_polygons_exact = M_exact.facets.nb();
+  report.nb_polygons = M.facets.nb();
+  report.nb_adj_exact = count_pairs(adj_exact);
+  report.nb_adj = count_pairs(adj);
+  report.nb_adj_missing = count_missing_pairs(adj_exact, adj);
+  report.nb_adj_extra = count_missing_pairs(adj, adj_exact);
+
+  std::map<GEO::index_t, index_t> counts_exact = count_seed_polygons(M_exact);
+  std::map<GEO::index_t, index_t> counts = count_seed_polygons(M);
+  std::set<GEO::index_t> seeds;
+  for (const auto& c : counts_exact) seeds.insert(c.first);
+  for (const auto& c : counts) seeds.insert(c.first);
+  for (GEO::index_t seed : seeds) {
+    auto c1 = counts_exact.find(seed), c2 = counts.find(seed);
+    auto a1 = adj_exact.find(seed), a2 = adj.find(seed);
+    bool is_same_count = c1 != counts_exact.end() && c2 != counts.end() &&
+                         c1->second == c2->second;
+    bool is_same_adj = (a1 == adj_exact.end() || a1->second.empty())
+                           ? (a2 == adj.end() || a2->second.empty())
+                           : (a2 != adj.end() && a1->second == a2->second);
+    if (!is_same_count || !is_same_adj) report.nb_seeds_differ++;
+  }
+  return report;
+}
+
+void RPDPrecisionReport::print() const {
+  static const char* names[] = {"exact", "filtered", "fast"};
+  const bool is_known = precision >= RPD_EXACT && precision <= RPD_FAST;
+  printf("[RPD] precision %s vs exact: %s\n",
+         is_known ? names[precision] : "unknown",
+         is_same() ? "same" : "DIFFERENT");
+  printf("[RPD]   polygons: %u / %u exact, seeds differing: %u\n",
+         nb_polygons, nb_polygons_exact, nb_seeds_differ);
+  printf("[RPD]   seed adjacency: %u / %u exact, %u missing, %u extra\n",
+         nb_adj, nb_adj_exact, nb_adj_missing, nb_adj_extra);
+  printf("[RPD]   time: %.3fs / %.3fs exact\n", seconds, seconds_exact);
+}
+
+index_t RPDVolumetricCells::nb_cells() const {
+  index_t nb = 0;
+  for (double volume : volumes) {
+    if (volume > 0.0) nb++;
+  }
+  return nb;
+}
+
+double RPDVolumetricCells::total_volume() const {
+  double total = 0.0;
+  for (double volume : volumes) total += volume;
+  return total;
+}
+
+void RPDVolumetricCells::print() const {
+  index_t nb_adj = 0;
+  for (const auto& adj : seed_adj) nb_adj += index_t(adj.second.size());
+  printf("[RPD] volumetric: %u / %zu seeds with a cell, %u polyhedra\n",
+         nb_cells(), volumes.size(), nb_polyhedra);
+  printf("[RPD]   total volume: %g, adjacent seed pairs: %u\n",
+         total_volume(), nb_adj / 2);
+}
+
 RestrictedPowerDiagram::RestrictedPowerDiagram(RegularTriangulationNN* rt,
                                                Mesh* mesh,
                                                const double* R3_embedding,
@@ -1214,7 +1801,8 @@ RestrictedPowerDiagram::RestrictedPowerDiagram(RegularTriangulationNN* rt,
   facets_end_ = -1;
   tets_begin_ = -1;
   tets_end_ = -1;
-  // volumetric_ = false;
+  volumetric_ = false;
+  keep_vertex_keys_ = false;
 }
 
 void RestrictedPowerDiagram::set_delaunay(RegularTriangulationNN* rt) {
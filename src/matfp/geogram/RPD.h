@@ -55,6 +55,7 @@
 
 #include "RPD_callback.h"
 #include "RPD_mesh_builder.h"
+#include "RPD_polygon_sink.h"
 #include "common_cxx.h"
 #include "generic_RPD.h"
 #include "triangulation.h"
@@ -62,7 +63,29 @@
 namespace matfp {
 using namespace GEO;
 
-using GEOGen::PointAllocator;
+
+/**
+ * \brief Power cells restricted to the volume, one entry per seed tag.
+ * \details Seeds with an empty restricted cell have a zero volume and
+ *  centroid, and no adjacency.
+ */
+struct RPDVolumetricCells {
+  std::vector<double> volumes;
+  std::vector<GEO::vec3> centroids;
+  // seeds whose restricted cells share a bisector facet
+  std::map<GEO::index_t, std::set<GEO::index_t>> seed_adj;
+  index_t nb_polyhedra = 0;  // non-empty (seed, tetrahedron) intersections
+
+  /**
+   * \brief Gets the number of seeds with a non-empty restricted cell.
+   */
+  index_t nb_cells() const;
+  /**
+   * \brief Gets the sum of the volumes of all restricted cells.
+   */
+  double total_volume() const;
+  void print() const;
+};
 
 class GEOGRAM_API RestrictedPowerDiagram : public GEO::Counted {
  public:
@@ -82,6 +105,8 @@ class GEOGRAM_API RestrictedPowerDiagram : public GEO::Counted {
   /**
    * \brief Computes the restricted Power diagram and stores it
    *  in a mesh.
+   * \details In volumetric mode, only \p rpd_seed_adj is computed (see
+   *  compute_RPD_volumetric()), \p M and \p facet_adj_seeds are cleared.
    * \param[out] M the computed restricted Voronoi diagram
    * \param[in] dim if different from 0, use only the
    *  first dim coordinates
@@ -102,6 +127,55 @@ class GEOGRAM_API RestrictedPowerDiagram : public GEO::Counted {
       GEO::coord_index_t dim = 0, bool cell_borders_only = false,
       bool integration_simplices = false, bool is_parallel = true) = 0;
 
+  /**
+   * \brief Computes the surfacic restricted Power diagram and streams its
+   *  polygons to \p sink, without building a mesh.
+   * \details Each running part holds one batch of about \p batch_corners
+   *  corners and flushes it to \p sink when full, so memory does not
+   *  depend on the size of the output. Polygons carry the same seed
+   *  ("region") and reference facet ("ref_facet") as in compute_RPD(),
+   *  vertices are identified by their symbolic key.
+   * \param[in] sink receives the batches, consume() calls are serialized
+   * \param[in] is_parallel if true, tentatively parallelize computation
+   * \param[in] batch_corners number of corners that triggers a flush
+   */
+  virtual void compute_RPD_streaming(
+      RPDPolygonSink& sink, bool is_parallel = true,
+      index_t batch_corners = RPD_STREAM_BATCH_CORNERS) = 0;
+
+  /**
+   * \brief Computes the volumetric restricted Power diagram, i.e. the
+   *  intersections of the power cells with the tetrahedra of the input
+   *  mesh, and accumulates them per seed.
+   * \details The input mesh must have tetrahedra and volumetric mode
+   *  must be set. In parallel mode, tetrahedra are partitioned into
+   *  contiguous (Hilbert sorted) ranges, one per part.
+   * \param[out] cells per seed volume, centroid and adjacency
+   * \param[in] is_parallel if true, tentatively parallelize computation
+   */
+  virtual void compute_RPD_volumetric(RPDVolumetricCells& cells,
+                                      bool is_parallel = true) = 0;
+
+  /**
+   * \brief Recomputes the restricted Power diagram only where seeds
+   *  changed, and splices the result into the previous output.
+   * \details Dirty reference facets are the ones with a previous polygon
+   *  whose seed is in \p changed_tags or is a RT neighbor of one of them.
+   *  Only dirty facets are clipped again, their polygons replace the old
+   *  ones in \p M, and both adjacency maps are updated. Dirty facets
+   *  are clipped sequentially. Falls back to compute_RPD() if \p M was
+   *  not computed by this object with set_keep_vertex_keys(true), or was
+   *  modified since.
+   * \param[in,out] M previous output of compute_RPD() (surfacic mode)
+   * \param[in] changed_tags RT tags whose star changed, see
+   *  update_RT_CGAL_incremental()
+   */
+  virtual void compute_RPD_incremental(
+      GEO::Mesh& M,
+      std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_seed_adj,
+      std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_vs_bisectors,
+      const std::set<int>& changed_tags) = 0;
+
   /**
    * \brief Gets the dimension used by this RestrictedPowerDiagram.
    */
@@ -117,6 +191,18 @@ class GEOGRAM_API RestrictedPowerDiagram : public GEO::Counted {
    */
   virtual void set_delaunay(RegularTriangulationNN* rt);
 
+  /**
+   * \brief Specifies whether compute_RPD() keeps the symbolic key of
+   *  each vertex of its output, needed by compute_RPD_incremental().
+   * \details Off by default, keys cost 20 bytes per vertex.
+   */
+  void set_keep_vertex_keys(bool x) { keep_vertex_keys_ = x; }
+
+  /**
+   * \brief Tests whether compute_RPD() keeps vertex keys.
+   */
+  bool keep_vertex_keys() const { return keep_vertex_keys_; }
+
   /**
    * \brief Tests whether volumetric mode is used.
    */
@@ -175,6 +261,16 @@ class GEOGRAM_API RestrictedPowerDiagram : public GEO::Counted {
    *  be used.
    */
   virtual void set_exact_predicates(bool x) = 0;
+  /**
+   * \brief Sets the precision tier of bisector clipping, in all parts.
+   * \details set_exact_predicates(true) is RPD_EXACT (the default),
+   *  set_exact_predicates(false) is RPD_FAST.
+   */
+  virtual void set_precision(RPDPrecision x) = 0;
+  /**
+   * \brief Gets the precision tier of bisector clipping.
+   */
+  virtual RPDPrecision precision() const = 0;
   /**
    * \brief Partitions the mesh and creates
    *  local storage for multithreaded implementation.
@@ -195,12 +291,20 @@ class GEOGRAM_API RestrictedPowerDiagram : public GEO::Counted {
    */
   virtual void set_facets_range(index_t facets_begin, index_t facets_end) = 0;
   /**
-   * \brief Gets the PointAllocator.
-   * \return a pointer to the PointAllocator, used
+   * \brief Restricts volumetric computations to a part of the input mesh.
+   * \details The part of the input mesh should be specified as
+   *    a contiguous range of tetrahedra indices.
+   * \param[in] tets_begin first tetrahedron in the range
+   * \param[in] tets_end one past last tetrahedron in the range
+   */
+  virtual void set_tetrahedra_range(index_t tets_begin, index_t tets_end) = 0;
+  /**
+   * \brief Gets the RPDPointArena.
+   * \return a pointer to the RPDPointArena, used
    *  to create the new vertices generated by
    *  intersections.
    */
-  virtual GEOGen::PointAllocator* point_allocator() = 0;
+  virtual RPDPointArena* point_allocator() = 0;
 
  protected:
   /**
@@ -227,9 +331,46 @@ class GEOGRAM_API RestrictedPowerDiagram : public GEO::Counted {
   signed_index_t tets_begin_;
   signed_index_t tets_end_;
   bool volumetric_;
+  bool keep_vertex_keys_;
 };
 
 /** \brief Smart pointer to a RestrictedPowerDiagram object */
 typedef GEO::SmartPointer<RestrictedPowerDiagram> RestrictedPowerDiagram_var;
 
+/**
+ * \brief Differences between a RPD computed with one precision tier
+ *  and the same RPD computed with RPD_EXACT.
+ */
+struct RPDPrecisionReport {
+  RPDPrecision precision = RPD_EXACT;
+  index_t nb_polygons_exact = 0;  // facets of the RPD mesh
+  index_t nb_polygons = 0;
+  index_t nb_adj_exact = 0;  // adjacent seed pairs
+  index_t nb_adj = 0;
+  index_t nb_adj_missing = 0;   // in exact, not in precision
+  index_t nb_adj_extra = 0;     // in precision, not in exact
+  index_t nb_seeds_differ = 0;  // different polygon count or neighbors
+  double seconds_exact = 0.;
+  double seconds = 0.;
+
+  /**
+   * \brief Tests whether the tier gave the same combinatorics as exact.
+   */
+  bool is_same() const {
+    return nb_polygons == nb_polygons_exact && nb_adj_missing == 0 &&
+           nb_adj_extra == 0 && nb_seeds_differ == 0;
+  }
+  void print() const;
+};
+
+/**
+ * \brief Computes the RPD with RPD_EXACT and with \p precision, and
+ *  compares their polygon counts (total and per seed) and seed adjacency.
+ * \details Used to check when an inexact tier is safe for a given
+ *  model and set of spheres. The precision of \p rpd is restored.
+ */
+RPDPrecisionReport validate_RPD_precision(RestrictedPowerDiagram* rpd,
+                                          RPDPrecision precision,
+                                          bool is_parallel = true);
+
 }  // namespace matfp
\ No newline at end of file
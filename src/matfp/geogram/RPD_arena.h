@@ -0,0 +1,90 @@
+#pragma once
+
+#include <geogram/basic/common.h>
+#include <geogram/mesh/index.h>
+
+#include <new>
+#include <vector>
+
+/**
+ * \file RPD_arena.h
+ * \brief Bump allocator of intersection points, one per RPD part (and per
+ *  ConvexCellCGAL). Replaces GEOGen::PointAllocator, whose clear() frees
+ *  all its chunks: clearing the arena at each facet only rewinds it, so
+ *  steady-state traversal does not touch the heap.
+ */
+
+namespace matfp {
+
+/**
+ * \brief Allocates points of a fixed dimension in chunks that are kept
+ *  until destruction.
+ * \details Points stay at the same address until clear(), which rewinds
+ *  the arena without releasing memory.
+ */
+class RPDPointArena {
+ public:
+  /**
+   * \brief Number of points per chunk.
+   */
+  static constexpr GEO::index_t CHUNK_SIZE = 512;
+
+  /**
+   * \brief Creates an empty arena.
+   * \param[in] dim dimension of the points
+   */
+  explicit RPDPointArena(GEO::coord_index_t dim)
+      : dimension_(dim), cur_chunk_(0), nb_in_chunk_(0) {}
+
+  RPDPointArena(const RPDPointArena&) = delete;
+  RPDPointArena& operator=(const RPDPointArena&) = delete;
+
+  ~RPDPointArena() {
+    for (double* chunk : chunks_) ::operator delete(chunk);
+  }
+
+  /**
+   * \brief Allocates a new point.
+   * \return a pointer to dimension() doubles, valid until clear()
+   */
+  double* new_item() {
+    if (chunks_.empty() || nb_in_chunk_ == CHUNK_SIZE) next_chunk();
+    double* result = chunks_[cur_chunk_] + nb_in_chunk_ * dimension_;
+    ++nb_in_chunk_;
+    return result;
+  }
+
+  /**
+   * \brief Forgets all points, chunks are kept for the next ones.
+   */
+  void clear() {
+    cur_chunk_ = 0;
+    nb_in_chunk_ = 0;
+  }
+
+  /**
+   * \brief Gets the dimension of the points.
+   */
+  GEO::coord_index_t dimension() const { return dimension_; }
+
+  /**
+   * \brief Gets the number of allocated chunks, i.e. the high water mark.
+   */
+  GEO::index_t nb_chunks() const { return GEO::index_t(chunks_.size()); }
+
+ private:
+  void next_chunk() {
+    if (!chunks_.empty()) ++cur_chunk_;
+    nb_in_chunk_ = 0;
+    if (cur_chunk_ < chunks_.size()) return;
+    chunks_.push_back(static_cast<double*>(
+        ::operator new(sizeof(double) * dimension_ * CHUNK_SIZE)));
+  }
+
+  GEO::coord_index_t dimension_;
+  std::vector<double*> chunks_;
+  GEO::index_t cur_chunk_;
+  GEO::index_t nb_in_chunk_;
+};
+
+}  // namespace matfp
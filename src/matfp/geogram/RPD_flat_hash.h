@@ -0,0 +1,218 @@
+#pragma once
+
+#include <geogram/basic/common.h>
+#include <geogram/mesh/index.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/**
+ * \file RPD_flat_hash.h
+ * \brief Open-addressing hash tables: symbolic quad-indices to vertex ids
+ *  for RPDVertexMap (replaces std::map, no node allocation), and the set of
+ *  seeds visited by the RPD traversal of one facet.
+ */
+
+namespace matfp {
+
+/**
+ * \brief Hashes the 4 indices of a (signed_)quadindex.
+ */
+struct QuadIndexHash {
+  template <class QUAD>
+  std::uint64_t operator()(const QUAD& K) const {
+    std::uint64_t h = 0x9E3779B97F4A7C15ull;
+    for (GEO::index_t i = 0; i < 4; i++) {
+      h ^= std::uint64_t(std::uint32_t(K.indices[i]));
+      h *= 0xBF58476D1CE4E5B9ull;
+      h ^= h >> 31;
+    }
+    return h;
+  }
+};
+
+/**
+ * \brief Statistics of a FlatQuadIndexMap.
+ */
+struct FlatHashStats {
+  GEO::index_t size = 0;
+  GEO::index_t capacity = 0;
+  std::uint64_t nb_lookups = 0;
+  std::uint64_t nb_probes = 0;
+  GEO::index_t max_probe = 0;
+
+  void add(const FlatHashStats& rhs) {
+    size += rhs.size;
+    capacity += rhs.capacity;
+    nb_lookups += rhs.nb_lookups;
+    nb_probes += rhs.nb_probes;
+    if (rhs.max_probe > max_probe) max_probe = rhs.max_probe;
+  }
+
+  void print(const char* name) const {
+    printf("[RPDVertexMap] %s: size %u, capacity %u, load %.2f, "
+           "avg probe %.2f, max probe %u\n",
+           name, size, capacity, capacity == 0 ? 0. : double(size) / capacity,
+           nb_lookups == 0 ? 0. : double(nb_probes) / nb_lookups, max_probe);
+  }
+};
+
+/**
+ * \brief Linear probing hash map from quadindex / signed_quadindex to
+ *  GEO::index_t, keys and values stored in one flat array.
+ * \details Capacity is a power of two, grows when load exceeds 1/2.
+ *  Erase is not supported (not needed by RPDVertexMap).
+ */
+template <class QUAD>
+class FlatQuadIndexMap {
+ public:
+  static const GEO::index_t NO_VALUE = GEO::index_t(-1);
+
+  FlatQuadIndexMap() : size_(0), mask_(0) {}
+
+  /**
+   * \brief Reserves enough slots for \p n keys without rehashing.
+   */
+  void reserve(GEO::index_t n) {
+    GEO::index_t cap = 16;
+    while (cap < 2 * n) cap *= 2;
+    if (cap > slots_.size()) rehash(cap);
+  }
+
+  void clear() {
+    slots_.clear();
+    size_ = 0;
+    mask_ = 0;
+    stats_ = FlatHashStats();
+  }
+
+  GEO::index_t size() const { return size_; }
+
+  /**
+   * \brief Finds \p K, or inserts it with value \p new_value().
+   * \return the value associated with \p K
+   */
+  template <class NEW_VALUE>
+  GEO::index_t find_or_insert(const QUAD& K, NEW_VALUE new_value) {
+    if (2 * (size_ + 1) > slots_.size()) {
+      rehash(slots_.empty() ? 16 : 2 * GEO::index_t(slots_.size()));
+    }
+    GEO::index_t s = GEO::index_t(QuadIndexHash()(K)) & mask_;
+    GEO::index_t nb_probe = 1;
+    while (slots_[s].value != NO_VALUE) {
+      if (same(slots_[s].key, K)) {
+        record(nb_probe);
+        return slots_[s].value;
+      }
+      s = (s + 1) & mask_;
+      nb_probe++;
+    }
+    record(nb_probe);
+    slots_[s].key = K;
+    slots_[s].value = new_value();
+    size_++;
+    return slots_[s].value;
+  }
+
+  FlatHashStats stats() const {
+    FlatHashStats result = stats_;
+    result.size = size_;
+    result.capacity = slots_.size();
+    return result;
+  }
+
+ private:
+  struct Slot {
+    QUAD key;
+    GEO::index_t value = NO_VALUE;
+  };
+
+  static bool same(const QUAD& a, const QUAD& b) {
+    return a.indices[0] == b.indices[0] && a.indices[1] == b.indices[1] &&
+           a.indices[2] == b.indices[2] && a.indices[3] == b.indices[3];
+  }
+
+  void record(GEO::index_t nb_probe) {
+    stats_.nb_lookups++;
+    stats_.nb_probes += nb_probe;
+    if (nb_probe > stats_.max_probe) stats_.max_probe = nb_probe;
+  }
+
+  void rehash(GEO::index_t cap) {
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.resize(cap);
+    mask_ = cap - 1;
+    for (const Slot& slot : old) {
+      if (slot.value == NO_VALUE) continue;
+      GEO::index_t s = GEO::index_t(QuadIndexHash()(slot.key)) & mask_;
+      while (slots_[s].value != NO_VALUE) s = (s + 1) & mask_;
+      slots_[s] = slot;
+    }
+  }
+
+  std::vector<Slot> slots_;
+  GEO::index_t size_;
+  GEO::index_t mask_;
+  FlatHashStats stats_;
+};
+
+/**
+ * \brief Linear probing set of GEO::index_t, cleared in O(size).
+ * \details Seeds already visited for the current facet (or tet) of the
+ *  RPD traversal. Replaces a stamp array indexed by seed tag, which was
+ *  O(nb seeds) per part whatever the size of the part.
+ */
+class FlatIndexSet {
+ public:
+  static constexpr GEO::index_t NO_KEY = GEO::index_t(-1);
+
+  FlatIndexSet() : mask_(0) {}
+
+  void clear() {
+    for (GEO::index_t s : used_) slots_[s] = NO_KEY;
+    used_.clear();
+  }
+
+  GEO::index_t size() const { return GEO::index_t(used_.size()); }
+
+  /**
+   * \brief Inserts \p key.
+   * \return false if \p key was already in the set
+   */
+  bool insert(GEO::index_t key) {
+    if (2 * (used_.size() + 1) > slots_.size()) {
+      rehash(slots_.empty() ? 16 : 2 * GEO::index_t(slots_.size()));
+    }
+    GEO::index_t s = hash(key) & mask_;
+    while (slots_[s] != NO_KEY) {
+      if (slots_[s] == key) return false;
+      s = (s + 1) & mask_;
+    }
+    slots_[s] = key;
+    used_.push_back(s);
+    return true;
+  }
+
+ private:
+  static GEO::index_t hash(GEO::index_t key) {
+    return GEO::index_t((std::uint64_t(key) * 0x9E3779B97F4A7C15ull) >> 32);
+  }
+
+  void rehash(GEO::index_t cap) {
+    std::vector<GEO::index_t> keys;
+    keys.reserve(used_.size());
+    for (GEO::index_t s : used_) keys.push_back(slots_[s]);
+    slots_.assign(cap, NO_KEY);
+    mask_ = cap - 1;
+    used_.clear();
+    for (GEO::index_t key : keys) insert(key);
+  }
+
+  std::vector<GEO::index_t> slots_;
+  std::vector<GEO::index_t> used_;  // occupied slots
+  GEO::index_t mask_;
+};
+
+}  // namespace matfp
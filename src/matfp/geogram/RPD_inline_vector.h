@@ -0,0 +1,158 @@
+#pragma once
+
+#include <geogram/basic/common.h>
+#include <geogram/mesh/index.h>
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+/**
+ * \file RPD_inline_vector.h
+ * \brief Vector with inline storage for the first N elements, used by
+ *  PolygonCGAL so that clipping polygons (almost always small) never
+ *  touch the heap. Larger polygons spill over to a heap buffer that is
+ *  kept until destruction.
+ */
+
+namespace matfp {
+
+/**
+ * \brief Vector storing up to N elements inline, then on the heap.
+ * \details clear() and resize() never release memory, a buffer that
+ *  spilled over keeps its capacity. Moves and swaps hand spilled buffers
+ *  over without copying, only inline elements are moved one by one.
+ */
+template <class T, GEO::index_t N>
+class InlineVector {
+ public:
+  InlineVector() : data_(inline_data()), size_(0), capacity_(N) {}
+
+  InlineVector(const InlineVector& rhs) : InlineVector() { *this = rhs; }
+
+  InlineVector(InlineVector&& rhs) noexcept : InlineVector() { take(rhs); }
+
+  InlineVector& operator=(const InlineVector& rhs) {
+    if (this == &rhs) return *this;
+    clear();
+    reserve(rhs.size_);
+    for (GEO::index_t i = 0; i < rhs.size_; ++i) new (data_ + i) T(rhs[i]);
+    size_ = rhs.size_;
+    return *this;
+  }
+
+  InlineVector& operator=(InlineVector&& rhs) noexcept {
+    if (this == &rhs) return *this;
+    clear();
+    if (!is_inline()) {
+      ::operator delete(data_);
+      data_ = inline_data();
+      capacity_ = N;
+    }
+    take(rhs);
+    return *this;
+  }
+
+  ~InlineVector() {
+    clear();
+    if (!is_inline()) ::operator delete(data_);
+  }
+
+  GEO::index_t size() const { return size_; }
+  GEO::index_t capacity() const { return capacity_; }
+  bool empty() const { return size_ == 0; }
+  bool is_inline() const { return data_ == inline_data(); }
+
+  T& operator[](GEO::index_t i) {
+    geo_debug_assert(i < size_);
+    return data_[i];
+  }
+  const T& operator[](GEO::index_t i) const {
+    geo_debug_assert(i < size_);
+    return data_[i];
+  }
+  T& back() { return (*this)[size_ - 1]; }
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+
+  void push_back(const T& x) {
+    if (size_ == capacity_) {
+      // x may live in this vector
+      T copy(x);
+      reserve(2 * capacity_);
+      new (data_ + size_) T(std::move(copy));
+    } else {
+      new (data_ + size_) T(x);
+    }
+    ++size_;
+  }
+
+  void resize(GEO::index_t sz) {
+    reserve(sz);
+    for (GEO::index_t i = sz; i < size_; ++i) data_[i].~T();
+    for (GEO::index_t i = size_; i < sz; ++i) new (data_ + i) T();
+    size_ = sz;
+  }
+
+  void clear() { resize(0); }
+
+  void reserve(GEO::index_t cap) {
+    if (cap <= capacity_) return;
+    T* data = static_cast<T*>(::operator new(sizeof(T) * cap));
+    for (GEO::index_t i = 0; i < size_; ++i) {
+      new (data + i) T(std::move(data_[i]));
+      data_[i].~T();
+    }
+    if (!is_inline()) ::operator delete(data_);
+    data_ = data;
+    capacity_ = cap;
+  }
+
+  /**
+   * \brief Swaps contents, spilled buffers are exchanged and inline
+   *  elements moved (at most N of them).
+   */
+  void swap(InlineVector& rhs) {
+    if (this == &rhs) return;
+    if (!is_inline() && !rhs.is_inline()) {
+      std::swap(data_, rhs.data_);
+      std::swap(size_, rhs.size_);
+      std::swap(capacity_, rhs.capacity_);
+      return;
+    }
+    InlineVector tmp(std::move(rhs));
+    rhs = std::move(*this);
+    *this = std::move(tmp);
+  }
+
+ private:
+  // takes the contents of rhs, which is left empty and inline,
+  // this must be empty and inline
+  void take(InlineVector& rhs) {
+    if (rhs.is_inline()) {
+      for (GEO::index_t i = 0; i < rhs.size_; ++i)
+        new (data_ + i) T(std::move(rhs.data_[i]));
+      size_ = rhs.size_;
+      rhs.clear();
+      return;
+    }
+    data_ = rhs.data_;
+    size_ = rhs.size_;
+    capacity_ = rhs.capacity_;
+    rhs.data_ = rhs.inline_data();
+    rhs.size_ = 0;
+    rhs.capacity_ = N;
+  }
+
+  T* inline_data() { return reinterpret_cast<T*>(inline_); }
+  const T* inline_data() const {
+    return reinterpret_cast<const T*>(inline_);
+  }
+
+  alignas(T) unsigned char inline_[N * sizeof(T)];
+  T* data_;
+  GEO::index_t size_;
+  GEO::index_t capacity_;
+};
+
+}  // namespace matfp
@@ -45,9 +45,36 @@
 
 #include "RPD_mesh_builder.h"
 
+#include <geogram/basic/algorithm.h>
+#include <geogram/basic/process.h>
+
+#include "profiler.h"
+
 namespace matfp {
 
-RPDVertexMap::RPDVertexMap() : nb_vertices_(0) {}
+RPDVertexMap::RPDVertexMap() : nb_vertices_(0), record_keys_(false) {}
+
+void RPDVertexMap::reserve(GEO::index_t nb_facets) {
+  // surfacic RPD: ++- vertices (power edge x facet) and +-- vertices
+  // (bisector x mesh edge) both scale with the number of facets,
+  // +++ vertices only appear in volumetric mode
+  ppm_to_id_.reserve(nb_facets);
+  pmm_to_id_.reserve(nb_facets);
+  ppp_to_id_.reserve(64);
+}
+
+FlatHashStats RPDVertexMap::stats() const {
+  FlatHashStats result = ppp_to_id_.stats();
+  result.add(ppm_to_id_.stats());
+  result.add(pmm_to_id_.stats());
+  return result;
+}
+
+void RPDVertexMap::print_stats() const {
+  ppp_to_id_.stats().print("+++");
+  ppm_to_id_.stats().print("++-");
+  pmm_to_id_.stats().print("+--");
+}
 
 GEO::index_t RPDVertexMap::find_or_create_vertex(
     GEO::index_t center_vertex_id, const matfp::SymbolicVertex& sym) {
@@ -63,21 +90,13 @@ GEO::index_t RPDVertexMap::find_or_create_vertex(
       GEO::index_t ib2 = sym.bisector(1);
       GEO::index_t ib3 = sym.bisector(2);
       quadindex K(center_vertex_id + 1, ib1 + 1, ib2 + 1, ib3 + 1);
-      auto it = ppp_to_id_.find(K);
-      if (it != ppp_to_id_.end()) {
-        return it->second;
-      } else {
-        GEO::index_t result = new_vertex();
-
-        // if (result == 15477 || result == 15555) {
-        //   logger().debug(
-        //       "vertex with id {}: sym.nb_bisectors {}, ib1 {}, ib2 {}, ib3
-        //       {}", result, sym.nb_bisectors(), ib1, ib2, ib3);
-        // }
-
-        ppp_to_id_[K] = result;
-        return result;
-      }
+      return ppp_to_id_.find_or_insert(K, [&]() {
+        const GEO::signed_index_t sK[4] = {GEO::signed_index_t(K.indices[0]),
+                                           GEO::signed_index_t(K.indices[1]),
+                                           GEO::signed_index_t(K.indices[2]),
+                                           GEO::signed_index_t(K.indices[3])};
+        return new_vertex(3, sK);
+      });
     }
     case 2: {
       GEO::index_t f = sym.boundary_facet(0);
@@ -102,21 +121,8 @@ GEO::index_t RPDVertexMap::find_or_create_vertex(
       //     );
       // }
 
-      auto it = ppm_to_id_.find(K);
-      if (it != ppm_to_id_.end()) {
-        return it->second;
-      } else {
-        GEO::index_t result = new_vertex();
-
-        // if (result == 15477 || result == 15555) {
-        //   logger().debug(
-        //       "vertex with id {}: sym.nb_bisectors {}, ib1 {}, ib2 {}",
-        //       result, sym.nb_bisectors(), ib1, ib2);
-        // }
-
-        ppm_to_id_[K] = result;
-        return result;
-      }
+      return ppm_to_id_.find_or_insert(
+          K, [&]() { return new_vertex(2, K.indices); });
     }
     case 1: {
       GEO::index_t bv1, bv2;
@@ -126,20 +132,8 @@ GEO::index_t RPDVertexMap::find_or_create_vertex(
                          -GEO::signed_index_t(bv1) - 1,
                          -GEO::signed_index_t(bv2) - 1,
                          GEO::signed_index_t(ib) + 1);
-      auto it = pmm_to_id_.find(K);
-      if (it != pmm_to_id_.end()) {
-        return it->second;
-      } else {
-        GEO::index_t result = new_vertex();
-
-        // if (result == 15477 || result == 15555) {
-        //   logger().debug("vertex with id {}: sym.nb_bisectors {}, ib1 {}",
-        //                  result, sym.nb_bisectors(), ib);
-        // }
-
-        pmm_to_id_[K] = result;
-        return result;
-      }
+      return pmm_to_id_.find_or_insert(
+          K, [&]() { return new_vertex(1, K.indices); });
     }
     case 0: {
       GEO::index_t bv = sym.get_boundary_vertex();
@@ -147,7 +141,8 @@ GEO::index_t RPDVertexMap::find_or_create_vertex(
         bv_to_id_.resize(bv + 1, -1);
       }
       if (bv_to_id_[bv] == -1) {
-        bv_to_id_[bv] = GEO::signed_index_t(new_vertex());
+        const GEO::signed_index_t sK[4] = {GEO::signed_index_t(bv), 0, 0, 0};
+        bv_to_id_[bv] = GEO::signed_index_t(new_vertex(0, sK));
       }
 
       // if (bv_to_id_[bv] == 15477 || bv_to_id_[bv] == 15555) {
@@ -177,14 +172,13 @@ GEO::index_t RPDVertexMap::find_or_create_vertex(
       v_adj.insert(ib3);
 
       quadindex K(center_vertex_id + 1, ib1 + 1, ib2 + 1, ib3 + 1);
-      auto it = ppp_to_id_.find(K);
-      if (it != ppp_to_id_.end()) {
-        return it->second;
-      } else {
-        GEO::index_t result = new_vertex();
-        ppp_to_id_[K] = result;
-        return result;
-      }
+      return ppp_to_id_.find_or_insert(K, [&]() {
+        const GEO::signed_index_t sK[4] = {GEO::signed_index_t(K.indices[0]),
+                                           GEO::signed_index_t(K.indices[1]),
+                                           GEO::signed_index_t(K.indices[2]),
+                                           GEO::signed_index_t(K.indices[3])};
+        return new_vertex(3, sK);
+      });
     }
     case 2: {
       GEO::index_t f = sym.boundary_facet(0);
@@ -197,14 +191,8 @@ GEO::index_t RPDVertexMap::find_or_create_vertex(
                          GEO::signed_index_t(ib1) + 1,
                          GEO::signed_index_t(ib2) + 1);
 
-      auto it = ppm_to_id_.find(K);
-      if (it != ppm_to_id_.end()) {
-        return it->second;
-      } else {
-        GEO::index_t result = new_vertex();
-        ppm_to_id_[K] = result;
-        return result;
-      }
+      return ppm_to_id_.find_or_insert(
+          K, [&]() { return new_vertex(2, K.indices); });
     }
     case 1: {
       GEO::index_t bv1, bv2;
@@ -216,14 +204,8 @@ GEO::index_t RPDVertexMap::find_or_create_vertex(
                          -GEO::signed_index_t(bv1) - 1,
                          -GEO::signed_index_t(bv2) - 1,
                          GEO::signed_index_t(ib) + 1);
-      auto it = pmm_to_id_.find(K);
-      if (it != pmm_to_id_.end()) {
-        return it->second;
-      } else {
-        GEO::index_t result = new_vertex();
-        pmm_to_id_[K] = result;
-        return result;
-      }
+      return pmm_to_id_.find_or_insert(
+          K, [&]() { return new_vertex(1, K.indices); });
     }
     case 0: {
       GEO::index_t bv = sym.get_boundary_vertex();
@@ -231,7 +213,8 @@ GEO::index_t RPDVertexMap::find_or_create_vertex(
         bv_to_id_.resize(bv + 1, -1);
       }
       if (bv_to_id_[bv] == -1) {
-        bv_to_id_[bv] = GEO::signed_index_t(new_vertex());
+        const GEO::signed_index_t sK[4] = {GEO::signed_index_t(bv), 0, 0, 0};
+        bv_to_id_[bv] = GEO::signed_index_t(new_vertex(0, sK));
       }
       return GEO::index_t(bv_to_id_[bv]);
     }
@@ -239,4 +222,258 @@ GEO::index_t RPDVertexMap::find_or_create_vertex(
       geo_assert_not_reached;
   }
 }
+
+/************************************************************************/
+
+namespace {
+// one vertex of one part, sorted by key to find duplicates
+struct PartVertexRecord {
+  RPDVertexKey key;
+  GEO::index_t part;
+  GEO::index_t local;
+
+  bool operator<(const PartVertexRecord& rhs) const {
+    if (!(key == rhs.key)) return key < rhs.key;
+    if (part != rhs.part) return part < rhs.part;
+    return local < rhs.local;
+  }
+};
+}  // namespace
+
+RPDVertexKey get_vertex_key(GEO::index_t seed, const SymbolicVertex& sym) {
+  RPDVertexKey key;
+  key.type = GEO::signed_index_t(sym.nb_bisectors());
+  switch (sym.nb_bisectors()) {
+    case 3: {
+      quadindex K(seed + 1, sym.bisector(0) + 1, sym.bisector(1) + 1,
+                  sym.bisector(2) + 1);
+      for (GEO::index_t i = 0; i < 4; i++)
+        key.indices[i] = GEO::signed_index_t(K.indices[i]);
+    } break;
+    case 2: {
+      signed_quadindex K(GEO::signed_index_t(seed) + 1,
+                         -GEO::signed_index_t(sym.boundary_facet(0)) - 1,
+                         GEO::signed_index_t(sym.bisector(0)) + 1,
+                         GEO::signed_index_t(sym.bisector(1)) + 1);
+      for (GEO::index_t i = 0; i < 4; i++) key.indices[i] = K.indices[i];
+    } break;
+    case 1: {
+      GEO::index_t bv1, bv2;
+      sym.get_boundary_edge(bv1, bv2);
+      signed_quadindex K(GEO::signed_index_t(seed) + 1,
+                         -GEO::signed_index_t(bv1) - 1,
+                         -GEO::signed_index_t(bv2) - 1,
+                         GEO::signed_index_t(sym.bisector(0)) + 1);
+      for (GEO::index_t i = 0; i < 4; i++) key.indices[i] = K.indices[i];
+    } break;
+    case 0: {
+      key.indices[0] = GEO::signed_index_t(sym.get_boundary_vertex());
+      key.indices[1] = key.indices[2] = key.indices[3] = 0;
+    } break;
+    default:
+      geo_assert_not_reached;
+  }
+  return key;
+}
+
+void get_key_bisectors(const RPDVertexKey& key, GEO::index_t seed,
+                       std::vector<GEO::index_t>& bisectors) {
+  bisectors.clear();
+  if (key.type == 0) return;  // boundary vertex, no bisector
+  for (GEO::index_t i = 0; i < 4; i++) {
+    if (key.indices[i] <= 0) continue;  // boundary facet or vertex
+    GEO::index_t b = GEO::index_t(key.indices[i] - 1);
+    if (b != seed) bisectors.push_back(b);
+  }
+}
+
+void RPDPartMeshBuilder::load_from_mesh(
+    GEO::Mesh& M, const std::vector<RPDVertexKey>& keys,
+    const std::vector<char>& skip_ref_facet) {
+  const GEO::index_t NO_VERTEX = GEO::index_t(-1);
+  geo_assert(keys.size() == M.vertices.nb());
+  Attribute<GEO::index_t> region(M.facets.attributes(), "region");
+  Attribute<GEO::index_t> ref_facet(M.facets.attributes(), "ref_facet");
+  std::vector<GEO::index_t> old_to_local(M.vertices.nb(), NO_VERTEX);
+  std::vector<GEO::index_t> bisectors;
+  begin_surface();
+  for (GEO::index_t f = 0; f < M.facets.nb(); f++) {
+    if (skip_ref_facet[ref_facet[f]]) continue;
+    begin_reference_facet(ref_facet[f]);
+    begin_facet(region[f]);
+    for (GEO::index_t lv = 0; lv < M.facets.nb_vertices(f); lv++) {
+      const GEO::index_t v = M.facets.vertex(f, lv);
+      if (old_to_local[v] == NO_VERTEX) {
+        old_to_local[v] = vertex_map_.add_vertex_with_key(keys[v]);
+        const double* p = M.vertices.point_ptr(v);
+        for (GEO::index_t c = 0; c < 3; ++c) points_.push_back(p[c]);
+        vs_bisectors_.emplace_back();
+      }
+      const GEO::index_t id = old_to_local[v];
+      get_key_bisectors(keys[v], current_seed_, bisectors);
+      add_seed_adj(bisectors.begin(), bisectors.end());
+      vs_bisectors_[id].insert(vs_bisectors_[id].end(), bisectors.begin(),
+                               bisectors.end());
+      facet_corners_.push_back(id);
+    }
+    end_facet();
+  }
+  region.unbind();
+  ref_facet.unbind();
+  end_surface();
+}
+
+void merge_RPD_part_meshes(
+    std::vector<RPDPartMeshBuilder>& parts, GEO::Mesh& target,
+    std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_seed_adj,
+    std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_vs_bisectors,
+    std::vector<RPDVertexKey>* merged_keys) {
+  PROFILE_ZONE("RPD merge parts");
+  const GEO::index_t nb_parts = parts.size();
+  std::vector<GEO::index_t> v_offset(nb_parts + 1, 0);
+  std::vector<GEO::index_t> f_offset(nb_parts + 1, 0);
+  for (GEO::index_t p = 0; p < nb_parts; p++) {
+    v_offset[p + 1] = v_offset[p] + parts[p].nb_vertices();
+    f_offset[p + 1] = f_offset[p] + parts[p].nb_facets();
+  }
+
+  // 1. sort all part vertices by symbolic key
+  std::vector<PartVertexRecord> records(v_offset[nb_parts]);
+  GEO::parallel_for(0, nb_parts, [&](GEO::index_t p) {
+    const std::vector<RPDVertexKey>& keys = parts[p].vertex_map_.keys();
+    geo_assert(keys.size() == parts[p].nb_vertices());
+    for (GEO::index_t lv = 0; lv < keys.size(); lv++) {
+      PartVertexRecord& r = records[v_offset[p] + lv];
+      r.key = keys[lv];
+      r.part = p;
+      r.local = lv;
+    }
+  });
+  GEO::sort(records.begin(), records.end());
+  FlatHashStats hash_stats;
+  for (const RPDPartMeshBuilder& P : parts)
+    hash_stats.add(P.vertex_map_.stats());
+  hash_stats.print("all parts");
+
+  // 2. first record of each group is the representative,
+  //    global ids follow representatives in (part, local) order
+  std::vector<GEO::index_t> group_begin;
+  std::vector<GEO::index_t> rep_of(records.size());  // flat (part, local)
+  for (GEO::index_t r = 0; r < records.size(); r++) {
+    if (r == 0 || !(records[r].key == records[r - 1].key))
+      group_begin.push_back(r);
+    const PartVertexRecord& rep = records[group_begin.back()];
+    rep_of[v_offset[records[r].part] + records[r].local] =
+        v_offset[rep.part] + rep.local;
+  }
+  group_begin.push_back(records.size());
+
+  const GEO::index_t nb_global = group_begin.size() - 1;
+  std::vector<GEO::index_t> global_id(records.size());
+  GEO::index_t nb_created = 0;
+  for (GEO::index_t flat = 0; flat < records.size(); flat++) {
+    if (rep_of[flat] == flat)
+      global_id[flat] = nb_created++;
+    else
+      global_id[flat] = global_id[rep_of[flat]];
+  }
+  geo_assert(nb_created == nb_global);
+  if (merged_keys != nullptr) {
+    merged_keys->resize(nb_global);
+    for (GEO::index_t g = 0; g < nb_global; g++) {
+      const PartVertexRecord& rep = records[group_begin[g]];
+      (*merged_keys)[global_id[v_offset[rep.part] + rep.local]] = rep.key;
+    }
+  }
+
+  // 3. vertices, written by representatives only
+  target.clear();
+  target.vertices.set_dimension(3);
+  target.vertices.create_vertices(nb_global);
+  GEO::parallel_for(0, nb_parts, [&](GEO::index_t p) {
+    const RPDPartMeshBuilder& P = parts[p];
+    for (GEO::index_t lv = 0; lv < P.nb_vertices(); lv++) {
+      const GEO::index_t flat = v_offset[p] + lv;
+      if (rep_of[flat] != flat) continue;
+      double* q = target.vertices.point_ptr(global_id[flat]);
+      for (GEO::index_t c = 0; c < 3; c++) q[c] = P.points_[3 * lv + c];
+    }
+  });
+
+  // 4. facets, created in part order then filled in parallel
+  for (GEO::index_t p = 0; p < nb_parts; p++) {
+    const RPDPartMeshBuilder& P = parts[p];
+    for (GEO::index_t f = 0; f < P.nb_facets(); f++) {
+      target.facets.create_polygon(P.facet_ptr_[f + 1] - P.facet_ptr_[f]);
+    }
+  }
+  Attribute<GEO::index_t> facet_region(target.facets.attributes(), "region");
+  Attribute<GEO::index_t> facet_ref_facet(target.facets.attributes(),
+                                          "ref_facet");
+  GEO::parallel_for(0, nb_parts, [&](GEO::index_t p) {
+    const RPDPartMeshBuilder& P = parts[p];
+    for (GEO::index_t f = 0; f < P.nb_facets(); f++) {
+      const GEO::index_t gf = f_offset[p] + f;
+      for (GEO::index_t c = P.facet_ptr_[f]; c < P.facet_ptr_[f + 1]; c++) {
+        target.facets.set_vertex(
+            gf, c - P.facet_ptr_[f],
+            global_id[v_offset[p] + P.facet_corners_[c]]);
+      }
+      facet_region[gf] = P.facet_region_[f];
+      facet_ref_facet[gf] = P.facet_ref_facet_[f];
+    }
+  });
+  facet_region.unbind();
+  facet_ref_facet.unbind();
+  target.facets.connect();
+
+  // 5. adjacencies, union of all parts, one group / seed per task
+  if (rpd_vs_bisectors != nullptr) {
+    std::vector<std::set<GEO::index_t>> vs_bisectors(nb_global);
+    GEO::parallel_for(0, nb_global, [&](GEO::index_t g) {
+      for (GEO::index_t r = group_begin[g]; r < group_begin[g + 1]; r++) {
+        const std::vector<GEO::index_t>& b =
+            parts[records[r].part].vs_bisectors_[records[r].local];
+        vs_bisectors[global_id[v_offset[records[r].part] + records[r].local]]
+            .insert(b.begin(), b.end());
+      }
+    });
+    rpd_vs_bisectors->clear();
+    for (GEO::index_t v = 0; v < nb_global; v++) {
+      rpd_vs_bisectors->emplace_hint(rpd_vs_bisectors->end(), v,
+                                     std::move(vs_bisectors[v]));
+    }
+  }
+
+  if (rpd_seed_adj != nullptr) {
+    // sparse pairs of all parts, cost is linear in the output, not in
+    // the number of seeds times the number of parts
+    std::size_t nb_pairs = 0;
+    for (const RPDPartMeshBuilder& P : parts) nb_pairs += P.seed_adj_.size();
+    std::vector<std::pair<GEO::index_t, GEO::index_t>> pairs;
+    pairs.reserve(nb_pairs);
+    for (const RPDPartMeshBuilder& P : parts)
+      pairs.insert(pairs.end(), P.seed_adj_.begin(), P.seed_adj_.end());
+    GEO::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    // seeds with at least one facet have an entry, even if empty
+    std::vector<GEO::index_t> seeds;
+    for (const RPDPartMeshBuilder& P : parts)
+      seeds.insert(seeds.end(), P.facet_region_.begin(),
+                   P.facet_region_.end());
+    std::sort(seeds.begin(), seeds.end());
+    seeds.erase(std::unique(seeds.begin(), seeds.end()), seeds.end());
+    rpd_seed_adj->clear();
+    std::size_t p = 0;
+    for (GEO::index_t s : seeds) {
+      while (p < pairs.size() && pairs[p].first < s) p++;
+      std::set<GEO::index_t>& adj =
+          rpd_seed_adj->emplace_hint(rpd_seed_adj->end(), s,
+                                     std::set<GEO::index_t>())
+              ->second;
+      for (; p < pairs.size() && pairs[p].first == s; p++)
+        adj.emplace_hint(adj.end(), pairs[p].second);
+    }
+  }
+}
 }  // namespace matfp
@@ -52,9 +52,13 @@
 #include <geogram/mesh/mesh.h>
 #include <geogram/voronoi/generic_RVD.h>
 
+#include <algorithm>
 #include <map>
+#include <set>
+#include <utility>
 #include <vector>
 
+#include "RPD_flat_hash.h"
 #include "generic_RPD_vertex.h"
 
 /**
@@ -70,6 +74,46 @@ using namespace GEO;
 
 class SymbolicVertex;
 
+/**
+ * \brief Global symbolic key of a RPD vertex.
+ * \details Same key as used by RPDVertexMap, flattened to one type so that
+ *  vertices found by different threads can be sorted and merged.
+ *  type is the number of bisectors (3: +++, 2: ++-, 1: +--, 0: boundary
+ *  vertex stored in indices[0]).
+ */
+struct RPDVertexKey {
+  GEO::signed_index_t type;
+  GEO::signed_index_t indices[4];
+
+  bool operator<(const RPDVertexKey& rhs) const {
+    if (type != rhs.type) return type < rhs.type;
+    for (GEO::index_t i = 0; i < 4; i++) {
+      if (indices[i] != rhs.indices[i]) return indices[i] < rhs.indices[i];
+    }
+    return false;
+  }
+
+  bool operator==(const RPDVertexKey& rhs) const {
+    return type == rhs.type && indices[0] == rhs.indices[0] &&
+           indices[1] == rhs.indices[1] && indices[2] == rhs.indices[2] &&
+           indices[3] == rhs.indices[3];
+  }
+};
+
+/**
+ * \brief Gets the bisectors of a vertex seen from \p seed, i.e. the
+ *  seeds in \p key except \p seed (same as v_adj in
+ *  RPDVertexMap::find_or_create_vertex()).
+ */
+void get_key_bisectors(const RPDVertexKey& key, GEO::index_t seed,
+                       std::vector<GEO::index_t>& bisectors);
+
+/**
+ * \brief Gets the global symbolic key of a vertex seen from \p seed,
+ *  without any lookup (same key as RPDVertexMap::keys()).
+ */
+RPDVertexKey get_vertex_key(GEO::index_t seed, const SymbolicVertex& sym);
+
 /**
  * \brief RPDVertexMap maps symbolic vertices to unique ids.
  * \details Symbolic vertices are manipulated by
@@ -110,6 +154,42 @@ class GEOGRAM_API RPDVertexMap {
    */
   void set_first_vertex_index(GEO::index_t i) { nb_vertices_ = i; }
 
+  /**
+   * \brief Pre-sizes the hash tables for a reference mesh with
+   *  \p nb_facets facets, to avoid rehashing while building.
+   */
+  void reserve(GEO::index_t nb_facets);
+
+  /**
+   * \brief Gets the load and probe statistics of all hash tables.
+   */
+  FlatHashStats stats() const;
+
+  /**
+   * \brief Prints the load and probe statistics of each hash table.
+   */
+  void print_stats() const;
+
+  /**
+   * \brief If set, the symbolic key of each created vertex is kept
+   *  (see keys()), used to merge vertex maps of different threads.
+   */
+  void set_record_keys(bool x) { record_keys_ = x; }
+
+  /**
+   * \brief Gets the symbolic keys of created vertices, indexed by
+   *  vertex id - first vertex index.
+   */
+  const std::vector<RPDVertexKey>& keys() const { return keys_; }
+
+  /**
+   * \brief Creates a vertex with a known key, without any lookup.
+   * \details Used to reload a previously computed RPD mesh.
+   */
+  GEO::index_t add_vertex_with_key(const RPDVertexKey& key) {
+    return new_vertex(key.type, key.indices);
+  }
+
  protected:
   /**
    * \brief Allocates a new vertex.
@@ -120,6 +200,20 @@ class GEOGRAM_API RPDVertexMap {
     return result;
   }
 
+  /**
+   * \brief Allocates a new vertex and records its key if needed.
+   */
+  GEO::index_t new_vertex(GEO::signed_index_t type,
+                          const GEO::signed_index_t* indices) {
+    if (record_keys_) {
+      RPDVertexKey key;
+      key.type = type;
+      for (GEO::index_t i = 0; i < 4; i++) key.indices[i] = indices[i];
+      keys_.push_back(key);
+    }
+    return new_vertex();
+  }
+
   /**
    * \brief Gets the number of bisectors represented
    *   in a symbolic vertex.
@@ -137,21 +231,24 @@ class GEOGRAM_API RPDVertexMap {
  private:
   // Maps (+++)-center vertex id quadruples to unique vertex id
   // +++ encodes a Voronoi vertex
-  std::map<quadindex, GEO::index_t> ppp_to_id_;
+  FlatQuadIndexMap<quadindex> ppp_to_id_;
 
   // Maps (++-)-center vertex id quadruples to unique vertex id
   // ++- encodes the intersection between a Voronoi edge (++) and
   //    a facet of the boundary (-).
-  std::map<signed_quadindex, GEO::index_t> ppm_to_id_;
+  FlatQuadIndexMap<signed_quadindex> ppm_to_id_;
 
   // Maps (+--)-center vertex id quadruples to unique vertex id
   // +-- encodes the intersection between a Voronoi facet (+) and
   //    an edge of the boundary (--).
-  std::map<signed_quadindex, GEO::index_t> pmm_to_id_;
+  FlatQuadIndexMap<signed_quadindex> pmm_to_id_;
 
   // Maps boundary vertex index to unique vertex id.
   GEO::vector<GEO::signed_index_t> bv_to_id_;
   GEO::index_t nb_vertices_;
+
+  bool record_keys_;
+  std::vector<RPDVertexKey> keys_;
 };
 
 /************************************************************************/
@@ -187,6 +284,21 @@ class RPDMeshBuilder {
     // std::cout << "RPDMeshBuilder current_seed_ : " << (int) current_seed_ <<
     // std::endl;
     current_ref_facet_ = max_index_t();
+    vertex_map_.reserve(reference->facets.nb());
+  }
+
+  /**
+   * \brief If set, the symbolic key of each vertex is kept (off by
+   *  default), see RestrictedPowerDiagram::compute_RPD_incremental().
+   */
+  void set_record_keys(bool x) { vertex_map_.set_record_keys(x); }
+
+  /**
+   * \brief Gets the symbolic key of each vertex of the target mesh,
+   *  empty unless set_record_keys(true) was called.
+   */
+  const std::vector<RPDVertexKey>& vertex_keys() const {
+    return vertex_map_.keys();
   }
 
   /**
@@ -295,6 +407,7 @@ class RPDMeshBuilder {
     target_->facets.connect();
     facet_region_.unbind();
     facet_ref_facet_.unbind();
+    vertex_map_.print_stats();
     // std::cout << "finish end_surface" << std::endl;
   }
 
@@ -324,5 +437,137 @@ class RPDMeshBuilder {
       rpd_vs_bisectors_;  // mesh vs to its all bisectors
 };
 
+/************************************************************************/
+
+/**
+ * \brief Thread-local RPD mesh builder.
+ * \details Same interface as RPDMeshBuilder (so it can be used with
+ *  BuildRPD), but stores polygons, vertices and adjacencies in plain
+ *  arrays with local vertex ids. No lock is needed, one instance is used
+ *  per thread, all parts are then merged by merge_RPD_part_meshes().
+ */
+class RPDPartMeshBuilder {
+ public:
+  RPDPartMeshBuilder()
+      : current_seed_(max_index_t()),
+        current_ref_facet_(max_index_t()) {
+    vertex_map_.set_record_keys(true);
+  }
+
+  /**
+   * \brief Pre-sizes vertex map and facet arrays for \p nb_facets
+   *  reference facets.
+   */
+  void reserve(GEO::index_t nb_facets) {
+    vertex_map_.reserve(nb_facets);
+    facet_region_.reserve(nb_facets);
+    facet_ref_facet_.reserve(nb_facets);
+    facet_ptr_.reserve(nb_facets + 1);
+  }
+
+  void begin_surface() { facet_ptr_.assign(1, 0); }
+
+  void begin_reference_facet(GEO::index_t ref_facet) {
+    current_ref_facet_ = ref_facet;
+  }
+
+  void begin_facet(GEO::index_t seed) { current_seed_ = seed; }
+
+  void add_vertex_to_facet(const double* point,
+                           const matfp::SymbolicVertex& sym) {
+    GEO::index_t id =
+        vertex_map_.find_or_create_vertex(current_seed_, sym, v_adj_);
+    if (id == vs_bisectors_.size()) {
+      for (GEO::index_t c = 0; c < 3; ++c) points_.push_back(point[c]);
+      vs_bisectors_.emplace_back();
+    }
+    add_seed_adj(v_adj_.begin(), v_adj_.end());
+    vs_bisectors_[id].insert(vs_bisectors_[id].end(), v_adj_.begin(),
+                             v_adj_.end());
+    facet_corners_.push_back(id);
+  }
+
+  void end_facet() {
+    facet_ptr_.push_back(facet_corners_.size());
+    facet_region_.push_back(current_seed_);
+    facet_ref_facet_.push_back(current_ref_facet_);
+  }
+
+  void end_reference_facet() {}
+
+  /**
+   * \brief Terminates the current surface.
+   * \details Removes duplicated bisectors of each vertex, and
+   *  duplicated (seed, adjacent seed) pairs.
+   */
+  void end_surface() {
+    for (std::vector<GEO::index_t>& b : vs_bisectors_) {
+      std::sort(b.begin(), b.end());
+      b.erase(std::unique(b.begin(), b.end()), b.end());
+    }
+    std::sort(seed_adj_.begin(), seed_adj_.end());
+    seed_adj_.erase(std::unique(seed_adj_.begin(), seed_adj_.end()),
+                    seed_adj_.end());
+  }
+
+  void set_dimension(GEO::coord_index_t x) { geo_argused(x); }
+
+  /**
+   * \brief Loads the facets of a previous RPD mesh, skipping the ones
+   *  whose reference facet is flagged in \p skip_ref_facet.
+   * \param[in] M previous RPD mesh with "region" and "ref_facet"
+   *  facet attributes
+   * \param[in] keys symbolic key of each vertex of \p M
+   */
+  void load_from_mesh(GEO::Mesh& M, const std::vector<RPDVertexKey>& keys,
+                      const std::vector<char>& skip_ref_facet);
+
+  GEO::index_t nb_vertices() const { return vs_bisectors_.size(); }
+  GEO::index_t nb_facets() const { return facet_region_.size(); }
+
+ private:
+  friend void merge_RPD_part_meshes(
+      std::vector<RPDPartMeshBuilder>& parts, GEO::Mesh& target,
+      std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_seed_adj,
+      std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_vs_bisectors,
+      std::vector<RPDVertexKey>* merged_keys);
+
+  template <class IT>
+  void add_seed_adj(IT begin, IT end) {
+    for (IT it = begin; it != end; ++it)
+      seed_adj_.emplace_back(current_seed_, *it);
+  }
+
+  RPDVertexMap vertex_map_;
+  GEO::index_t current_seed_;
+  GEO::index_t current_ref_facet_;
+  std::set<GEO::index_t> v_adj_;
+
+  std::vector<double> points_;  // 3 * nb_vertices()
+  std::vector<std::vector<GEO::index_t>> vs_bisectors_;
+  // (seed, adjacent seed), sparse: a part only sees a few seeds
+  std::vector<std::pair<GEO::index_t, GEO::index_t>> seed_adj_;
+  std::vector<GEO::index_t> facet_ptr_;
+  std::vector<GEO::index_t> facet_corners_;  // local vertex ids
+  std::vector<GEO::index_t> facet_region_;
+  std::vector<GEO::index_t> facet_ref_facet_;
+};
+
+/**
+ * \brief Merges thread-local RPD meshes into \p target.
+ * \details Vertices with the same symbolic key are merged, the first
+ *  occurrence (in part order) gives the vertex position and the global
+ *  numbering. Facets are renumbered part after part. Facet attributes
+ *  "region" and "ref_facet" are set as in RPDMeshBuilder, and the
+ *  adjacency maps are filled with the union of all parts.
+ * \param[out] merged_keys if not null, symbolic key of each vertex
+ *  of \p target
+ */
+void merge_RPD_part_meshes(
+    std::vector<RPDPartMeshBuilder>& parts, GEO::Mesh& target,
+    std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_seed_adj,
+    std::map<GEO::index_t, std::set<GEO::index_t>>* rpd_vs_bisectors,
+    std::vector<RPDVertexKey>* merged_keys = nullptr);
+
 /************************************************************************/
 }  // namespace matfp
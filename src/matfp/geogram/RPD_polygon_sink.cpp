@@ -0,0 +1,146 @@
+#include "RPD_polygon_sink.h"
+
+#include <cstring>
+
+#include "profiler.h"
+
+namespace matfp {
+
+namespace {
+
+template <class T>
+bool write_array(FILE* f, const T* data, std::size_t nb) {
+  return nb == 0 || fwrite(data, sizeof(T), nb, f) == nb;
+}
+
+template <class T>
+bool read_array(FILE* f, T* data, std::size_t nb) {
+  return nb == 0 || fread(data, sizeof(T), nb, f) == nb;
+}
+
+}  // namespace
+
+/************************************************************************/
+
+RPDBinaryFileSink::RPDBinaryFileSink(const std::string& path)
+    : path_(path), file_(nullptr), ok_(false) {
+  std::memset(&header_, 0, sizeof(header_));
+}
+
+RPDBinaryFileSink::~RPDBinaryFileSink() { close(); }
+
+void RPDBinaryFileSink::close() {
+  if (file_ != nullptr) fclose(file_);
+  file_ = nullptr;
+}
+
+void RPDBinaryFileSink::begin() {
+  close();
+  std::memset(&header_, 0, sizeof(header_));
+  std::memcpy(header_.magic, RPD_POLYGON_FILE_MAGIC, 8);
+  header_.version = RPD_POLYGON_FILE_VERSION;
+  header_.header_size = sizeof(RPDPolygonFileHeader);
+  file_ = fopen(path_.c_str(), "wb");
+  if (file_ == nullptr) {
+    printf("[RPDStream] cannot open %s\n", path_.c_str());
+    ok_ = false;
+    return;
+  }
+  // totals are rewritten by end()
+  ok_ = write_array(file_, &header_, 1);
+}
+
+void RPDBinaryFileSink::consume(const RPDPolygonBatch& batch) {
+  if (!ok_) return;
+  PROFILE_ZONE("io RPD stream block");
+  RPDPolygonBlockHeader block;
+  block.nb_polygons = batch.nb_polygons();
+  block.nb_corners = batch.nb_corners();
+  nb_vertices_.resize(block.nb_polygons);
+  for (GEO::index_t f = 0; f < block.nb_polygons; f++)
+    nb_vertices_[f] = batch.nb_vertices(f);
+  ok_ = write_array(file_, &block, 1) &&
+        write_array(file_, batch.seeds.data(), block.nb_polygons) &&
+        write_array(file_, batch.ref_facets.data(), block.nb_polygons) &&
+        write_array(file_, nb_vertices_.data(), block.nb_polygons) &&
+        write_array(file_, batch.vertex_keys.data(), block.nb_corners) &&
+        write_array(file_, batch.points.data(), batch.points.size());
+  if (!ok_) {
+    printf("[RPDStream] %s: write failed\n", path_.c_str());
+    return;
+  }
+  header_.nb_blocks++;
+  header_.nb_polygons += block.nb_polygons;
+  header_.nb_corners += block.nb_corners;
+}
+
+void RPDBinaryFileSink::end() {
+  if (file_ == nullptr) return;
+  if (ok_) {
+    ok_ = fseek(file_, 0, SEEK_SET) == 0 && write_array(file_, &header_, 1);
+  }
+  ok_ = (fclose(file_) == 0) && ok_;
+  file_ = nullptr;
+  if (!ok_) {
+    printf("[RPDStream] %s: write failed\n", path_.c_str());
+    return;
+  }
+  printf("[RPDStream] saved %llu polygons (%llu corners, %llu blocks) to %s\n",
+         (unsigned long long)header_.nb_polygons,
+         (unsigned long long)header_.nb_corners,
+         (unsigned long long)header_.nb_blocks, path_.c_str());
+}
+
+/************************************************************************/
+
+bool RPDPolygonFileReader::open(const std::string& path) {
+  close();
+  file_ = fopen(path.c_str(), "rb");
+  if (file_ == nullptr) {
+    printf("[RPDStream] cannot open %s\n", path.c_str());
+    return false;
+  }
+  bool ok = read_array(file_, &header_, 1) &&
+            std::memcmp(header_.magic, RPD_POLYGON_FILE_MAGIC, 8) == 0 &&
+            header_.version == RPD_POLYGON_FILE_VERSION &&
+            header_.header_size >= sizeof(RPDPolygonFileHeader) &&
+            fseek(file_, long(header_.header_size), SEEK_SET) == 0;
+  if (!ok) {
+    printf("[RPDStream] %s: invalid header\n", path.c_str());
+    close();
+    return false;
+  }
+  return true;
+}
+
+void RPDPolygonFileReader::close() {
+  if (file_ != nullptr) fclose(file_);
+  file_ = nullptr;
+}
+
+bool RPDPolygonFileReader::read_batch(RPDPolygonBatch& batch) {
+  batch.clear();
+  if (file_ == nullptr) return false;
+  RPDPolygonBlockHeader block;
+  if (!read_array(file_, &block, 1)) return false;  // end of file
+  batch.seeds.resize(block.nb_polygons);
+  batch.ref_facets.resize(block.nb_polygons);
+  nb_vertices_.resize(block.nb_polygons);
+  batch.vertex_keys.resize(block.nb_corners);
+  batch.points.resize(3 * std::size_t(block.nb_corners));
+  bool ok = read_array(file_, batch.seeds.data(), block.nb_polygons) &&
+            read_array(file_, batch.ref_facets.data(), block.nb_polygons) &&
+            read_array(file_, nb_vertices_.data(), block.nb_polygons) &&
+            read_array(file_, batch.vertex_keys.data(), block.nb_corners) &&
+            read_array(file_, batch.points.data(), batch.points.size());
+  for (GEO::index_t f = 0; ok && f < block.nb_polygons; f++)
+    batch.corners_ptr.push_back(batch.corners_ptr.back() + nb_vertices_[f]);
+  if (!ok || batch.corners_ptr.back() != block.nb_corners) {
+    printf("[RPDStream] truncated block\n");
+    batch.clear();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace matfp
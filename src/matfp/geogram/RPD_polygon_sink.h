@@ -0,0 +1,254 @@
+#pragma once
+
+#include <geogram/basic/argused.h>
+#include <geogram/basic/common.h>
+#include <geogram/mesh/index.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "RPD_mesh_builder.h"
+
+/**
+ * \file RPD_polygon_sink.h
+ * \brief Streaming output of the surfacic restricted Power diagram, see
+ *  RestrictedPowerDiagram::compute_RPD_streaming(). Polygons are handed
+ *  over in bounded batches instead of being merged into a GEO::Mesh.
+ */
+
+namespace matfp {
+
+/** \brief Default batch size of compute_RPD_streaming(), in corners. */
+const GEO::index_t RPD_STREAM_BATCH_CORNERS = 1 << 16;
+
+/**
+ * \brief A batch of RPD polygons, in CSR form.
+ * \details Vertices are not shared between polygons, each corner has
+ *  its own point. The symbolic key of a corner identifies the vertex
+ *  globally (same key for all the polygons sharing it, in any batch),
+ *  and get_key_bisectors() gives its bisectors.
+ */
+struct RPDPolygonBatch {
+  std::vector<GEO::index_t> seeds;        // "region" of each polygon
+  std::vector<GEO::index_t> ref_facets;   // "ref_facet" of each polygon
+  std::vector<GEO::index_t> corners_ptr;  // nb_polygons() + 1
+  std::vector<RPDVertexKey> vertex_keys;  // one per corner
+  std::vector<double> points;             // 3 per corner
+
+  RPDPolygonBatch() : corners_ptr(1, 0) {}
+
+  GEO::index_t nb_polygons() const { return GEO::index_t(seeds.size()); }
+  GEO::index_t nb_corners() const { return GEO::index_t(vertex_keys.size()); }
+  GEO::index_t nb_vertices(GEO::index_t f) const {
+    return corners_ptr[f + 1] - corners_ptr[f];
+  }
+
+  /**
+   * \brief Removes all polygons, keeps capacity.
+   */
+  void clear() {
+    seeds.clear();
+    ref_facets.clear();
+    corners_ptr.assign(1, 0);
+    vertex_keys.clear();
+    points.clear();
+  }
+
+  void reserve(GEO::index_t nb_corners) {
+    vertex_keys.reserve(nb_corners);
+    points.reserve(3 * nb_corners);
+  }
+};
+
+/**
+ * \brief Receives the polygons of the RPD, batch after batch.
+ * \details Batches come from all the parts, in no particular order,
+ *  but consume() is never called concurrently.
+ */
+class RPDPolygonSink {
+ public:
+  virtual ~RPDPolygonSink() {}
+
+  /** \brief Called once before the first batch. */
+  virtual void begin() {}
+
+  /**
+   * \brief Called for each batch, the batch is reused after it returns.
+   */
+  virtual void consume(const RPDPolygonBatch& batch) = 0;
+
+  /** \brief Called once after the last batch. */
+  virtual void end() {}
+};
+
+/**
+ * \brief Polygon builder that flushes to a RPDPolygonSink.
+ * \details Same interface as RPDMeshBuilder (so it can be used with
+ *  BuildRPD). One instance per part, its batch is sent to the sink
+ *  (under \p sink_mutex, if not null) each time it reaches
+ *  \p batch_corners corners, and by end_surface().
+ */
+class RPDStreamBuilder {
+ public:
+  RPDStreamBuilder(RPDPolygonSink& sink, std::mutex* sink_mutex,
+                   GEO::index_t batch_corners)
+      : sink_(sink),
+        sink_mutex_(sink_mutex),
+        batch_corners_(batch_corners),
+        current_seed_(max_index_t()),
+        current_ref_facet_(max_index_t()) {
+    // one polygon may overflow the batch
+    batch_.reserve(batch_corners_ + 64);
+  }
+
+  void begin_surface() { batch_.clear(); }
+
+  void begin_reference_facet(GEO::index_t ref_facet) {
+    current_ref_facet_ = ref_facet;
+  }
+
+  void begin_facet(GEO::index_t seed) { current_seed_ = seed; }
+
+  void add_vertex_to_facet(const double* point,
+                           const matfp::SymbolicVertex& sym) {
+    batch_.vertex_keys.push_back(get_vertex_key(current_seed_, sym));
+    for (GEO::index_t c = 0; c < 3; ++c) batch_.points.push_back(point[c]);
+  }
+
+  void end_facet() {
+    batch_.seeds.push_back(current_seed_);
+    batch_.ref_facets.push_back(current_ref_facet_);
+    batch_.corners_ptr.push_back(batch_.nb_corners());
+    if (batch_.nb_corners() >= batch_corners_) flush();
+  }
+
+  void end_reference_facet() {}
+
+  void end_surface() { flush(); }
+
+  void set_dimension(GEO::coord_index_t x) { geo_argused(x); }
+
+ private:
+  void flush() {
+    if (batch_.nb_polygons() == 0) return;
+    if (sink_mutex_ != nullptr) {
+      std::lock_guard<std::mutex> lock(*sink_mutex_);
+      sink_.consume(batch_);
+    } else {
+      sink_.consume(batch_);
+    }
+    batch_.clear();
+  }
+
+  RPDPolygonSink& sink_;
+  std::mutex* sink_mutex_;
+  GEO::index_t batch_corners_;
+  GEO::index_t current_seed_;
+  GEO::index_t current_ref_facet_;
+  RPDPolygonBatch batch_;
+};
+
+/************************************************************************/
+
+// Binary RPD polygon file (.rpdb), written batch by batch:
+//
+// [RPDPolygonFileHeader][block 0][block 1]...
+//
+// Each block is a RPDPolygonBlockHeader followed by
+//   uint32 seeds[nb_polygons], uint32 ref_facets[nb_polygons],
+//   uint32 nb_vertices[nb_polygons], RPDVertexKey keys[nb_corners],
+//   double points[3 * nb_corners].
+// The totals of the header are written by RPDBinaryFileSink::end(), a
+// file that was not ended can still be read block by block.
+// All values are little-endian, as on all platforms we build on.
+
+#define RPD_POLYGON_FILE_MAGIC "RPDPOLY\0"
+#define RPD_POLYGON_FILE_VERSION 1
+
+struct RPDPolygonFileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t header_size;  // offset of the first block
+  std::uint64_t nb_blocks;
+  std::uint64_t nb_polygons;
+  std::uint64_t nb_corners;
+};
+
+struct RPDPolygonBlockHeader {
+  std::uint32_t nb_polygons;
+  std::uint32_t nb_corners;
+};
+
+static_assert(sizeof(RPDPolygonFileHeader) == 40, "RPDPolygonFileHeader");
+static_assert(sizeof(RPDPolygonBlockHeader) == 8, "RPDPolygonBlockHeader");
+static_assert(sizeof(RPDVertexKey) == 20, "RPDVertexKey layout");
+static_assert(sizeof(GEO::index_t) == 4, "index_t layout");
+
+/**
+ * \brief Sink that appends each batch to a .rpdb file, only one block
+ *  is in memory at a time.
+ */
+class RPDBinaryFileSink : public RPDPolygonSink {
+ public:
+  explicit RPDBinaryFileSink(const std::string& path);
+  ~RPDBinaryFileSink() override;
+
+  void begin() override;
+  void consume(const RPDPolygonBatch& batch) override;
+  void end() override;
+
+  /**
+   * \brief Tests whether all writes succeeded so far.
+   */
+  bool ok() const { return ok_; }
+  std::uint64_t nb_polygons() const { return header_.nb_polygons; }
+  std::uint64_t nb_corners() const { return header_.nb_corners; }
+
+ private:
+  void close();
+
+  std::string path_;
+  FILE* file_;
+  bool ok_;
+  RPDPolygonFileHeader header_;
+  std::vector<std::uint32_t> nb_vertices_;  // of the current block
+};
+
+/**
+ * \brief Reads a .rpdb file block by block.
+ */
+class RPDPolygonFileReader {
+ public:
+  RPDPolygonFileReader() : file_(nullptr) {}
+  ~RPDPolygonFileReader() { close(); }
+  RPDPolygonFileReader(const RPDPolygonFileReader&) = delete;
+  RPDPolygonFileReader& operator=(const RPDPolygonFileReader&) = delete;
+
+  /**
+   * \brief Opens the file and checks its header.
+   * \return false if the file cannot be opened or is not a valid .rpdb
+   */
+  bool open(const std::string& path);
+  void close();
+
+  /**
+   * \brief Reads the next block into \p batch.
+   * \return false at the end of the file, or on a truncated block
+   */
+  bool read_batch(RPDPolygonBatch& batch);
+
+  /**
+   * \brief Gets the header, totals are zero if the writer did not end.
+   */
+  const RPDPolygonFileHeader& header() const { return header_; }
+
+ private:
+  FILE* file_;
+  RPDPolygonFileHeader header_;
+  std::vector<std::uint32_t> nb_vertices_;
+};
+
+}  // namespace matfp
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <geogram/basic/common.h>
+#include <geogram/basic/process.h>
+#include <geogram/basic/stopwatch.h>
+#include <geogram/mesh/index.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/**
+ * \file RPD_work_stealing.h
+ * \brief Work-stealing scheduler used by RPD_3d_Impl to run many small
+ *  Hilbert-ordered facet chunks on a fixed number of threads.
+ */
+
+namespace matfp {
+
+/**
+ * \brief Runs chunks [0, nb_chunks) on nb_workers threads.
+ * \details Each worker owns a contiguous range of chunks (so that
+ *  consecutive Hilbert chunks stay on the same thread) and pops from
+ *  its front. An idle worker steals the back half of the largest
+ *  remaining range. Records the wall time of every chunk.
+ */
+class ChunkScheduler {
+ public:
+  static constexpr GEO::index_t NO_INDEX = GEO::index_t(-1);
+
+  ChunkScheduler(GEO::index_t nb_chunks, GEO::index_t nb_workers)
+      : nb_workers_(std::max(nb_workers, GEO::index_t(1))),
+        queues_(nb_workers_),
+        locks_(nb_workers_),
+        chunk_time_(nb_chunks, 0.0),
+        chunk_worker_(nb_chunks, GEO::index_t(NO_INDEX)),
+        nb_steals_(0) {
+    for (GEO::index_t w = 0; w < nb_workers_; w++) {
+      queues_[w].begin = GEO::index_t(std::uint64_t(nb_chunks) * w /
+                                      nb_workers_);
+      queues_[w].end = GEO::index_t(std::uint64_t(nb_chunks) * (w + 1) /
+                                    nb_workers_);
+    }
+  }
+
+  /**
+   * \brief Calls \p run_chunk(chunk) for every chunk, in parallel.
+   * \details \p run_chunk must be safe to call concurrently on
+   *  different chunks.
+   */
+  template <class RUN_CHUNK>
+  void run(RUN_CHUNK run_chunk) {
+    GEO::parallel_for(0, nb_workers_, [this, &run_chunk](GEO::index_t w) {
+      GEO::index_t chunk;
+      while (pop(w, chunk) || steal(w, chunk)) {
+        double start = GEO::SystemStopwatch::now();
+        run_chunk(chunk);
+        chunk_time_[chunk] = GEO::SystemStopwatch::now() - start;
+        chunk_worker_[chunk] = w;
+      }
+    });
+  }
+
+  GEO::index_t nb_chunks() const { return chunk_time_.size(); }
+  GEO::index_t nb_workers() const { return nb_workers_; }
+  double chunk_time(GEO::index_t chunk) const { return chunk_time_[chunk]; }
+
+  /**
+   * \brief Prints chunk timings and per-worker busy time.
+   * \param[in] name prefix of the printed lines
+   * \param[in] nb_slowest number of slowest chunks listed individually
+   */
+  void print_timings(const char* name, GEO::index_t nb_slowest = 5) const {
+    if (chunk_time_.empty()) return;
+    std::vector<double> busy(nb_workers_, 0.0);
+    double sum = 0.0, tmin = chunk_time_[0], tmax = chunk_time_[0];
+    for (GEO::index_t c = 0; c < nb_chunks(); c++) {
+      sum += chunk_time_[c];
+      tmin = std::min(tmin, chunk_time_[c]);
+      tmax = std::max(tmax, chunk_time_[c]);
+      if (chunk_worker_[c] != NO_INDEX)
+        busy[chunk_worker_[c]] += chunk_time_[c];
+    }
+    double bmin = *std::min_element(busy.begin(), busy.end());
+    double bmax = *std::max_element(busy.begin(), busy.end());
+    double bavg = sum / nb_workers_;
+    printf("[%s] %u chunks on %u threads, %u steals\n", name, nb_chunks(),
+           nb_workers_, GEO::index_t(nb_steals_));
+    printf("[%s] chunk time: min %.4fs, avg %.4fs, max %.4fs\n", name, tmin,
+           sum / nb_chunks(), tmax);
+    printf("[%s] thread busy: min %.4fs, max %.4fs, imbalance %.2f\n", name,
+           bmin, bmax, bavg == 0.0 ? 1.0 : bmax / bavg);
+
+    std::vector<GEO::index_t> order(nb_chunks());
+    for (GEO::index_t c = 0; c < nb_chunks(); c++) order[c] = c;
+    nb_slowest = std::min(nb_slowest, nb_chunks());
+    std::partial_sort(order.begin(), order.begin() + nb_slowest, order.end(),
+                      [this](GEO::index_t a, GEO::index_t b) {
+                        return chunk_time_[a] > chunk_time_[b];
+                      });
+    for (GEO::index_t i = 0; i < nb_slowest; i++) {
+      printf("[%s]   chunk %u: %.4fs (thread %u)\n", name, order[i],
+             chunk_time_[order[i]], chunk_worker_[order[i]]);
+    }
+  }
+
+ private:
+  struct Queue {
+    GEO::index_t begin;
+    GEO::index_t end;
+  };
+
+  bool pop(GEO::index_t w, GEO::index_t& chunk) {
+    Queue& Q = queues_[w];
+    locks_.acquire_spinlock(w);
+    bool result = (Q.begin < Q.end);
+    if (result) chunk = Q.begin++;
+    locks_.release_spinlock(w);
+    return result;
+  }
+
+  bool steal(GEO::index_t w, GEO::index_t& chunk) {
+    for (;;) {
+      // victim: largest remaining range (may change before it is locked)
+      GEO::index_t victim = NO_INDEX;
+      GEO::index_t victim_size = 0;
+      for (GEO::index_t v = 0; v < nb_workers_; v++) {
+        if (v == w) continue;
+        locks_.acquire_spinlock(v);
+        GEO::index_t size = queues_[v].end - queues_[v].begin;
+        locks_.release_spinlock(v);
+        if (size > victim_size) {
+          victim = v;
+          victim_size = size;
+        }
+      }
+      if (victim == NO_INDEX) return false;
+
+      GEO::index_t stolen_begin = 0, stolen_end = 0;
+      Queue& V = queues_[victim];
+      locks_.acquire_spinlock(victim);
+      if (V.begin < V.end) {
+        stolen_end = V.end;
+        V.end -= (V.end - V.begin + 1) / 2;
+        stolen_begin = V.end;
+      }
+      locks_.release_spinlock(victim);
+      if (stolen_begin == stolen_end) continue;  // victim emptied, retry
+
+      Queue& Q = queues_[w];
+      locks_.acquire_spinlock(w);
+      Q.begin = stolen_begin + 1;
+      Q.end = stolen_end;
+      locks_.release_spinlock(w);
+      nb_steals_++;
+      chunk = stolen_begin;
+      return true;
+    }
+  }
+
+  GEO::index_t nb_workers_;
+  std::vector<Queue> queues_;
+  GEO::Process::SpinLockArray locks_;
+  std::vector<double> chunk_time_;
+  std::vector<GEO::index_t> chunk_worker_;
+  std::atomic<GEO::index_t> nb_steals_;
+};
+
+}  // namespace matfp
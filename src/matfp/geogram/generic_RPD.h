@@ -59,6 +59,7 @@
 #include <iostream>
 
 #include "RPD_callback.h"
+#include "RPD_flat_hash.h"
 #include "generic_RPD_cell.h"
 #include "generic_RPD_polygon.h"
 #include "generic_RPD_utils.h"
@@ -87,7 +88,7 @@ class GenRestrictedPowerDiagram {
   /**
    * \brief Used to allocate the generated points.
    */
-  typedef GEOGen::PointAllocator PointAllocator;
+  typedef RPDPointArena PointAllocator;
 
   /**
    * \brief Internal representation of vertices.
@@ -116,14 +117,20 @@ class GenRestrictedPowerDiagram {
         rt_(rt),
         intersections_(3),
         symbolic_(false),
-        check_SR_(true),
-        exact_(false) {
+        check_SR_(false),
+        exact_(false),
+        precision_(RPD_FAST),
+        nb_clips_(0),
+        nb_clips_skipped_(0) {
     dimension_ = 3;  // though we have weight, dimension should still be 3
     facets_begin_ = UNSPECIFIED_RANGE;
     facets_end_ = UNSPECIFIED_RANGE;
     tets_begin_ = UNSPECIFIED_RANGE;
     tets_end_ = UNSPECIFIED_RANGE;
     connected_components_priority_ = false;
+    facet_filter_ = nullptr;
+    last_located_seed_ = index_t(-1);
+    sr_seed_ = index_t(-1);
     // facet_seed_marking_ = nullptr;
     // connected_component_changed_ = false;
     // current_connected_component_ = 0;
@@ -161,6 +168,16 @@ class GenRestrictedPowerDiagram {
     return connected_components_priority_;
   }
 
+  /**
+   * \brief Restricts surfacic traversal to the facets \p f such that
+   *  (*filter)[f] != 0 (no propagation to other facets).
+   * \param[in] filter one flag per mesh facet, or nullptr for all facets.
+   *  Not copied, must stay alive during the traversal.
+   */
+  void set_facet_filter(const std::vector<char>* filter) {
+    facet_filter_ = filter;
+  }
+
   /**
    * \brief Gets the index of the mesh facet currently processed.
    * \details Can be used in surfacic traversals (and not volumetric
@@ -364,12 +381,16 @@ class GenRestrictedPowerDiagram {
 
     typename GenRestrictedPowerDiagram::Polygon Facet;
     current_polygon_ = nullptr;
-    // seed -> facet
-    GEO::vector<index_t> seed_stamp(rt_->get_nb_vertices(), index_t(-1));
-    GEO::vector<bool> facet_is_marked(facets_end_ - facets_begin_, false);
-
-    FacetSeedHandleStack adjacent_facets;
-    SeedHandleStack adjacent_seeds;
+    // traversal buffers of this part, kept across calls
+    // seeds visited for the current facet, sparse (not O(nb seeds))
+    FlatIndexSet& seed_visited = seed_visited_;
+    GEO::vector<bool>& facet_is_marked = facet_is_marked_;
+    facet_is_marked.assign(facets_end_ - facets_begin_, false);
+    // RT may have changed since last call
+    sr_seed_ = index_t(-1);
+
+    FacetSeedHandleStack& adjacent_facets = adjacent_facets_;
+    SeedHandleStack& adjacent_seeds = adjacent_seeds_;
     Polygon F;
     GEO::Attribute<double> vertex_weight;
     vertex_weight.bind_if_is_defined(mesh_->vertices.attributes(), "weight");
@@ -383,6 +404,7 @@ class GenRestrictedPowerDiagram {
       // GEO::index_t f = 1;
       // logger().debug("going to process facet {}", f);
 
+      if (facet_filter_ != nullptr && !(*facet_filter_)[f]) continue;
       if (!facet_is_marked[f - facets_begin_]) {
         // Propagate along the facet-graph.
         facet_is_marked[f - facets_begin_] = true;
@@ -408,8 +430,8 @@ class GenRestrictedPowerDiagram {
           // This will traverse all the seeds such that their
           // Voronoi cell has a non-empty intersection with
           // the current facet.
-          // std::cout << "seed_stamp size: " << seed_stamp.size() << std::endl;
-          seed_stamp[current_seed_] = current_facet_;
+          seed_visited.clear();
+          seed_visited.insert(current_seed_);
           // std::cout << "adjacent_seeds size: " << adjacent_seeds.size() <<
           // std::endl;
           adjacent_seeds.push(current_seed_handle_);
@@ -473,7 +495,9 @@ class GenRestrictedPowerDiagram {
 
               if (neigh_f >= GEO::signed_index_t(facets_begin_) &&
                   neigh_f < GEO::signed_index_t(facets_end_) &&
-                  neigh_f != GEO::signed_index_t(current_facet_)) {
+                  neigh_f != GEO::signed_index_t(current_facet_) &&
+                  (facet_filter_ == nullptr ||
+                   (*facet_filter_)[neigh_f])) {
                 if (!facet_is_marked[index_t(neigh_f) - facets_begin_]) {
                   facet_is_marked[index_t(neigh_f) - facets_begin_] = true;
                   adjacent_facets.push(FacetSeedHandle(GEO::index_t(neigh_f),
@@ -486,10 +510,7 @@ class GenRestrictedPowerDiagram {
               // std::cout << "neigh_s " << neigh_s << std::endl;
 
               if (neigh_s != -1) {
-                // std::cout << "seed_stamp[neigh_s]: " << seed_stamp[neigh_s]
-                // << " current_facet_: " << current_facet_ << std::endl;
-                if (seed_stamp[neigh_s] != current_facet_) {
-                  seed_stamp[neigh_s] = current_facet_;
+                if (seed_visited.insert(index_t(neigh_s))) {
                   adjacent_seeds.push(
                       find_adjacent_seed(GEO::index_t(neigh_s)));
                 }
@@ -534,8 +555,8 @@ class GenRestrictedPowerDiagram {
     geo_assert(tets_begin_ != UNSPECIFIED_RANGE);
     geo_assert(tets_end_ != UNSPECIFIED_RANGE);
 
-    GEO::vector<GEO::index_t> seed_stamp(rt_->get_nb_vertices(),
-                                         GEO::index_t(-1));
+    // seeds visited for the current tet
+    FlatIndexSet seed_visited;
     GEO::vector<bool> tet_is_marked(tets_end_ - tets_begin_, false);
     // init_get_neighbors();
 
@@ -572,7 +593,8 @@ class GenRestrictedPowerDiagram {
           // This will traverse all the seeds such that their
           // Voronoi cell has a non-empty intersection with
           // the current facet.
-          seed_stamp[current_seed_] = current_tet_;
+          seed_visited.clear();
+          seed_visited.insert(current_seed_);
           adjacent_seeds.push(current_seed_handle_);
 
           while (!adjacent_seeds.empty()) {
@@ -604,8 +626,7 @@ class GenRestrictedPowerDiagram {
               if (id > 0) {
                 // Propagate to adjacent seed
                 GEO::index_t neigh_s = GEO::index_t(id - 1);
-                if (seed_stamp[neigh_s] != current_tet_) {
-                  seed_stamp[neigh_s] = current_tet_;
+                if (seed_visited.insert(neigh_s)) {
                   adjacent_seeds.push(find_adjacent_seed(neigh_s));
                 }
               } else if (id < 0) {
@@ -720,11 +741,11 @@ class GenRestrictedPowerDiagram {
     Polygon* pong = &P2;
 
     // Clip current facet by current Voronoi cell (associated with seed)
-    // if(delaunay_nn_ != nullptr) {
-    //     clip_by_cell_SR(seed, ping, pong);   // "Security Radius" mode.
-    // } else {
-    clip_by_cell(seed_handle, ping, pong);  // Standard mode.
-    // }
+    if (check_SR_) {
+      clip_by_cell_SR(seed_handle, ping, pong);  // "Security Radius" mode.
+    } else {
+      clip_by_cell(seed_handle, ping, pong);  // Standard mode.
+    }
 
     return ping;  // Yes, 'ping', and not 'pong'
                   // see comments in clip_by_cell()
@@ -773,6 +794,67 @@ class GenRestrictedPowerDiagram {
       clip_by_plane(*ping, *pong, i, j);
       swap_polygons(ping, pong);
     }
+#ifdef RPD_STATS
+    nb_clips_ += neighbors_.size();
+#endif
+  }
+
+  /**
+   * \brief Computes the intersection between a power cell
+   *  and a polygon, with radius of security.
+   *
+   * \details Same as clip_by_cell(), but neighbors are visited by
+   *  increasing key(j) = |c_j - c_i| - sqrt(w_j). If R is the largest
+   *  distance between c_i and a vertex of the current polygon, any point x
+   *  of the polygon has pow_j(x) >= (key(j) - R)^2 and pow_i(x) <= R^2 - w_i,
+   *  so once key(j) > R + sqrt(max(R^2 - w_i, 0)) no remaining bisector can
+   *  cut the polygon and clipping stops.
+   *
+   * \param[in] i index of the vertex that defines the power cell
+   * \param[in,out] ping the input polygon. On exit, contains the result.
+   * \param[out] pong a buffer used to implement reentrant clipping.
+   */
+  void clip_by_cell_SR(Vertex_handle_rt& i, Polygon*& ping, Polygon*& pong) {
+    const index_t seed = i->info().tag;
+    if (seed != sr_seed_) {
+      get_neighbors(i);
+      const double* ci = rt_->seed_point(seed);
+      sr_neighbors_.resize(neighbors_.size());
+      for (index_t jj = 0; jj < neighbors_.size(); jj++) {
+        const double* cj = rt_->seed_point(neighbors_[jj]->info().tag);
+        double d = std::sqrt(GEO::Geom::distance2(ci, cj, 3));
+        sr_neighbors_[jj].first = d - std::sqrt(std::max(cj[3], 0.0));
+        sr_neighbors_[jj].second = neighbors_[jj];
+      }
+      std::sort(sr_neighbors_.begin(), sr_neighbors_.end(),
+                [](const std::pair<double, Vertex_handle_rt>& a,
+                   const std::pair<double, Vertex_handle_rt>& b) {
+                  return a.first < b.first;
+                });
+      sr_seed_ = seed;
+    }
+
+    const double* ci = rt_->seed_point(seed);
+    const double wi = ci[3];
+    index_t jj = 0;
+    for (; jj < sr_neighbors_.size(); jj++) {
+      if (ping->nb_vertices() == 0) break;
+      double R2 = 0.0;
+      for (index_t k = 0; k < ping->nb_vertices(); k++) {
+        const double* p = ping->vertex(k).point();
+        R2 = std::max(R2, GEO::Geom::distance2(ci, p, 3));
+      }
+      double R = std::sqrt(R2);
+      double SR = R + std::sqrt(std::max(R2 - wi, 0.0));
+      // conservative margin for rounding errors
+      if (sr_neighbors_[jj].first > SR * (1.0 + 1e-10) + 1e-10) break;
+      clip_by_plane(*ping, *pong, i, sr_neighbors_[jj].second);
+      swap_polygons(ping, pong);
+    }
+#ifdef RPD_STATS
+    nb_clips_ += jj;
+    nb_clips_skipped_ += sr_neighbors_.size() - jj;
+#endif
   }
 
   /**
@@ -791,7 +873,7 @@ class GenRestrictedPowerDiagram {
 
   void clip_by_plane(Polygon& ping, Polygon& pong, Vertex_handle_rt& i,
                      Vertex_handle_rt& j) {
-    ping.clip_by_plane<3>(pong, intersections_, mesh_, rt_, i, j, exact_,
+    ping.clip_by_plane<3>(pong, intersections_, mesh_, rt_, i, j, precision_,
                           symbolic_);
   }
 
@@ -835,11 +917,6 @@ class GenRestrictedPowerDiagram {
       C.clear();
     }
 
-    std::vector<int> neighbors;
-    for (index_t jj = 0; jj < neighbors_.size(); jj++) {
-      Vertex_handle_rt& j = neighbors_[jj];
-      neighbors.push_back(j->info().tag);
-    }
     // logger().debug("tag {} has {} neighbors {}", seed->info().all_tag,
     // neighbors_.size(), neighbors);
 
@@ -890,18 +967,12 @@ class GenRestrictedPowerDiagram {
   /**
    * \brief Caches the neighbors of a Delaunay vertex.
    *
-   * \details This function is only used when the stored delaunay
-   *  triangulation is a traditional one. When the stored delaunay
-   *  triangulation is represented by a KdTree, function is not used.
+   * \details Neighbors are read from the flat neighbor table of the
+   *  regular triangulation (see RegularTriangulationNN::build_neighbor_csr()),
+   *  sorted by descending tag. No copy and no CGAL circulator walk.
    */
   void get_neighbors(Vertex_handle_rt& v) {
-    neighbors_.resize(0);
-    rt_->finite_adjacent_vertices(v, std::back_inserter(neighbors_));
-    // sort from small to big tag
-    std::sort(neighbors_.begin(), neighbors_.end(),
-              [](Vertex_handle_rt& a, Vertex_handle_rt& b) {
-                return a->info().tag > b->info().tag;
-              });
+    neighbors_ = rt_->get_neighbors(v->info().tag);
   }
 
   /********************************************************************/
@@ -909,28 +980,11 @@ class GenRestrictedPowerDiagram {
   /**
    * \brief Fetch neighbor seed handle given tag
    *
-   * \details This function can only be run under the condition that
-   * all neighbors of a given vertex handle are cached
+   * \details O(1) lookup in the tag-indexed handle table of the
+   *  regular triangulation.
    **/
   Vertex_handle_rt find_adjacent_seed(GEO::index_t neigh_s_tag) {
-    if (neighbors_.size() == 0) {
-      printf("neighbors_ not been cached properly!\n");
-      assert(false);
-    }
-    // std::cout << "in find_adjacent_seed, neighbors_ size: " <<
-    // neighbors_.size() << std::endl;
-
-    // todo; use the map in RT instead of looping here
-    for (Vertex_handle_rt n : neighbors_) {
-      if (neigh_s_tag == n->info().tag) return n;
-    }
-
-    for (Vertex_handle_rt n : neighbors_) {
-      std::cout << "neigh_s_tag: " << neigh_s_tag
-                << " and neighbors_ tag: " << n->info().tag << std::endl;
-    }
-    printf("neighbor vertex handle not found!\n");
-    assert(false);
+    return rt_->get_vh(neigh_s_tag);
   }
 
   /**
@@ -973,8 +1027,14 @@ class GenRestrictedPowerDiagram {
     // is guaranteed to have the facet in its Voronoi
     // cell from the point of view of symbolic
     // perturbation).
-    Point pt(p[0], p[1], p[2]);
-    return rt_->nearest_power_vertex(pt);
+    // The walk starts from the last located seed: consecutive
+    // components are close to each other (Hilbert order).
+    Vertex_handle_rt hint;
+    if (rt_->is_in_rt(int(last_located_seed_)))
+      hint = rt_->get_vh(last_located_seed_);
+    Vertex_handle_rt result = rt_->locate_seed(p, hint);
+    last_located_seed_ = result->info().tag;
+    return result;
   }
 
   /********************************************************************/
@@ -997,7 +1057,11 @@ class GenRestrictedPowerDiagram {
   /**
    * \brief Sets the Delaunay triangulation.
    */
-  void set_delaunay(RegularTriangulationNN* rt) { rt_ = rt; }
+  void set_delaunay(RegularTriangulationNN* rt) {
+    rt_ = rt;
+    last_located_seed_ = index_t(-1);
+    sr_seed_ = index_t(-1);
+  }
 
   /**
    * \brief Sets the input mesh.
@@ -1015,6 +1079,19 @@ class GenRestrictedPowerDiagram {
     facets_end_ = facets_end;
   }
 
+  /**
+   * \brief Sets the tetrahedra range.
+   * \details Computations can be restricted to a contiguous tetrahedra
+   *  range (volumetric mode).
+   * \param[in] tets_begin first tetrahedron in the range.
+   * \param[in] tets_end one position past the last tetrahedron in the range.
+   */
+  void set_tetrahedra_range(index_t tets_begin, index_t tets_end) {
+    geo_debug_assert(tets_end >= tets_begin);
+    tets_begin_ = tets_begin;
+    tets_end_ = tets_end;
+  }
+
   /**
    * \brief Gets the current cell.
    * \details The current cell corresponds to the
@@ -1048,16 +1125,30 @@ class GenRestrictedPowerDiagram {
    * \param[in] x if set, exact predicates are used.
    */
   void set_exact_predicates(bool x) {
-    exact_ = x;
+    set_precision(x ? RPD_EXACT : RPD_FAST);
+  }
+  /**
+   * \brief Tests whether exact predicates are used
+   *  (RPD_EXACT or RPD_FILTERED).
+   */
+  bool exact_predicates() const { return exact_; }
+  /**
+   * \brief Sets the precision tier of bisector clipping.
+   * \details RPD_EXACT and RPD_FILTERED ensure symbolic mode. Volumetric
+   *  cells have no filtered tier and use exact predicates for both.
+   */
+  void set_precision(RPDPrecision x) {
+    precision_ = x;
+    exact_ = (x != RPD_FAST);
     // exact mode requires symbolic mode.
     if (exact_) {
       symbolic_ = true;
     }
   }
   /**
-   * \brief Tests whether exact predicates are used.
+   * \brief Gets the precision tier of bisector clipping.
    */
-  bool exact_predicates() const { return exact_; }
+  RPDPrecision precision() const { return precision_; }
 
   /**
    * \brief Specifies whether radius of security should be enforced.
@@ -1072,8 +1163,24 @@ class GenRestrictedPowerDiagram {
   bool check_SR() const { return check_SR_; }
 
   /**
-   * \brief Gets the PointAllocator.
-   * \return a pointer to the PointAllocator, used
+   * \brief Gets the number of bisectors clipped in surfacic mode.
+   * \details Clips are counted only with -DRPD_STATS.
+   */
+  GEO::uint64 nb_clips() const { return nb_clips_; }
+
+  /**
+   * \brief Gets the number of bisectors skipped by the radius of security.
+   */
+  GEO::uint64 nb_clips_skipped() const { return nb_clips_skipped_; }
+
+  void reset_clip_stats() {
+    nb_clips_ = 0;
+    nb_clips_skipped_ = 0;
+  }
+
+  /**
+   * \brief Gets the point arena.
+   * \return a pointer to the point arena, used
    *  to create the new vertices generated by
    *  intersections.
    */
@@ -1539,7 +1646,11 @@ class GenRestrictedPowerDiagram {
   PointAllocator intersections_;
   Polygon* current_polygon_;
   Polygon P1, P2;
-  std::vector<Vertex_handle_rt> neighbors_;
+  RTNeighborRange neighbors_;
+
+  // neighbors of seed sr_seed_ sorted by radius of security key
+  index_t sr_seed_;
+  std::vector<std::pair<double, Vertex_handle_rt>> sr_neighbors_;
   index_t current_facet_;
   index_t current_seed_;
   Vertex_handle_rt current_seed_handle_;
@@ -1553,6 +1664,17 @@ class GenRestrictedPowerDiagram {
   bool symbolic_;
   bool check_SR_;
   bool exact_;
+  RPDPrecision precision_;
+
+  // surfacic traversal buffers, see compute_surfacic_with_seeds_priority()
+  FlatIndexSet seed_visited_;
+  GEO::vector<bool> facet_is_marked_;
+  FacetSeedHandleStack adjacent_facets_;
+  SeedHandleStack adjacent_seeds_;
+
+  // clipping statistics, see clip_by_cell_SR()
+  GEO::uint64 nb_clips_;
+  GEO::uint64 nb_clips_skipped_;
 
   // though we have weight, dimension should still be 3
   coord_index_t dimension_;
@@ -1567,6 +1689,12 @@ class GenRestrictedPowerDiagram {
 
   bool connected_components_priority_;
 
+  // if not null, only facets with non-zero flag are traversed
+  const std::vector<char>* facet_filter_;
+
+  // tag of the last seed found by find_seed_near_point(), walk hint
+  index_t last_located_seed_;
+
  private:
   /**
    * \brief Forbids construction from copy.
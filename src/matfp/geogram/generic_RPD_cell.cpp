@@ -73,17 +73,17 @@ GEO::Sign ConvexCellCGAL::side_exact(const Mesh* mesh,
       unsigned int b1 = q.sym().bisector(1);
       unsigned int b2 = q.sym().bisector(2);
 
-      const std::vector<double> b0_point = rt->get_double_vector(b0);
-      const std::vector<double> b1_point = rt->get_double_vector(b1);
-      const std::vector<double> b2_point = rt->get_double_vector(b2);
+      const double* b0_point = rt->seed_point(b0);
+      const double* b1_point = rt->seed_point(b1);
+      const double* b2_point = rt->seed_point(b2);
 
       if (dim == 3) {
         // 3d is a special case for side4()
         //   (intrinsic dim == ambient dim)
         // therefore embedding tet q0,q1,q2,q3 is not needed.
         return matfp::PCK::power_side4_3d_SOS(
-            pi, wi, b0_point.data(), rt->get_weight(b0), b1_point.data(),
-            rt->get_weight(b1), b2_point.data(), rt->get_weight(b2), pj, wj);
+            pi, wi, b0_point, rt->seed_weight(b0), b1_point,
+            rt->seed_weight(b1), b2_point, rt->seed_weight(b2), pj, wj);
       } else {
         printf("NOT IMPLEMENTED FOR OTHER DIM!\n");
         assert(false);
@@ -99,8 +99,8 @@ GEO::Sign ConvexCellCGAL::side_exact(const Mesh* mesh,
       unsigned int b1 = q.sym().bisector(1);
       unsigned int f = q.sym().boundary_facet(0);
 
-      const std::vector<double> b0_point = rt->get_double_vector(b0);
-      const std::vector<double> b1_point = rt->get_double_vector(b1);
+      const double* b0_point = rt->seed_point(b0);
+      const double* b1_point = rt->seed_point(b1);
 
       // if(symbolic_is_surface) {
       //     index_t c = mesh->facets.corners_begin(f);
@@ -143,8 +143,8 @@ GEO::Sign ConvexCellCGAL::side_exact(const Mesh* mesh,
           t, GEO::MeshCells::local_tet_facet_vertex_index(lf, 2));
 
       return matfp::PCK::power_side3_SOS(
-          pi, wi, b0_point.data(), rt->get_weight(b0), b1_point.data(),
-          rt->get_weight(b1), pj, wj, mesh->vertices.point_ptr(j0),
+          pi, wi, b0_point, rt->seed_weight(b0), b1_point,
+          rt->seed_weight(b1), pj, wj, mesh->vertices.point_ptr(j0),
           mesh->vertices.point_ptr(j1), mesh->vertices.point_ptr(j2));
       // }
     }
@@ -155,11 +155,11 @@ GEO::Sign ConvexCellCGAL::side_exact(const Mesh* mesh,
       //   and one bisector [pi b0].
       // i.e. it's a vertex of the surface.
       index_t b0 = q.sym().bisector(0);
-      const std::vector<double> b0_point = rt->get_double_vector(b0);
+      const double* b0_point = rt->seed_point(b0);
       index_t e0, e1;
       q.sym().get_boundary_edge(e0, e1);
       return matfp::PCK::power_side2_SOS(
-          pi, wi, b0_point.data(), rt->get_weight(b0), pj, wj,
+          pi, wi, b0_point, rt->seed_weight(b0), pj, wj,
           mesh->vertices.point_ptr(e0), mesh->vertices.point_ptr(e1));
     }
 
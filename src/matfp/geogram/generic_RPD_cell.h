@@ -853,8 +853,8 @@ class GEOGRAM_API ConvexCellCGAL {
     index_t new_t_first = index_t(-1);
     index_t new_t_prev = index_t(-1);
 
-    const std::vector<double> pi = rt->get_double_vector(i->point());
-    const std::vector<double> pj = rt->get_double_vector(j->point());
+    const double* pi = rt->seed_point(i->info().tag);
+    const double* pj = rt->seed_point(j->info().tag);
     // logger().debug("pi {} has weight {} s_radius {} is_feature {}, pj {} has
     // weight {} s_radius {} is_feature {}",
     //     i->info().all_tag, pi[3], i->info().sq_radius, i->info().is_feature,
@@ -871,7 +871,7 @@ class GEOGRAM_API ConvexCellCGAL {
       // we use the weight from pi[3] and pj[3]
       triangle_dual(new_t).intersect_geom<DIM>(
           intersections_, triangle_dual(t),
-          triangle_dual(triangle_adjacent(t, e)), pi.data(), pj.data());
+          triangle_dual(triangle_adjacent(t, e)), pi, pj);
 
       if (symbolic) {
         triangle_dual(new_t).sym().intersect_symbolic(
@@ -1011,7 +1011,7 @@ class GEOGRAM_API ConvexCellCGAL {
   /**
    * \brief Evaluates the equation of a bisector at a given point.
    * \details Positive side corresponds to vertex \p i and negative
-   * side to vertex \p j.
+   * side to vertex \p j. Power distances, weights are pi[3] and pj[3].
    * \param[in] rt the regular triangulation
    * \param[in] i index of the first extremity of the bisector
    *    in \p rt
@@ -1024,10 +1024,11 @@ class GEOGRAM_API ConvexCellCGAL {
                                          const Vertex_handle_rt& i,
                                          const Vertex_handle_rt& j,
                                          const double* q) {
-    const std::vector<double> pi = rt->get_double_vector(i->point());
-    const std::vector<double> pj = rt->get_double_vector(j->point());
-    double result = 0;
-    // TODO: This is not true if i & j have weights
+    const double* pi = rt->seed_point(i->info().tag);
+    const double* pj = rt->seed_point(j->info().tag);
+    // the furthest point must be on j's side of the power bisector,
+    // else weighted clips are missed by find_furthest_point_linear_scan()
+    double result = pi[3] - pj[3];
     for (coord_index_t c = 0; c < DIM; ++c) {
       result += GEO::geo_sqr(q[c] - pj[c]);
       result -= GEO::geo_sqr(q[c] - pi[c]);
@@ -1126,11 +1127,11 @@ class GEOGRAM_API ConvexCellCGAL {
                  const Vertex_handle_rt& j, bool exact) const {
     GEO::Sign result = GEO::ZERO;
 
-    const std::vector<double> pi = rt->get_double_vector(i->point());
-    const std::vector<double> pj = rt->get_double_vector(j->point());
+    const double* pi = rt->seed_point(i->info().tag);
+    const double* pj = rt->seed_point(j->info().tag);
 
-    const double wi = rt->get_weight(i->point());
-    const double wj = rt->get_weight(j->point());
+    const double wi = rt->seed_weight(i->info().tag);
+    const double wj = rt->seed_weight(j->info().tag);
 
     // if (pi[3] != wi || pj[3] != wj) {
     //   logger().error("checking side pi {}, pj {}, wi {}, wj {}", pi, pj, wi,
@@ -1141,7 +1142,7 @@ class GEOGRAM_API ConvexCellCGAL {
     // logger().debug("pi: {}, pj: {}", i->info().tag, j->info().tag);
 
     // if(exact) {
-    result = side_exact(mesh, rt, v, pi.data(), wi, pj.data(), wj, DIM,
+    result = side_exact(mesh, rt, v, pi, wi, pj, wj, DIM,
                         symbolic_is_surface_);
     // print_sign(result);
     // } else {
@@ -1345,7 +1346,7 @@ class GEOGRAM_API ConvexCellCGAL {
   GEO::vector<Vertex> vertices_;
   index_t first_free_;
   bool v_to_t_dirty_;
-  GEOGen::PointAllocator intersections_;
+  RPDPointArena intersections_;
   bool symbolic_is_surface_;
   signed_index_t cell_id_;
 
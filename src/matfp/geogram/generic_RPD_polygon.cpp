@@ -165,8 +165,8 @@ GEO::Sign PolygonCGAL::side_exact(const GEO::Mesh* mesh,
       unsigned int b1 = q.sym().bisector(1);
       unsigned int f = q.sym().boundary_facet(0);
 
-      const std::vector<double> b0_point = rt->get_double_vector(b0);
-      const std::vector<double> b1_point = rt->get_double_vector(b1);
+      const double* b0_point = rt->seed_point(b0);
+      const double* b1_point = rt->seed_point(b1);
 
       index_t if0 = mesh->facets.vertex(f, 0);
       index_t if1 = mesh->facets.vertex(f, 1);
@@ -175,8 +175,8 @@ GEO::Sign PolygonCGAL::side_exact(const GEO::Mesh* mesh,
       const double* f1 = mesh->vertices.point_ptr(if1);
       const double* f2 = mesh->vertices.point_ptr(if2);
       return matfp::PCK::power_side3_SOS(
-          pi, wi, b0_point.data(), rt->get_weight(b0), b1_point.data(),
-          rt->get_weight(b1), pj, wj, f0, f1, f2);
+          pi, wi, b0_point, rt->seed_weight(b0), b1_point,
+          rt->seed_weight(b1), pj, wj, f0, f1, f2);
     }
 
     case 2: {
@@ -185,11 +185,11 @@ GEO::Sign PolygonCGAL::side_exact(const GEO::Mesh* mesh,
       //   and one bisector [pi b0].
       // i.e. it's a vertex of the surface.
       unsigned int b0 = q.sym().bisector(0);
-      const std::vector<double> b0_point = rt->get_double_vector(b0);
+      const double* b0_point = rt->seed_point(b0);
       index_t e0, e1;
       q.sym().get_boundary_edge(e0, e1);
       return matfp::PCK::power_side2_SOS(
-          pi, wi, b0_point.data(), rt->get_weight(b0), pj, wj,
+          pi, wi, b0_point, rt->seed_weight(b0), pj, wj,
           mesh->vertices.point_ptr(e0), mesh->vertices.point_ptr(e1));
     }
 
@@ -205,4 +205,29 @@ GEO::Sign PolygonCGAL::side_exact(const GEO::Mesh* mesh,
   geo_assert_not_reached;
 }
 
+GEO::Sign PolygonCGAL::side_filtered(const GEO::Mesh* mesh,
+                                     const RegularTriangulationNN* rt,
+                                     const matfp::Vertex& q, const double* pi,
+                                     double wi, const double* pj, double wj,
+                                     GEO::coord_index_t dim) {
+  // relative tolerance, not a certified bound: q may be an intersection
+  // vertex computed from other intersection vertices, whose error is not
+  // tracked (RPD_FILTERED is approximate)
+  const double rel_eps = 1e-12;
+  const double* p = q.point();
+  // (|q-pj|^2 - wj) - (|q-pi|^2 - wi)
+  double r = wi - wj;
+  double mag = ::fabs(wi) + ::fabs(wj);
+  for (GEO::coord_index_t c = 0; c < dim; ++c) {
+    double a = p[c] - pj[c];
+    double b = p[c] - pi[c];
+    r += a * a - b * b;
+    mag += a * a + b * b + 2.0 * ::fabs(p[c]) * (::fabs(a) + ::fabs(b));
+  }
+  double bound = rel_eps * mag;
+  if (r > bound) return GEO::POSITIVE;
+  if (r < -bound) return GEO::NEGATIVE;
+  return side_exact(mesh, rt, q, pi, wi, pj, wj, dim);
+}
+
 }  // namespace matfp
\ No newline at end of file
@@ -48,12 +48,31 @@
 #include <geogram/basic/attributes.h>
 #include <geogram/basic/common.h>
 
+#include "RPD_inline_vector.h"
 #include "generic_RPD_vertex.h"
 #include "triangulation.h"
 
 namespace matfp {
 // using namespace GEOGen;
 
+/**
+ * \brief Precision tiers of bisector clipping.
+ * \details RPD_EXACT is the reference and the only certified tier.
+ *  RPD_FILTERED and RPD_FAST are approximate. RPD_FILTERED uses exact
+ *  predicates only near the bisector, within a fixed relative tolerance
+ *  that is not an error bound (see side_filtered()): the vertices it
+ *  tests are themselves computed in floating point, with no bound on
+ *  their error. It usually gives the same diagram, but not provably.
+ *  RPD_FAST trades exactness for speed (previews, parameter sweeps).
+ *  validate_RPD_precision() in RPD.h checks a tier against RPD_EXACT on
+ *  a given input.
+ */
+enum RPDPrecision {
+  RPD_EXACT = 0,     ///< symbolically perturbed exact predicates
+  RPD_FILTERED = 1,  ///< approximate, exact near the bisector only
+  RPD_FAST = 2       ///< floating point only, may miss or add polygons
+};
+
 /**
  * \brief Internal representation of polygons for GenericVoronoiDiagram.
  * \details Stores both geometrical and symbolic representations.
@@ -124,7 +143,7 @@ class PolygonCGAL {
    */
   matfp::Vertex* add_vertex(const matfp::Vertex& v) {
     vertex_.push_back(v);
-    return &*(vertex_.rbegin());
+    return &vertex_.back();
   }
 
   /**
@@ -167,23 +186,23 @@ class PolygonCGAL {
    * \param[in] i index of one extremity of bisector in \p delaunay
    * \param[in] j index of the other extremity of the bisector
    *    in \p delaunay
-   * \param[in] exact if true, exact predicates are used.
-   *   Implies symbolic.
+   * \param[in] precision predicates used to classify the vertices,
+   *   RPD_EXACT and RPD_FILTERED imply symbolic.
    * \param[in] symbolic if true, symbolic representation
    *   of vertices is computed
    */
   template <index_t DIM>
-  void clip_by_plane(PolygonCGAL& target, PointAllocator& target_intersections,
+  void clip_by_plane(PolygonCGAL& target, RPDPointArena& target_intersections,
                      const GEO::Mesh* mesh, const RegularTriangulationNN* rt,
-                     Vertex_handle_rt& i, Vertex_handle_rt& j, bool exact,
-                     bool symbolic) {
-    // if(exact) {
-    clip_by_plane_exact<3>(target, target_intersections, mesh, rt, i, j);
-    // } else {
-    //     clip_by_plane_fast<DIM>(
-    //         target, target_intersections, rt, i, j, symbolic
-    //     );
-    // }
+                     Vertex_handle_rt& i, Vertex_handle_rt& j,
+                     RPDPrecision precision, bool symbolic) {
+    if (precision == RPD_FAST) {
+      clip_by_plane_fast<DIM>(target, target_intersections, rt, i, j,
+                              symbolic);
+    } else {
+      clip_by_plane_exact<DIM>(target, target_intersections, mesh, rt, i, j,
+                               precision == RPD_FILTERED);
+    }
   }
 
   /**
@@ -205,7 +224,7 @@ class PolygonCGAL {
    * \brief Clips a Polygon with a plane (fast inexact version).
    * \details Computes the intersection between this Polygon
    * and the half-space determined by the positive side
-   * of the bisector of segment [i,j] (the side of i).
+   * of the power bisector of segments [i,j] (the side of i).
    * This version uses a "fused" predicates-constructions
    * strategy (and reuses the computations from the predicates
    * to accelerate the constructions).
@@ -227,7 +246,7 @@ class PolygonCGAL {
    */
   template <index_t DIM>
   void clip_by_plane_fast(PolygonCGAL& target,
-                          PointAllocator& target_intersections,
+                          RPDPointArena& target_intersections,
                           const RegularTriangulationNN* rt, Vertex_handle_rt i,
                           Vertex_handle_rt j, bool symbolic) const {
     target.clear();
@@ -235,17 +254,17 @@ class PolygonCGAL {
       return;
     }
 
-    // TODO: remember to delete if using this function
-    const double* geo_restrict pi = rt->get_double_data(i->point());
+    const double* geo_restrict pi = rt->seed_point(i->info().tag);
     geo_assume_aligned(pi, geo_dim_alignment(DIM));
-    const double* geo_restrict pj = rt->get_double_data(j->point());
+    const double* geo_restrict pj = rt->seed_point(j->info().tag);
     geo_assume_aligned(pj, geo_dim_alignment(DIM));
 
-    // Compute d = n . m, where n is the
+    // Compute d = n . m - (wi - wj), where n is the
     // normal vector of the bisector [pi,pj]
-    // and m the middle point of the bisector.
+    // and m the middle point of the bisector,
+    // shifted by the weights (power bisector).
     geo_decl_aligned(double d);
-    d = 0;
+    d = rt->seed_weight(j->info().tag) - rt->seed_weight(i->info().tag);
     for (coord_index_t c = 0; c < DIM; ++c) {
       d += (pi[c] + pj[c]) * (pi[c] - pj[c]);
     }
@@ -360,13 +379,16 @@ class PolygonCGAL {
    * \param[in] i index of one extremity of bisector in \p delaunay
    * \param[in] j index of the other extremity of
    *  the bisector in \p delaunay
+   * \param[in] filtered if true, vertices clearly on one side are
+   *  classified in floating point, see side_filtered()
    */
   template <index_t DIM>
   void clip_by_plane_exact(PolygonCGAL& target,
-                           PointAllocator& target_intersections,
+                           RPDPointArena& target_intersections,
                            const GEO::Mesh* mesh,
                            const RegularTriangulationNN* rt,
-                           Vertex_handle_rt& i, Vertex_handle_rt& j) {
+                           Vertex_handle_rt& i, Vertex_handle_rt& j,
+                           bool filtered = false) {
     // logger().debug("In clip_by_plane_exact-----");
     // logger().debug("nb_vertices {}", nb_vertices());
 
@@ -388,11 +410,12 @@ class PolygonCGAL {
     // const double* pi = pii.data();
     // const double* pj = pjj.data();
 
-    const double* pi = rt->get_double_data(i->point());
-    const double* pj = rt->get_double_data(j->point());
+    // (x,y,z,w) from seed cache, no allocation
+    const double* pi = rt->seed_point(i->info().tag);
+    const double* pj = rt->seed_point(j->info().tag);
 
-    const double wi = rt->get_weight(i->point());
-    const double wj = rt->get_weight(j->point());
+    const double wi = rt->seed_weight(i->info().tag);
+    const double wj = rt->seed_weight(j->info().tag);
 
     // if (i->info().tag == 457) {
     //     logger().debug("pi pos {}: ({},{},{},{}) , pj pos {}: ({},{},{},{})",
@@ -407,7 +430,9 @@ class PolygonCGAL {
     // The predecessor of the first vertex is the last vertex
     index_t prev_k = nb_vertices() - 1;
     const Vertex* prev_vk = &(vertex(prev_k));
-    GEO::Sign prev_status = side_exact(mesh, rt, *prev_vk, pi, wi, pj, wj, DIM);
+    GEO::Sign prev_status =
+        filtered ? side_filtered(mesh, rt, *prev_vk, pi, wi, pj, wj, DIM)
+                 : side_exact(mesh, rt, *prev_vk, pi, wi, pj, wj, DIM);
 
     const double* prev_vkp = prev_vk->point();
 
@@ -432,7 +457,9 @@ class PolygonCGAL {
       //     );
       // }
 
-      GEO::Sign status = side_exact(mesh, rt, *vk, pi, wi, pj, wj, DIM);
+      GEO::Sign status =
+          filtered ? side_filtered(mesh, rt, *vk, pi, wi, pj, wj, DIM)
+                   : side_exact(mesh, rt, *vk, pi, wi, pj, wj, DIM);
 
       // if (i->info().tag == 457) {
       // print_sign(status);
@@ -497,10 +524,6 @@ class PolygonCGAL {
       prev_status = status;
       prev_k = k;
     }
-    delete[] pi;
-    delete[] pj;
-    pi = nullptr;
-    pj = nullptr;
 
     // if (i->info().tag == 457) {
     //     logger().debug("target nb_vertices {}", target.nb_vertices());
@@ -551,8 +574,26 @@ class PolygonCGAL {
                               double wi, const double* pj, double wj,
                               GEO::coord_index_t dim);
 
+  /**
+   * \brief Returns the position of a point
+   * relative to a bisector (filtered version).
+   * \details Evaluates the power side of the geometric position
+   *  of q in floating point, and falls back to side_exact() when
+   *  the result is within an error bound. The bound covers rounding
+   *  of the evaluation and of the (computed) positions of
+   *  intersection vertices, it is not a certified filter.
+   * \return POSITIVE if q is on pi's side, NEGATIVE otherwise
+   */
+  static GEO::Sign side_filtered(const GEO::Mesh* mesh,
+                                 const RegularTriangulationNN* rt,
+                                 const matfp::Vertex& q, const double* pi,
+                                 double wi, const double* pj, double wj,
+                                 GEO::coord_index_t dim);
+
  private:
-  GEO::vector<matfp::Vertex> vertex_;
+  // clipped facets rarely have more than a few vertices
+  static const index_t NB_INLINE_VERTICES = 32;
+  InlineVector<matfp::Vertex, NB_INLINE_VERTICES> vertex_;
 };
 
 }  // namespace matfp
\ No newline at end of file
@@ -110,19 +110,23 @@ typedef FacetSeedHandle TetSeedHandle;
 
 /**
  * \brief A stack of FacetSeed.
- * \details Used by GEOGen::RestrictedVoronoiDiagram.
+ * \details Used by GEOGen::RestrictedVoronoiDiagram. Backed by a
+ *  vector, so that a stack emptied then refilled does not allocate.
  */
-typedef std::stack<FacetSeedHandle> FacetSeedHandleStack;
+typedef std::stack<FacetSeedHandle, std::vector<FacetSeedHandle>>
+    FacetSeedHandleStack;
 
 /**
  * \brief A stack of TetSeed.
  * \details Used by GEOGen::RestrictedVoronoiDiagram.
  */
-typedef std::stack<TetSeedHandle> TetSeedHandleStack;
+typedef std::stack<TetSeedHandle, std::vector<TetSeedHandle>>
+    TetSeedHandleStack;
 /**
  * \brief A stack of seed indices (index_t).
  * \details Used by GEOGen::RestrictedVoronoiDiagram.
  */
-typedef std::stack<Vertex_handle_rt> SeedHandleStack;
+typedef std::stack<Vertex_handle_rt, std::vector<Vertex_handle_rt>>
+    SeedHandleStack;
 
 }  // namespace matfp
\ No newline at end of file
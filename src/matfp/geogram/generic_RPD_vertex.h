@@ -52,9 +52,11 @@
 #include <geogram/delaunay/delaunay_nn.h>
 #include <geogram/mesh/mesh.h>
 
-// definition of GEOGen::small_set, GEOGen::ORIGINAL, GEOGen::PointAllocator
+// definition of GEOGen::small_set, GEOGen::ORIGINAL
 #include <geogram/voronoi/generic_RVD_vertex.h>
 
+#include "RPD_arena.h"
+
 /**
  * \file geogram/voronoi/generic_RPD_vertex.h
  * \brief Types and utilities for manipulating vertices in geometric
@@ -76,7 +78,6 @@ using GEO::signed_index_t; /**< \brief type for indices (can be <0)     */
 
 using GEO::Mesh;
 
-using GEOGen::PointAllocator;
 using GEOGen::small_set;
 
 /**
@@ -503,7 +504,7 @@ class Vertex {
    *  argument for efficiency considerations
    */
   template <index_t DIM>
-  void intersect_geom_new(GEOGen::PointAllocator& target_intersections,
+  void intersect_geom_new(RPDPointArena& target_intersections,
                           const Vertex& vq1, const Vertex& vq2,
                           const double* p1, const double* p2) {
     const double l1 = sq_dist(p2, p1, DIM);
@@ -556,7 +557,7 @@ class Vertex {
    *  argument for efficiency considerations
    */
   template <index_t DIM>
-  void intersect_geom(GEOGen::PointAllocator& target_intersections,
+  void intersect_geom(RPDPointArena& target_intersections,
                       const Vertex& vq1, const Vertex& vq2, const double* p1,
                       const double* p2) {
     const double R1 = 0.5 * (p1[3] - p2[3]);
@@ -53,6 +53,12 @@
 #include <geogram/numerics/predicates.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #define FPG_UNCERTAIN_VALUE 0
 #include "predicates/powerside1.h"
@@ -117,6 +123,206 @@ void SOS_sort(const double** begin, const double** end, index_t dim) {
   }
 }
 
+// ================= statistics ====================================
+
+enum PowerSideCounter { CNT_TOTAL = 0, CNT_STATIC, CNT_DYNAMIC, CNT_SOS };
+
+// counters are compiled in only with -DRPD_STATS (cmake option RPD_STATS)
+#ifdef RPD_STATS
+
+/**
+ * \brief Counters of one thread, summed by PCK::get_power_side_stats().
+ * \details Only written by their own thread, so increments are
+ *  plain loads/stores (relaxed atomics to allow reading them).
+ */
+struct PowerSideCounters {
+  std::atomic<GEO::uint64> c[3][4];  // [side1..3][total,static,dynamic,sos]
+  PowerSideCounters() { reset(); }
+  void reset() {
+    for (index_t i = 0; i < 3; i++)
+      for (index_t j = 0; j < 4; j++) c[i][j].store(0);
+  }
+};
+
+// never freed: a thread may exit before the stats are read
+std::mutex power_side_counters_lock_;
+std::vector<PowerSideCounters*> power_side_counters_;
+
+PowerSideCounters& thread_power_side_counters() {
+  thread_local PowerSideCounters* counters = nullptr;
+  if (counters == nullptr) {
+    counters = new PowerSideCounters();
+    std::lock_guard<std::mutex> guard(power_side_counters_lock_);
+    power_side_counters_.push_back(counters);
+  }
+  return *counters;
+}
+
+inline void count_power_side(index_t side, PowerSideCounter what) {
+  std::atomic<GEO::uint64>& c = thread_power_side_counters().c[side - 1][what];
+  c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+#else
+
+inline void count_power_side(index_t, PowerSideCounter) {}
+
+#endif  // RPD_STATS
+
+// ================= dynamic filter ================================
+
+/**
+ * \brief A double with a bound on its absolute error.
+ * \details |exact - v| <= e, where exact is the value the same expression
+ *  would have in exact arithmetic. Each operation adds the rounding error
+ *  u|v| (plus the underflow error for products).
+ */
+struct ErrDouble {
+  double v;
+  double e;
+};
+
+const double FILTER_U = DBL_EPSILON * 0.5 * (1.0 + 4.0 * DBL_EPSILON);
+const double FILTER_ETA = DBL_MIN * DBL_EPSILON;  // >= 2^-1075
+
+inline ErrDouble err_exact(double x) { return ErrDouble{x, 0.0}; }
+
+inline ErrDouble operator+(const ErrDouble& a, const ErrDouble& b) {
+  double v = a.v + b.v;
+  return ErrDouble{v, (a.e + b.e + FILTER_U * std::fabs(v)) *
+                          (1.0 + 2.0 * FILTER_U)};
+}
+
+inline ErrDouble operator-(const ErrDouble& a, const ErrDouble& b) {
+  double v = a.v - b.v;
+  return ErrDouble{v, (a.e + b.e + FILTER_U * std::fabs(v)) *
+                          (1.0 + 2.0 * FILTER_U)};
+}
+
+inline ErrDouble operator*(const ErrDouble& a, const ErrDouble& b) {
+  double v = a.v * b.v;
+  double e = std::fabs(a.v) * b.e + std::fabs(b.v) * a.e + a.e * b.e +
+             FILTER_U * std::fabs(v) + FILTER_ETA;
+  return ErrDouble{v, e * (1.0 + 4.0 * FILTER_U)};
+}
+
+inline ErrDouble operator*(double s, const ErrDouble& a) {
+  // s is a power of two
+  return ErrDouble{s * a.v, s * a.e};
+}
+
+/**
+ * \return the sign of \p x, or ZERO if it cannot be certified
+ */
+inline Sign err_sign(const ErrDouble& x) {
+  if (x.v > x.e) return POSITIVE;
+  if (-x.v > x.e) return NEGATIVE;
+  return ZERO;
+}
+
+inline ErrDouble err_sq_dist(const double* p, const double* q) {
+  ErrDouble d0 = err_exact(p[0]) - err_exact(q[0]);
+  ErrDouble d1 = err_exact(p[1]) - err_exact(q[1]);
+  ErrDouble d2 = err_exact(p[2]) - err_exact(q[2]);
+  return d0 * d0 + d1 * d1 + d2 * d2;
+}
+
+// (p1 - p0).(q0 - p0), same as expansion_dot_at(p1, q0, p0)
+inline ErrDouble err_dot_at(const double* p1, const double* q0,
+                            const double* p0) {
+  ErrDouble r = err_exact(0.0);
+  for (index_t i = 0; i < 3; i++) {
+    ErrDouble a = err_exact(p1[i]) - err_exact(p0[i]);
+    ErrDouble b = err_exact(q0[i]) - err_exact(p0[i]);
+    r = r + a * b;
+  }
+  return r;
+}
+
+/**
+ * \brief Dynamic filter for side1, same formula as side1_exact_SOS().
+ * \return the sign if certified, ZERO otherwise (then SOS may apply)
+ */
+Sign side1_dynamic_filter(const double* p0, const double w0,
+                          const double* p1, const double w1,
+                          const double* q0) {
+  ErrDouble L = err_sq_dist(p0, p1) + (err_exact(w0) - err_exact(w1));
+  ErrDouble a = 2.0 * err_dot_at(p1, q0, p0);
+  return err_sign(L - a);
+}
+
+/**
+ * \brief Dynamic filter for side2, same formula as side2_exact_SOS().
+ * \return the sign if certified, ZERO otherwise
+ */
+Sign side2_dynamic_filter(const double* p0, const double w0,
+                          const double* p1, const double w1,
+                          const double* p2, const double w2,
+                          const double* q0, const double* q1) {
+  ErrDouble L1 = err_sq_dist(p1, p0) + (err_exact(w0) - err_exact(w1));
+  ErrDouble L2 = err_sq_dist(p2, p0) + (err_exact(w0) - err_exact(w2));
+  ErrDouble a10 = 2.0 * err_dot_at(p1, q0, p0);
+  ErrDouble a11 = 2.0 * err_dot_at(p1, q1, p0);
+  ErrDouble a20 = 2.0 * err_dot_at(p2, q0, p0);
+  ErrDouble a21 = 2.0 * err_dot_at(p2, q1, p0);
+
+  ErrDouble Delta = a11 - a10;
+  Sign Delta_sign = err_sign(Delta);
+  if (Delta_sign == ZERO) return ZERO;
+
+  ErrDouble DeltaLambda0 = a11 - L1;
+  ErrDouble DeltaLambda1 = L1 - a10;
+  ErrDouble r = Delta * L2 - (a20 * DeltaLambda0 + a21 * DeltaLambda1);
+  return Sign(Delta_sign * err_sign(r));
+}
+
+/**
+ * \brief Dynamic filter for side3, same formula as side3_exact_SOS().
+ * \return the sign if certified, ZERO otherwise
+ */
+Sign side3_dynamic_filter(const double* p0, const double w0,
+                          const double* p1, const double w1,
+                          const double* p2, const double w2,
+                          const double* p3, const double w3,
+                          const double* q0, const double* q1,
+                          const double* q2) {
+  ErrDouble L1 = err_sq_dist(p1, p0) + (err_exact(w0) - err_exact(w1));
+  ErrDouble L2 = err_sq_dist(p2, p0) + (err_exact(w0) - err_exact(w2));
+  ErrDouble L3 = err_sq_dist(p3, p0) + (err_exact(w0) - err_exact(w3));
+
+  ErrDouble a10 = 2.0 * err_dot_at(p1, q0, p0);
+  ErrDouble a11 = 2.0 * err_dot_at(p1, q1, p0);
+  ErrDouble a12 = 2.0 * err_dot_at(p1, q2, p0);
+  ErrDouble a20 = 2.0 * err_dot_at(p2, q0, p0);
+  ErrDouble a21 = 2.0 * err_dot_at(p2, q1, p0);
+  ErrDouble a22 = 2.0 * err_dot_at(p2, q2, p0);
+  ErrDouble a30 = 2.0 * err_dot_at(p3, q0, p0);
+  ErrDouble a31 = 2.0 * err_dot_at(p3, q1, p0);
+  ErrDouble a32 = 2.0 * err_dot_at(p3, q2, p0);
+
+  ErrDouble b00 = a11 * a22 - a12 * a21;
+  ErrDouble b01 = a21 - a22;
+  ErrDouble b02 = a12 - a11;
+  ErrDouble b10 = a12 * a20 - a10 * a22;
+  ErrDouble b11 = a22 - a20;
+  ErrDouble b12 = a10 - a12;
+  ErrDouble b20 = a10 * a21 - a11 * a20;
+  ErrDouble b21 = a20 - a21;
+  ErrDouble b22 = a11 - a10;
+
+  ErrDouble Delta = b00 + b10 + b20;
+  Sign Delta_sign = err_sign(Delta);
+  if (Delta_sign == ZERO) return ZERO;
+
+  ErrDouble DeltaLambda0 = b01 * L1 + b02 * L2 + b00;
+  ErrDouble DeltaLambda1 = b11 * L1 + b12 * L2 + b10;
+  ErrDouble DeltaLambda2 = b21 * L1 + b22 * L2 + b20;
+
+  ErrDouble r = Delta * L3 - (a30 * DeltaLambda0 + a31 * DeltaLambda1 +
+                              a32 * DeltaLambda2);
+  return Sign(Delta_sign * err_sign(r));
+}
+
 // ================= side1 =========================================
 
 /**
@@ -138,6 +344,7 @@ GEO::Sign side1_exact_SOS(const double* p0, const double w0, const double* p1,
 
   // Symbolic perturbation, Simulation of Simplicity
   if (r_sign == ZERO) {
+    count_power_side(1, CNT_SOS);
     // logger().debug("p0: ({},{},{},{}), p1 ({},{},{},{}), q0 ({},{},{})",
     //     p0[0], p0[1], p0[2], p0[3],
     //     p1[0], p1[1], p1[2], p1[3],
@@ -209,6 +416,7 @@ GEO::Sign side2_exact_SOS(const double* p0, const double w0, const double* p1,
 
   // Simulation of Simplicity (symbolic perturbation)
   if (r_sign == ZERO) {
+    count_power_side(2, CNT_SOS);
     const double* p_sort[3];
     p_sort[0] = p0;
     p_sort[1] = p1;
@@ -324,6 +532,7 @@ Sign side3_exact_SOS(const double* p0, const double w0, const double* p1,
 
   // Simulation of Simplicity (symbolic perturbation)
   if (r_sign == ZERO) {
+    count_power_side(3, CNT_SOS);
     const double* p_sort[4];
     p_sort[0] = p0;
     p_sort[1] = p1;
@@ -542,12 +751,19 @@ GEO::Sign PCK::power_side1_SOS(const double* p0, const double w0,
                                const double* p1, const double w1,
                                const double* q0) {
   GEO::Sign result;
+  count_power_side(1, CNT_TOTAL);
   result = GEO::Sign(side1_power_3d_filter(p0, w0, p1, w1, q0));
   // logger().debug("sign of side1_power_3d_filter: {}", result);
-  if (result == GEO::ZERO) {
-    result = GEO::Sign(side1_exact_SOS(p0, w0, p1, w1, q0, 3));
+  if (result != GEO::ZERO) {
+    count_power_side(1, CNT_STATIC);
+    return result;
   }
-  return result;
+  result = side1_dynamic_filter(p0, w0, p1, w1, q0);
+  if (result != GEO::ZERO) {
+    count_power_side(1, CNT_DYNAMIC);
+    return result;
+  }
+  return GEO::Sign(side1_exact_SOS(p0, w0, p1, w1, q0, 3));
 }
 
 GEO::Sign PCK::power_side2_SOS(const double* p0, const double w0,
@@ -555,11 +771,18 @@ GEO::Sign PCK::power_side2_SOS(const double* p0, const double w0,
                                const double* p2, const double w2,
                                const double* q0, const double* q1) {
   GEO::Sign result;
+  count_power_side(2, CNT_TOTAL);
   result = GEO::Sign(side2_3d_filter(p0, w0, p1, w1, p2, w2, q0, q1));
-  if (result == GEO::ZERO) {
-    result = GEO::Sign(side2_exact_SOS(p0, w0, p1, w1, p2, w2, q0, q1, 3));
+  if (result != GEO::ZERO) {
+    count_power_side(2, CNT_STATIC);
+    return result;
   }
-  return result;
+  result = side2_dynamic_filter(p0, w0, p1, w1, p2, w2, q0, q1);
+  if (result != GEO::ZERO) {
+    count_power_side(2, CNT_DYNAMIC);
+    return result;
+  }
+  return GEO::Sign(side2_exact_SOS(p0, w0, p1, w1, p2, w2, q0, q1, 3));
 }
 
 GEO::Sign PCK::power_side3_SOS(const double* p0, const double w0,
@@ -569,13 +792,21 @@ GEO::Sign PCK::power_side3_SOS(const double* p0, const double w0,
                                const double* q0, const double* q1,
                                const double* q2) {
   GEO::Sign result;
+  count_power_side(3, CNT_TOTAL);
   result =
       GEO::Sign(side3_3d_filter(p0, w0, p1, w1, p2, w2, p3, w3, q0, q1, q2));
-  if (result == GEO::ZERO) {
-    result = GEO::Sign(
-        side3_exact_SOS(p0, w0, p1, w1, p2, w2, p3, w3, q0, q1, q2, 3));
+  if (result != GEO::ZERO) {
+    count_power_side(3, CNT_STATIC);
+    return result;
   }
-  return result;
+  result =
+      side3_dynamic_filter(p0, w0, p1, w1, p2, w2, p3, w3, q0, q1, q2);
+  if (result != GEO::ZERO) {
+    count_power_side(3, CNT_DYNAMIC);
+    return result;
+  }
+  return GEO::Sign(
+      side3_exact_SOS(p0, w0, p1, w1, p2, w2, p3, w3, q0, q1, q2, 3));
 }
 
 GEO::Sign PCK::power_side4_3d_SOS(const double* p0, const double w0,
@@ -591,6 +822,42 @@ GEO::Sign PCK::power_side4_3d_SOS(const double* p0, const double w0,
   return result;
 }
 
+PCK::PowerSideStats PCK::get_power_side_stats(index_t side) {
+  geo_assert(side >= 1 && side <= 3);
+  PowerSideStats stats;
+#ifdef RPD_STATS
+  std::lock_guard<std::mutex> guard(power_side_counters_lock_);
+  for (PowerSideCounters* counters : power_side_counters_) {
+    stats.nb_total += counters->c[side - 1][CNT_TOTAL].load();
+    stats.nb_static += counters->c[side - 1][CNT_STATIC].load();
+    stats.nb_dynamic += counters->c[side - 1][CNT_DYNAMIC].load();
+    stats.nb_sos += counters->c[side - 1][CNT_SOS].load();
+  }
+#endif  // RPD_STATS
+  return stats;
+}
+
+void PCK::reset_power_side_stats() {
+#ifdef RPD_STATS
+  std::lock_guard<std::mutex> guard(power_side_counters_lock_);
+  for (PowerSideCounters* counters : power_side_counters_) counters->reset();
+#endif  // RPD_STATS
+}
+
+void PCK::show_power_side_stats() {
+  for (index_t side = 1; side <= 3; side++) {
+    PowerSideStats s = get_power_side_stats(side);
+    if (s.nb_total == 0) continue;
+    GEO::uint64 nb_exact = s.nb_total - s.nb_static - s.nb_dynamic;
+    double n = double(s.nb_total);
+    printf("[PCK] power_side%u: %llu calls, static %.2f%%, dynamic %.2f%%, "
+           "exact %.2f%% (SOS %llu)\n",
+           side, (unsigned long long)s.nb_total, 100. * s.nb_static / n,
+           100. * s.nb_dynamic / n, 100. * nb_exact / n,
+           (unsigned long long)s.nb_sos);
+  }
+}
+
 // GEO::Sign PCK::power_side4_SOS(
 //     const double* p0, const double w0,
 //     const double* p1, const double w1,
@@ -162,6 +162,33 @@ GEO::Sign power_side4_3d_SOS(const double* p0, const double w0,
                              const double* p3, const double w3,
                              const double* p4, const double w4);
 
+/**
+ * \brief Number of calls of power_side{1,2,3}_SOS() settled by each stage.
+ * \details Calls not settled by the static nor the dynamic filter
+ *  go to exact arithmetics, nb_sos of them needed symbolic perturbation.
+ */
+struct PowerSideStats {
+  GEO::uint64 nb_total = 0;
+  GEO::uint64 nb_static = 0;
+  GEO::uint64 nb_dynamic = 0;
+  GEO::uint64 nb_sos = 0;
+};
+
+/**
+ * \brief Gets the statistics of power_side1/2/3_SOS(), summed over threads.
+ * \details Counters are compiled in only with -DRPD_STATS, all zero
+ *  otherwise.
+ * \param[in] side one of 1, 2, 3
+ */
+PowerSideStats get_power_side_stats(GEO::index_t side);
+
+void reset_power_side_stats();
+
+/**
+ * \brief Prints filter hit rates of power_side1/2/3_SOS().
+ */
+void show_power_side_stats();
+
 // /**
 //  * \brief Computes the side of a point (given as the intersection
 //  *   between a tetrahedron and three bisectors) relative to
@@ -1,6 +1,12 @@
 #include "medial_sphere.h"
 
+#include <geogram/basic/process.h>
+
+#include <algorithm>
+#include <cmath>
+
 #include "assert.h"
+#include "profiler.h"
 
 /////////////////////////////////////////////////////////////////////////////////////
 // TangentPlane
@@ -167,6 +173,38 @@ double TangentConcaveLine::update_energy_value(const Vector3& theta,
   return energy;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////
+// PowerCell
+/////////////////////////////////////////////////////////////////////////////////////
+void PowerCell::clear() {
+  // cells
+  cell_ids.clear();
+  cell_neighbors.clear();
+  cell_to_surfv2fid.clear();
+  cc_cells.clear();
+  cc_bfids.clear();
+  cc_surf_v2fids.clear();
+  // facets
+  f_id1_to_cells.clear();
+  f_id2_to_cells.clear();
+  cell_to_f_id1s.clear();
+  facet_cc_cells.clear();
+  facet_cc_surf_v2fids.clear();
+  f_id2_is_fixed.clear();
+  // powercell edges
+  e_to_cells.clear();
+  e_is_fixed.clear();
+  edge_cc_cells.clear();
+  edge_2endvertices.clear();
+  // powercell vertices
+  vertex_2id.clear();
+  vertex_2pos.clear();
+  // sharp edges
+  se_covered_lvids.clear();
+  // surface faces
+  surf_v2fid_in_groups.clear();
+}
+
 /////////////////////////////////////////////////////////////////////////////////////
 // MedialSphere
 /////////////////////////////////////////////////////////////////////////////////////
@@ -289,34 +327,13 @@ void MedialSphere::apply_perturb() {
 
 void MedialSphere::pcell_insert(int cell_id) { pcell.cell_ids.insert(cell_id); }
 
-void MedialSphere::topo_clear() {
-  // cells
-  pcell.cell_ids.clear();
-  pcell.cell_neighbors.clear();
-  pcell.cell_to_surfv2fid.clear();
-  pcell.cc_cells.clear();
-  pcell.cc_bfids.clear();
-  pcell.cc_surf_v2fids.clear();
-  // facets
-  pcell.f_id1_to_cells.clear();
-  pcell.f_id2_to_cells.clear();
-  pcell.cell_to_f_id1s.clear();
-  pcell.facet_cc_cells.clear();
-  pcell.facet_cc_surf_v2fids.clear();
-  pcell.f_id2_is_fixed.clear();
-  // powercell edges
-  pcell.e_to_cells.clear();
-  pcell.e_is_fixed.clear();
-  pcell.edge_cc_cells.clear();
-  pcell.edge_2endvertices.clear();
-  // powercell vertices
-  pcell.vertex_2id.clear();
-  pcell.vertex_2pos.clear();
-  // sharp edges
-  pcell.se_covered_lvids.clear();
-  // surface faces
-  pcell.surf_v2fid_in_groups.clear();
+// one sort for all cell ids, instead of one insertion each
+void MedialSphere::pcell_insert(const std::vector<int>& cell_ids) {
+  pcell.cell_ids.insert(cell_ids.begin(), cell_ids.end());
+}
 
+void MedialSphere::topo_clear() {
+  pcell.clear();
   pcell.topo_status = Topo_Status::ok;
   euler = 0;
   euler_sum = 0;
@@ -330,6 +347,10 @@ void MedialSphere::fcc_fixed(int neigh_id) {
   pcell.f_id2_is_fixed[neigh_id] = true;
 }
 
+void MedialSphere::fcc_fixed(const std::vector<int>& neigh_ids) {
+  pcell.f_id2_is_fixed.assign(neigh_ids.begin(), neigh_ids.end(), true);
+}
+
 // for removing medial spheres that are too close
 // using absolute value is not reliable for all models
 // let's use ratio to measure how deep two spheres intersect
@@ -382,18 +403,23 @@ bool MedialSphere::is_on_extf() const {
 /////////////////////////////////////////////////////////////////////////////////////
 // Other Functions
 /////////////////////////////////////////////////////////////////////////////////////
+static void print_duplicate(const MedialSphere& new_sphere,
+                            const MedialSphere& msphere) {
+  printf(
+      "[NewSphereAdd Failed] new_sphere "
+      "(%f,%f,%f,%f) too close to sphere "
+      "%d (%f,%f,%f,%f), not add\n",
+      new_sphere.center[0], new_sphere.center[1], new_sphere.center[2],
+      new_sphere.radius, msphere.id, msphere.center[0], msphere.center[1],
+      msphere.center[2], msphere.radius);
+}
+
 bool validate_new_sphere(const std::vector<MedialSphere>& all_medial_spheres,
                          const MedialSphere& new_sphere) {
   // make sure new_sphere is not duplicated with any sphere
   for (const auto& msphere : all_medial_spheres) {
     if (msphere == new_sphere) {
-      printf(
-          "[NewSphereAdd Failed] new_sphere "
-          "(%f,%f,%f,%f) too close to sphere "
-          "%d (%f,%f,%f,%f), not add\n",
-          new_sphere.center[0], new_sphere.center[1], new_sphere.center[2],
-          new_sphere.radius, msphere.id, msphere.center[0], msphere.center[1],
-          msphere.center[2], msphere.radius);
+      print_duplicate(new_sphere, msphere);
       return false;
     }
   }
@@ -410,32 +436,192 @@ bool add_new_sphere_validate(std::vector<MedialSphere>& all_medial_spheres,
   return true;
 }
 
-// This function will update MedialSphere::id
-void purge_deleted_medial_spheres(
+bool validate_new_sphere(const std::vector<MedialSphere>& all_medial_spheres,
+                         const SphereSpatialHash& sphere_hash,
+                         const MedialSphere& new_sphere) {
+  int dup = sphere_hash.find_duplicate(all_medial_spheres, new_sphere);
+  if (dup == -1) return true;
+  print_duplicate(new_sphere, all_medial_spheres[dup]);
+  return false;
+}
+
+bool add_new_sphere_validate(std::vector<MedialSphere>& all_medial_spheres,
+                             SphereSpatialHash& sphere_hash,
+                             MedialSphere& new_sphere) {
+  if (!validate_new_sphere(all_medial_spheres, sphere_hash, new_sphere))
+    return false;
+  // save to add
+  new_sphere.id = all_medial_spheres.size();
+  printf("[NewSphereAdd Success] new_sphere added %d\n", new_sphere.id);
+  all_medial_spheres.push_back(new_sphere);
+  sphere_hash.insert(new_sphere.id, new_sphere.center);
+  return true;
+}
+
+int add_new_spheres_validate(std::vector<MedialSphere>& all_medial_spheres,
+                             SphereSpatialHash& sphere_hash,
+                             std::vector<MedialSphere>& new_spheres) {
+  PROFILE_ZONE("add new spheres");
+  // against existing spheres, the hash is not modified
+  std::vector<int> dups(new_spheres.size(), -1);
+  GEO::parallel_for(0, new_spheres.size(), [&](GEO::index_t i) {
+    dups[i] = sphere_hash.find_duplicate(all_medial_spheres, new_spheres[i]);
+  });
+  // against previous new spheres, in order, through a hash of the spheres
+  // added by this call only
+  SphereSpatialHash added_hash;
+  int nb_added = 0;
+  for (int i = 0; i < new_spheres.size(); i++) {
+    MedialSphere& new_sphere = new_spheres[i];
+    if (dups[i] == -1)
+      dups[i] = added_hash.find_duplicate(all_medial_spheres, new_sphere);
+    if (dups[i] != -1) {
+      new_sphere.id = -1;
+      continue;
+    }
+    new_sphere.id = all_medial_spheres.size();
+    all_medial_spheres.push_back(new_sphere);
+    sphere_hash.insert(new_sphere.id, new_sphere.center);
+    added_hash.insert(new_sphere.id, new_sphere.center);
+    nb_added++;
+  }
+  printf("[NewSphereAdd] added %d/%ld new spheres\n", nb_added,
+         new_spheres.size());
+  return nb_added;
+}
+
+// old id -> new id, empty if no sphere is deleted
+static std::vector<int> purge_deleted_remap(
     std::vector<MedialSphere>& all_medial_spheres) {
-  std::vector<MedialSphere> purged;
+  std::vector<int> old_to_new(all_medial_spheres.size(), -1);
   int new_id = 0, num_deleted = 0;
-  for (const auto& msphere : all_medial_spheres) {
-    if (msphere.is_deleted) {
+  for (int i = 0; i < all_medial_spheres.size(); i++) {
+    if (all_medial_spheres[i].is_deleted)
       num_deleted++;
-      continue;
-    }
-    purged.push_back(msphere);
-    purged.back().id = new_id++;
+    else
+      old_to_new[i] = new_id++;
   }
 
-  if (num_deleted == 0) return;
-  all_medial_spheres.clear();
-  all_medial_spheres = purged;
+  if (num_deleted == 0) return std::vector<int>();
+  compact_medial_spheres(all_medial_spheres, old_to_new);
   printf("[Purge] purged %d/%ld deleted spheres \n", num_deleted,
          all_medial_spheres.size());
+  return old_to_new;
+}
+
+// This function will update MedialSphere::id
+void purge_deleted_medial_spheres(
+    std::vector<MedialSphere>& all_medial_spheres) {
+  PROFILE_ZONE("purge spheres");
+  purge_deleted_remap(all_medial_spheres);
+}
+
+void purge_deleted_medial_spheres(
+    std::vector<MedialSphere>& all_medial_spheres,
+    SphereSpatialHash& sphere_hash) {
+  PROFILE_ZONE("purge spheres");
+  std::vector<int> old_to_new = purge_deleted_remap(all_medial_spheres);
+  if (!old_to_new.empty()) sphere_hash.remap(old_to_new);
+}
+
+// This function will update MedialSphere::id
+void compact_medial_spheres(std::vector<MedialSphere>& all_medial_spheres,
+                            const std::vector<int>& old_to_new) {
+  assert(old_to_new.size() == all_medial_spheres.size());
+  int nb_kept = 0;
+  for (int i = 0; i < old_to_new.size(); i++) {
+    const int new_id = old_to_new[i];
+    if (new_id < 0) continue;
+    assert(new_id == nb_kept);
+    if (new_id != i)
+      all_medial_spheres[new_id] = std::move(all_medial_spheres[i]);
+    all_medial_spheres[new_id].id = new_id;
+    nb_kept++;
+  }
+  all_medial_spheres.erase(all_medial_spheres.begin() + nb_kept,
+                           all_medial_spheres.end());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// SphereSpatialHash
+/////////////////////////////////////////////////////////////////////////////////////
+std::int64_t SphereSpatialHash::cell_coord(double x) {
+  return std::int64_t(std::floor(x / SCALAR_ZERO_2));
+}
+
+std::uint64_t SphereSpatialHash::cell_key(std::int64_t i, std::int64_t j,
+                                          std::int64_t k) {
+  std::uint64_t h = std::uint64_t(i) * 0x9E3779B97F4A7C15ull;
+  h ^= std::uint64_t(j) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+  h ^= std::uint64_t(k) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+  return h;
+}
+
+void SphereSpatialHash::build(
+    const std::vector<MedialSphere>& all_medial_spheres) {
+  PROFILE_ZONE("SphereSpatialHash build");
+  cells_.clear();
+  cells_.reserve(all_medial_spheres.size());
+  for (int id = 0; id < all_medial_spheres.size(); id++)
+    insert(id, all_medial_spheres[id].center);
+}
+
+void SphereSpatialHash::insert(int id, const Vector3& center) {
+  cells_[cell_key(cell_coord(center[0]), cell_coord(center[1]),
+                  cell_coord(center[2]))]
+      .push_back(id);
+}
+
+void SphereSpatialHash::remove(int id, const Vector3& center) {
+  auto it = cells_.find(cell_key(cell_coord(center[0]), cell_coord(center[1]),
+                                 cell_coord(center[2])));
+  if (it == cells_.end()) return;
+  std::vector<int>& ids = it->second;
+  ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+  if (ids.empty()) cells_.erase(it);
+}
+
+void SphereSpatialHash::remap(const std::vector<int>& old_to_new) {
+  for (auto it = cells_.begin(); it != cells_.end();) {
+    std::vector<int>& ids = it->second;
+    int nb_kept = 0;
+    for (const int id : ids) {
+      if (old_to_new[id] != -1) ids[nb_kept++] = old_to_new[id];
+    }
+    ids.resize(nb_kept);
+    if (ids.empty())
+      it = cells_.erase(it);
+    else
+      ++it;
+  }
+}
+
+int SphereSpatialHash::find_duplicate(
+    const std::vector<MedialSphere>& all_medial_spheres,
+    const MedialSphere& new_sphere) const {
+  const std::int64_t ci = cell_coord(new_sphere.center[0]);
+  const std::int64_t cj = cell_coord(new_sphere.center[1]);
+  const std::int64_t ck = cell_coord(new_sphere.center[2]);
+  // lowest id, as the linear scan of validate_new_sphere()
+  int dup = -1;
+  for (std::int64_t i = ci - 1; i <= ci + 1; i++)
+    for (std::int64_t j = cj - 1; j <= cj + 1; j++)
+      for (std::int64_t k = ck - 1; k <= ck + 1; k++) {
+        auto it = cells_.find(cell_key(i, j, k));
+        if (it == cells_.end()) continue;
+        for (const int id : it->second) {
+          if ((dup == -1 || id < dup) && all_medial_spheres[id] == new_sphere)
+            dup = id;
+        }
+      }
+  return dup;
 }
 
 // check if two medial spheres on the same sharp edge
 bool is_two_mspheres_on_same_se(const MedialSphere& msphere1,
                                 const MedialSphere& msphere2) {
   if (!msphere1.is_on_se() || !msphere2.is_on_se()) return false;
-  std::set<int> s1_se_group, s2_se_group;
+  FlatSet<int> s1_se_group, s2_se_group;
   for (const aint4& se_lvds : msphere1.pcell.se_covered_lvids)
     s1_se_group.insert(se_lvds[3]);
   for (const aint4& se_lvds : msphere2.pcell.se_covered_lvids)
@@ -3,9 +3,12 @@
 
 #include <geogram/mesh/mesh.h>
 
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 #include "common_cxx.h"
+#include "flat_containers.h"
 #include "input_types.h"
 
 // for sphere shrinking
@@ -108,46 +111,54 @@ enum Topo_Status {
 };
 
 // each PowerCell contains multiple ConvexCellTransfer
+//
+// Stored in flat containers (sorted vectors / CSR, see flat_containers.h),
+// filled in bulk and sorted by the first query. clear() keeps all
+// capacities, so a PowerCell reused across iterations does not allocate
+// once warm.
 struct PowerCell {
   PowerCell(){};
 
-  std::set<int> cell_ids;  // matching ConvexCellTransfer::id
+  // drops all topology, keeps capacities
+  void clear();
+
+  FlatSet<int> cell_ids;  // matching ConvexCellTransfer::id
 
   /** For PowerCell Cells **/
   // cell_id -> {neighboring cell ids}
-  std::map<int, std::set<int>> cell_neighbors;
+  FlatMultiMap<int, int> cell_neighbors;
   // original tet fid -> 1 or 2 cell ids
-  std::map<int, std::set<int>> f_id1_to_cells;
+  FlatMultiMap<int, int> f_id1_to_cells;
   // cell id -> orignal tet fids
   // first #sf_mesh.facets.nb()-1 matches GEO::Mesh, later are unique fids
   // from orignal tet
-  std::map<int, std::set<int>> cell_to_f_id1s;
+  FlatMultiMap<int, int> cell_to_f_id1s;
   // pc_face (not surface triangle) centroids on surface mesh in
   // <pc_face_centroid, surf_fid> pair (<Vector3, int>)
   // (fid defines the same as cell_to_f_id1s, but we only care about the sf_mesh
   // fid that matches GEO::Mesh here).
   // cell id -> vector of <pc_face_centroid, surf_fid>
-  std::map<int, std::vector<v2int>> cell_to_surfv2fid;
+  FlatMultiMap<int, v2int, false> cell_to_surfv2fid;
 
-  std::vector<std::set<int>> cc_cells;  // grouped for each CC
-  std::vector<std::set<int>> cc_bfids;  // boundary fids, matching GEO::Mesh or
-                                        // just unique id from original tet mesh
-  std::vector<std::vector<v2int>>
+  FlatGroups<int> cc_cells;  // grouped for each CC
+  FlatGroups<int> cc_bfids;  // boundary fids, matching GEO::Mesh or
+                             // just unique id from original tet mesh
+  FlatGroups<v2int, false>
       cc_surf_v2fids;  // surface vertex2fids, matching GEO::Mesh only
 
   /** For PowerCell Facets **/
   // halfplane seed_neigh_id -> list of cell ids
   // (all cells that clipped by the halfplane)
-  std::map<int, std::set<int>> f_id2_to_cells;
+  FlatMultiMap<int, int> f_id2_to_cells;
   // store seed_neigh_id that needs to add new spheres around
   // neigh_id -> fixed (true) or not fixed (false)
-  std::map<int, bool> f_id2_is_fixed;
+  FlatMap<int, bool> f_id2_is_fixed;
   // neigh_id -> { set of cell_ids in one facet CC }
-  std::map<int, std::vector<std::set<int>>> facet_cc_cells;
+  FlatKeyedGroups<int, int> facet_cc_cells;
   // neigh_id -> { set of v2fids in one facet CC }
   // relates to cell_to_surfv2fid
   // here we only care about the sf_mesh fid that matches GEO::Mesh
-  std::map<int, std::vector<std::vector<v2int>>> facet_cc_surf_v2fids;
+  FlatKeyedGroups<int, v2int, false> facet_cc_surf_v2fids;
 
   /** For PowerCell Edges **/
   // Each edge in powercell cur_id is uniquely defined by 3 halfplanes [cur_id,
@@ -156,12 +167,12 @@ struct PowerCell {
   //
   // [neigh_id_min, neigh_id_max] -> list of cell ids
   // (all cells that clipped by 2 halfplanes)
-  std::map<aint2, std::set<int>> e_to_cells;
+  FlatMultiMap<aint2, int> e_to_cells;
   // store shared edge that needs to add new spheres around
   // [neigh_id_min, neigh_id_max] -> fixed (true) or not fixed (false)
-  std::map<aint2, bool> e_is_fixed;
+  FlatMap<aint2, bool> e_is_fixed;
   // [neigh_id_min, neigh_id_max] -> { set of cell_ids in one edge CC }
-  std::map<aint2, std::vector<std::set<int>>> edge_cc_cells;
+  FlatKeyedGroups<aint2, int> edge_cc_cells;
   // [neigh_id_min, neigh_id_max] -> { set of edge endpoints <pos, sf_fid>}
   // each powercell edge is dual to a medial face of 3 spheres
   //
@@ -174,7 +185,7 @@ struct PowerCell {
   //
   // [neigh_id_min, neigh_id_max] -> [aint2, aint2]
   // aint2 is [cell_id, lvid (from cc_trans.nb_v)]
-  std::map<aint2, std::array<aint2, 2>> edge_2endvertices;
+  FlatMap<aint2, std::array<aint2, 2>> edge_2endvertices;
 
   /** For PowerCell Vertices **/
   // Each vertex in powercell cur_id is uniquely defined by
@@ -188,20 +199,20 @@ struct PowerCell {
   // medial tet
   //
   // [cell_id, lvid (from cc_trans.nb_v)] -> [neigh_id1, neigh_id2, neigh_id3]
-  std::map<aint2, aint3> vertex_2id;
+  FlatMap<aint2, aint3> vertex_2id;
   // [cell_id, lvid (from cc_trans.nb_v)] -> <pos, sf_fid>
   // sf_fid can be -1 if vertex is not on surface
-  std::map<aint2, v2int> vertex_2pos;
+  FlatMap<aint2, v2int> vertex_2pos;
 
   /** For External Edge Features **/
   // all touched sharp edge, stored in [cell_id, lvid1, lvid2,
   // num_se_group]
-  std::set<aint4> se_covered_lvids;
+  FlatSet<aint4> se_covered_lvids;
 
   /** For Internal Features **/
   // grouped sf_mesh <pc_face_centroid, surf_fid> pairs (<Vector3, int>)
   // not crossing sharp edges
-  std::vector<std::vector<v2int>> surf_v2fid_in_groups;
+  FlatGroups<v2int, false> surf_v2fid_in_groups;
 
   Topo_Status topo_status;
 };
@@ -223,7 +234,7 @@ class MedialSphere {
   MedialSphere(int _id, Vector3 _pin, Vector3 _pin_normal,
                SphereType _type = SphereType::T_2);
   MedialSphere(int _id, Vector3 _center, double _radius, SphereType _type);
-  ~MedialSphere(){};
+  // no user destructor, so that spheres are moved (not copied) by purging
 
  public:
   void print_info() const;
@@ -245,7 +256,9 @@ class MedialSphere {
 
   void topo_clear();
   void pcell_insert(int cell_id);
+  void pcell_insert(const std::vector<int>& cell_ids);
   void fcc_fixed(int neigh_id);
+  void fcc_fixed(const std::vector<int>& neigh_ids);
 
   bool operator==(const MedialSphere& m2) const;
   bool operator!=(const MedialSphere& m2) const;
@@ -280,13 +293,76 @@ class MedialSphere {
   int num_se_group = -1;
 };
 
+/**
+ * @brief Hash grid over sphere centers, cells of size SCALAR_ZERO_2 (the
+ * tolerance of MedialSphere::operator==), so a duplicate of a sphere can
+ * only be in the 27 cells around its center.
+ *
+ * Stores sphere ids, must be kept in sync with all_medial_spheres: the
+ * overloads of add_new_sphere_validate() and purge_deleted_medial_spheres()
+ * taking a SphereSpatialHash do it, spheres moved elsewhere must be
+ * removed and inserted again.
+ */
+class SphereSpatialHash {
+ public:
+  void clear() { cells_.clear(); }
+  void build(const std::vector<MedialSphere>& all_medial_spheres);
+  void insert(int id, const Vector3& center);
+  void remove(int id, const Vector3& center);
+  // old id -> new id, -1 if removed
+  void remap(const std::vector<int>& old_to_new);
+
+  /**
+   * @brief Finds a sphere equal to new_sphere (MedialSphere::operator==).
+   * Read only, can be called concurrently.
+   *
+   * @return its id, -1 if none
+   */
+  int find_duplicate(const std::vector<MedialSphere>& all_medial_spheres,
+                     const MedialSphere& new_sphere) const;
+
+ private:
+  static std::uint64_t cell_key(std::int64_t i, std::int64_t j,
+                                std::int64_t k);
+  static std::int64_t cell_coord(double x);
+
+  // hashed cell -> sphere ids, cells with the same hash share a bucket
+  std::unordered_map<std::uint64_t, std::vector<int>> cells_;
+};
+
+bool validate_new_sphere(const std::vector<MedialSphere>& all_medial_spheres,
+                         const MedialSphere& new_sphere);
+bool add_new_sphere_validate(std::vector<MedialSphere>& all_medial_spheres,
+                             MedialSphere& new_sphere);
+
+// O(1) expected duplicate check through sphere_hash, kept in sync
 bool validate_new_sphere(const std::vector<MedialSphere>& all_medial_spheres,
+                         const SphereSpatialHash& sphere_hash,
                          const MedialSphere& new_sphere);
 bool add_new_sphere_validate(std::vector<MedialSphere>& all_medial_spheres,
+                             SphereSpatialHash& sphere_hash,
                              MedialSphere& new_sphere);
 
+/**
+ * @brief Adds new_spheres that are not duplicated with existing spheres
+ * (checked in parallel) nor with a previous sphere of new_spheres.
+ *
+ * @return number of spheres added, new_spheres ids are updated (-1 if not
+ * added)
+ */
+int add_new_spheres_validate(std::vector<MedialSphere>& all_medial_spheres,
+                             SphereSpatialHash& sphere_hash,
+                             std::vector<MedialSphere>& new_spheres);
+
 void purge_deleted_medial_spheres(
     std::vector<MedialSphere>& all_medial_spheres);
+void purge_deleted_medial_spheres(
+    std::vector<MedialSphere>& all_medial_spheres,
+    SphereSpatialHash& sphere_hash);
+
+// keeps sphere i as new id old_to_new[i] (-1: dropped), spheres are moved
+void compact_medial_spheres(std::vector<MedialSphere>& all_medial_spheres,
+                            const std::vector<int>& old_to_new);
 
 bool is_two_mspheres_on_same_se(const MedialSphere& msphere1,
                                 const MedialSphere& msphere2);
@@ -0,0 +1,155 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace profiler {
+
+std::int64_t now_ns() {
+  static const std::chrono::steady_clock::time_point epoch =
+      std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch)
+      .count();
+}
+
+#ifdef RPD_PROFILING
+
+namespace {
+
+struct ZoneEvent {
+  const char* name;
+  std::int64_t id;
+  std::int64_t start_ns;
+  std::int64_t duration_ns;
+};
+
+// Only written by its thread, read by write_chrome_trace()/print_summary()
+// once zones are closed. Owned by the registry, so events of finished
+// threads are kept.
+struct ThreadBuffer {
+  int tid = 0;
+  std::vector<ZoneEvent> events;
+};
+
+std::mutex& registry_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::vector<std::unique_ptr<ThreadBuffer>>& registry() {
+  static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+  return buffers;
+}
+
+ThreadBuffer& thread_buffer() {
+  thread_local ThreadBuffer* buffer = nullptr;
+  if (buffer == nullptr) {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    registry().emplace_back(new ThreadBuffer());
+    buffer = registry().back().get();
+    buffer->tid = int(registry().size()) - 1;
+    buffer->events.reserve(1024);
+  }
+  return *buffer;
+}
+
+}  // namespace
+
+Zone::Zone(const char* name, std::int64_t id)
+    : name_(name), id_(id), start_ns_(now_ns()) {}
+
+Zone::~Zone() {
+  std::int64_t end_ns = now_ns();
+  thread_buffer().events.push_back({name_, id_, start_ns_, end_ns - start_ns_});
+}
+
+bool write_chrome_trace(const std::string& path) {
+  FILE* f = fopen(path.c_str(), "w");
+  if (f == nullptr) {
+    printf("[profiler] cannot open %s\n", path.c_str());
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  size_t nb_events = 0;
+  fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+  for (const auto& buffer : registry()) {
+    for (const ZoneEvent& e : buffer->events) {
+      // timestamps in microseconds, with ns precision
+      fprintf(f,
+              "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, "
+              "\"ts\": %.3f, \"dur\": %.3f",
+              nb_events == 0 ? "" : ",\n", e.name, buffer->tid,
+              e.start_ns * 1e-3, e.duration_ns * 1e-3);
+      if (e.id >= 0) fprintf(f, ", \"args\": {\"id\": %lld}", (long long)e.id);
+      fprintf(f, "}");
+      nb_events++;
+    }
+  }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+  printf("[profiler] saved %zu zones of %zu threads to %s\n", nb_events,
+         registry().size(), path.c_str());
+  return true;
+}
+
+void print_summary() {
+  struct ZoneStats {
+    size_t count = 0;
+    std::int64_t total_ns = 0;
+    std::int64_t max_ns = 0;
+  };
+  // names are literals, but the same literal may have several addresses
+  std::map<std::string, ZoneStats> stats;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    for (const auto& buffer : registry()) {
+      for (const ZoneEvent& e : buffer->events) {
+        ZoneStats& s = stats[e.name];
+        s.count++;
+        s.total_ns += e.duration_ns;
+        s.max_ns = std::max(s.max_ns, e.duration_ns);
+      }
+    }
+  }
+  std::vector<std::pair<std::string, ZoneStats>> sorted(stats.begin(),
+                                                        stats.end());
+  std::sort(sorted.begin(), sorted.end(),
+            [](const std::pair<std::string, ZoneStats>& a,
+               const std::pair<std::string, ZoneStats>& b) {
+              return a.second.total_ns > b.second.total_ns;
+            });
+  printf("[profiler] %-32s %10s %12s %12s\n", "zone (summed over threads)",
+         "count", "total (ms)", "max (ms)");
+  for (const auto& it : sorted) {
+    printf("[profiler] %-32s %10zu %12.3f %12.3f\n", it.first.c_str(),
+           it.second.count, it.second.total_ns * 1e-6,
+           it.second.max_ns * 1e-6);
+  }
+}
+
+void clear() {
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  for (const auto& buffer : registry()) buffer->events.clear();
+}
+
+#else
+
+bool write_chrome_trace(const std::string& path) {
+  printf("[profiler] %s not written, build with RPD_PROFILING\n",
+         path.c_str());
+  return false;
+}
+
+void print_summary() {}
+
+void clear() {}
+
+#endif  // RPD_PROFILING
+
+}  // namespace profiler
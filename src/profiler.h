@@ -0,0 +1,84 @@
+#ifndef H_PROFILER_H
+#define H_PROFILER_H
+
+// Scoped profiling zones, enabled with -DRPD_PROFILING (cmake option
+// RPD_PROFILING). When disabled, PROFILE_ZONE* expand to nothing and
+// the functions below are no-ops, so zones can stay in hot loops.
+//
+//   void foo() {
+//     PROFILE_ZONE("foo");
+//     for (int i = 0; i < n; i++) {
+//       PROFILE_ZONE_ID("foo item", i);
+//       ...
+//     }
+//   }
+//   profiler::write_chrome_trace("trace.json");  // chrome://tracing, Perfetto
+//
+// Zone names must be string literals (only the pointer is stored).
+
+#include <cstdint>
+#include <string>
+
+namespace profiler {
+
+#ifdef RPD_PROFILING
+
+/**
+ * @brief Records [construction, destruction) of a zone in the buffer of
+ * the calling thread. Nested zones are nested in time.
+ */
+class Zone {
+ public:
+  explicit Zone(const char* name, std::int64_t id = -1);
+  ~Zone();
+
+  Zone(const Zone&) = delete;
+  Zone& operator=(const Zone&) = delete;
+
+ private:
+  const char* name_;
+  std::int64_t id_;
+  std::int64_t start_ns_;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) \
+  profiler::Zone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_ZONE_ID(name, id) \
+  profiler::Zone PROFILE_CONCAT(profile_zone_, __LINE__)(name, id)
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_ZONE_ID(name, id)
+
+#endif  // RPD_PROFILING
+
+/**
+ * @brief Nanoseconds on a monotonic clock, since the first call.
+ */
+std::int64_t now_ns();
+
+/**
+ * @brief Writes all recorded zones of all threads as Chrome trace events
+ * ("ph": "X"), loadable in chrome://tracing and ui.perfetto.dev.
+ *
+ * @return false if profiling is disabled or the file cannot be written
+ */
+bool write_chrome_trace(const std::string& path);
+
+/**
+ * @brief Prints count, total and max time of each zone name, summed over
+ * all threads.
+ */
+void print_summary();
+
+/**
+ * @brief Drops all recorded zones. Must not run concurrently with zones.
+ */
+void clear();
+
+}  // namespace profiler
+
+#endif  // H_PROFILER_H
@@ -0,0 +1,523 @@
+#include <geogram/basic/command_line.h>
+#include <geogram/basic/command_line_args.h>
+#include <geogram/basic/process.h>
+#include <geogram/mesh/mesh.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "matfp/geogram/RPD.h"
+#include "matfp/geogram/RPD_mesh_builder.h"
+#include "matfp/geogram/generic_RPD_polygon.h"
+#include "matfp/geogram/predicates.h"
+#include "medial_sphere.h"
+#include "params.h"
+#include "triangulation.h"
+
+// Micro-benchmarks of RPD kernels on a synthetic sphere/surface pair:
+// an icosphere and random spheres inside it, generated from a fixed seed.
+
+// heap allocations of the whole process. With glibc, malloc and the
+// aligned allocators are interposed, which also counts operator new and
+// geogram's aligned allocations (GEO::vector, GEO::Memory::aligned_malloc);
+// otherwise only operator new is counted.
+static std::atomic<std::uint64_t> g_nb_allocs(0);
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t nb, std::size_t size);
+void* __libc_realloc(void* p, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+
+void* malloc(std::size_t size) {
+  g_nb_allocs.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+void* calloc(std::size_t nb, std::size_t size) {
+  g_nb_allocs.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(nb, size);
+}
+void* realloc(void* p, std::size_t size) {
+  g_nb_allocs.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(p, size);
+}
+void* memalign(std::size_t alignment, std::size_t size) {
+  g_nb_allocs.fetch_add(1, std::memory_order_relaxed);
+  return __libc_memalign(alignment, size);
+}
+void* aligned_alloc(std::size_t alignment, std::size_t size) {
+  return memalign(alignment, size);
+}
+int posix_memalign(void** p, std::size_t alignment, std::size_t size) {
+  *p = memalign(alignment, size);
+  return (*p == nullptr && size != 0) ? ENOMEM : 0;
+}
+}
+#else
+void* operator new(std::size_t size) {
+  g_nb_allocs.fetch_add(1, std::memory_order_relaxed);
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](std::size_t size) { return ::operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+#endif
+
+namespace {
+
+struct BenchConfig {
+  int nb_spheres = 2000;
+  int subdiv = 5;  // icosphere level, 20 * 4^subdiv facets
+  int reps = 10;
+  int rpd_reps = 3;
+  unsigned seed = RAN_SEED;
+  std::string filter;
+  std::string json_path;
+};
+
+struct BenchResult {
+  std::string name;
+  size_t nb_ops = 0;  // per repetition
+  int reps = 0;
+  double ns_per_op_mean = 0.;
+  double ns_per_op_stddev = 0.;
+  double ns_per_op_min = 0.;
+  double ops_per_sec = 0.;
+  double allocs_per_rep = 0.;  // heap allocations, 0 in steady state
+};
+
+// keeps benchmarked results alive
+volatile double g_sink = 0.;
+
+/**
+ * @brief Runs run_once() once for warm-up then reps times, each run doing
+ * nb_ops operations, and computes ns/op statistics over repetitions.
+ *
+ * @param setup called before each run, not timed (may be empty)
+ */
+BenchResult run_bench(const std::string& name, size_t nb_ops, int reps,
+                      const std::function<void()>& setup,
+                      const std::function<void()>& run_once) {
+  BenchResult result;
+  result.name = name;
+  result.nb_ops = nb_ops;
+  result.reps = reps;
+  if (nb_ops == 0 || reps <= 0) return result;
+
+  if (setup) setup();
+  run_once();  // warm-up
+  std::vector<double> ns_per_op(reps);
+  std::uint64_t nb_allocs = 0;
+  for (int r = 0; r < reps; r++) {
+    if (setup) setup();
+    std::uint64_t allocs_start = g_nb_allocs.load();
+    auto start = std::chrono::steady_clock::now();
+    run_once();
+    auto end = std::chrono::steady_clock::now();
+    nb_allocs += g_nb_allocs.load() - allocs_start;
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    ns_per_op[r] = ns / double(nb_ops);
+  }
+  result.allocs_per_rep = double(nb_allocs) / reps;
+  double sum = 0., sum2 = 0.;
+  for (double x : ns_per_op) sum += x;
+  result.ns_per_op_mean = sum / reps;
+  for (double x : ns_per_op)
+    sum2 += (x - result.ns_per_op_mean) * (x - result.ns_per_op_mean);
+  result.ns_per_op_stddev = reps > 1 ? std::sqrt(sum2 / (reps - 1)) : 0.;
+  result.ns_per_op_min = *std::min_element(ns_per_op.begin(), ns_per_op.end());
+  result.ops_per_sec = 1e9 / result.ns_per_op_mean;
+  printf("[bench] %-28s %10.1f ns/op (+- %.1f, min %.1f) %12.0f op/s "
+         "%10.1f allocs/rep\n",
+         name.c_str(), result.ns_per_op_mean, result.ns_per_op_stddev,
+         result.ns_per_op_min, result.ops_per_sec, result.allocs_per_rep);
+  return result;
+}
+
+/**
+ * @brief Icosphere of given subdivision level, radius and center.
+ */
+void make_icosphere(int subdiv, double radius, const Vector3& center,
+                    GEO::Mesh& mesh) {
+  const double t = (1. + std::sqrt(5.)) / 2.;
+  std::vector<Vector3> pts = {
+      Vector3(-1, t, 0), Vector3(1, t, 0),   Vector3(-1, -t, 0),
+      Vector3(1, -t, 0), Vector3(0, -1, t),  Vector3(0, 1, t),
+      Vector3(0, -1, -t), Vector3(0, 1, -t), Vector3(t, 0, -1),
+      Vector3(t, 0, 1),  Vector3(-t, 0, -1), Vector3(-t, 0, 1)};
+  std::vector<aint3> tris = {
+      {{0, 11, 5}}, {{0, 5, 1}},  {{0, 1, 7}},   {{0, 7, 10}}, {{0, 10, 11}},
+      {{1, 5, 9}},  {{5, 11, 4}}, {{11, 10, 2}}, {{10, 7, 6}}, {{7, 1, 8}},
+      {{3, 9, 4}},  {{3, 4, 2}},  {{3, 2, 6}},   {{3, 6, 8}},  {{3, 8, 9}},
+      {{4, 9, 5}},  {{2, 4, 11}}, {{6, 2, 10}},  {{8, 6, 7}},  {{9, 8, 1}}};
+  for (Vector3& p : pts) p = normalize(p);
+
+  for (int level = 0; level < subdiv; level++) {
+    std::map<std::pair<int, int>, int> midpoints;
+    auto midpoint = [&](int a, int b) {
+      std::pair<int, int> key(std::min(a, b), std::max(a, b));
+      auto it = midpoints.find(key);
+      if (it != midpoints.end()) return it->second;
+      pts.push_back(normalize(pts[a] + pts[b]));
+      midpoints[key] = int(pts.size()) - 1;
+      return int(pts.size()) - 1;
+    };
+    std::vector<aint3> new_tris;
+    new_tris.reserve(4 * tris.size());
+    for (const aint3& t3 : tris) {
+      int a = midpoint(t3[0], t3[1]);
+      int b = midpoint(t3[1], t3[2]);
+      int c = midpoint(t3[2], t3[0]);
+      new_tris.push_back({{t3[0], a, c}});
+      new_tris.push_back({{t3[1], b, a}});
+      new_tris.push_back({{t3[2], c, b}});
+      new_tris.push_back({{a, b, c}});
+    }
+    tris.swap(new_tris);
+  }
+
+  mesh.clear();
+  mesh.vertices.set_dimension(3);
+  mesh.vertices.create_vertices(pts.size());
+  for (GEO::index_t v = 0; v < pts.size(); v++)
+    mesh.vertices.point(v) = center + radius * pts[v];
+  for (const aint3& t3 : tris) mesh.facets.create_triangle(t3[0], t3[1], t3[2]);
+  mesh.facets.connect();
+}
+
+/**
+ * @brief Random spheres strictly inside the icosphere, centers within 0.8
+ * radius, each sphere radius 50% to 100% of its distance to the surface.
+ */
+void make_spheres(int nb_spheres, double radius, const Vector3& center,
+                  std::mt19937& rng, std::vector<MedialSphere>& spheres) {
+  std::uniform_real_distribution<double> u11(-1., 1.);
+  std::uniform_real_distribution<double> u_ratio(0.5, 1.);
+  spheres.clear();
+  spheres.reserve(nb_spheres);
+  while ((int)spheres.size() < nb_spheres) {
+    Vector3 d(u11(rng), u11(rng), u11(rng));
+    if (length(d) > 0.8) continue;
+    double r = (1. - length(d)) * radius * u_ratio(rng);
+    spheres.emplace_back(spheres.size(), center + radius * d, r,
+                         SphereType::T_2);
+  }
+}
+
+void set_bbox_params(double radius, const Vector3& center, Parameter& params) {
+  double h = 1.2 * radius;
+  params.bb_points.clear();
+  for (int i = 0; i < 8; i++) {
+    params.bb_points.push_back(center[0] + ((i & 1) ? h : -h));
+    params.bb_points.push_back(center[1] + ((i & 2) ? h : -h));
+    params.bb_points.push_back(center[2] + ((i & 4) ? h : -h));
+  }
+  params.bbox_diag_l = 2. * h * std::sqrt(3.);
+}
+
+bool json_write(const BenchConfig& config, const GEO::Mesh& sf_mesh,
+                int nb_rt_spheres, const std::vector<BenchResult>& results) {
+  FILE* f = fopen(config.json_path.c_str(), "w");
+  if (f == nullptr) {
+    printf("[bench] cannot open %s\n", config.json_path.c_str());
+    return false;
+  }
+  fprintf(f, "{\n  \"config\": {\n");
+  fprintf(f, "    \"nb_spheres\": %d,\n", config.nb_spheres);
+  fprintf(f, "    \"nb_rt_spheres\": %d,\n", nb_rt_spheres);
+  fprintf(f, "    \"nb_facets\": %u,\n", sf_mesh.facets.nb());
+  fprintf(f, "    \"seed\": %u,\n", config.seed);
+  fprintf(f, "    \"reps\": %d,\n", config.reps);
+  fprintf(f, "    \"nb_threads\": %u\n",
+          GEO::Process::maximum_concurrent_threads());
+  fprintf(f, "  },\n  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult& r = results[i];
+    fprintf(f,
+            "    {\"name\": \"%s\", \"ops\": %zu, \"reps\": %d, "
+            "\"ns_per_op\": %.3f, \"ns_per_op_stddev\": %.3f, "
+            "\"ns_per_op_variance\": %.3f, \"ns_per_op_min\": %.3f, "
+            "\"ops_per_sec\": %.1f, \"allocs_per_rep\": %.1f}%s\n",
+            r.name.c_str(), r.nb_ops, r.reps, r.ns_per_op_mean,
+            r.ns_per_op_stddev, r.ns_per_op_stddev * r.ns_per_op_stddev,
+            r.ns_per_op_min, r.ops_per_sec, r.allocs_per_rep,
+            i + 1 < results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  fclose(f);
+  printf("[bench] saved %s\n", config.json_path.c_str());
+  return true;
+}
+
+void print_usage(const char* exe) {
+  printf("Usage: %s [options] [name filter]\n", exe);
+  printf("  -n <int>   number of spheres (default 2000)\n");
+  printf("  -s <int>   icosphere subdivision level (default 5)\n");
+  printf("  -r <int>   repetitions per kernel (default 10)\n");
+  printf("  -R <int>   repetitions of compute_RPD (default 3)\n");
+  printf("  -seed <n>  random seed (default %d)\n", RAN_SEED);
+  printf("  -json <f>  save results as JSON\n");
+}
+
+bool parse_args(int argc, char** argv, BenchConfig& config) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = (i + 1 < argc);
+    if (arg == "-h" || arg == "--help") {
+      return false;
+    } else if (arg == "-n" && has_value) {
+      config.nb_spheres = std::atoi(argv[++i]);
+    } else if (arg == "-s" && has_value) {
+      config.subdiv = std::atoi(argv[++i]);
+    } else if (arg == "-r" && has_value) {
+      config.reps = std::atoi(argv[++i]);
+    } else if (arg == "-R" && has_value) {
+      config.rpd_reps = std::atoi(argv[++i]);
+    } else if (arg == "-seed" && has_value) {
+      config.seed = unsigned(std::atoi(argv[++i]));
+    } else if (arg == "-json" && has_value) {
+      config.json_path = argv[++i];
+    } else if (arg[0] != '-') {
+      config.filter = arg;
+    } else {
+      printf("unknown option %s\n", arg.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  BenchConfig config;
+  if (!parse_args(argc, argv, config)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  GEO::initialize();
+  GEO::CmdLine::import_arg_group("algo");
+
+  // synthetic input, scaled in [0,1000]^3 as our models
+  const double radius = 450.;
+  const Vector3 center(500., 500., 500.);
+  std::mt19937 rng(config.seed);
+  GEO::Mesh sf_mesh;
+  make_icosphere(config.subdiv, radius, center, sf_mesh);
+  std::vector<MedialSphere> all_medial_spheres;
+  make_spheres(config.nb_spheres, radius, center, rng, all_medial_spheres);
+  Parameter params;
+  set_bbox_params(radius, center, params);
+
+  RegularTriangulationNN_var rt = new RegularTriangulationNN();
+  generate_RT_CGAL_and_purge_spheres(params, all_medial_spheres, *rt);
+  if (!rt->has_seed_cache()) rt->build_seed_cache();
+  if (!rt->has_neighbor_csr()) rt->build_neighbor_csr();
+  if (!rt->has_seed_locator()) rt->build_seed_locator();
+  const int nb_tags = rt->get_nb_vertices();
+  printf("[bench] %u facets, %zu spheres in RT, %d tags\n",
+         sf_mesh.facets.nb(), all_medial_spheres.size(), nb_tags);
+
+  // (seed, neighbor, facet) triples sampled once, shared by kernels
+  struct Sample {
+    Vertex_handle_rt seed;
+    GEO::index_t facet;
+  };
+  std::vector<Sample> samples;
+  std::uniform_int_distribution<GEO::index_t> rand_facet(
+      0, sf_mesh.facets.nb() - 1);
+  for (int s = 0; s < 1000; s++) {
+    GEO::index_t f = rand_facet(rng);
+    const double* p = sf_mesh.vertices.point_ptr(sf_mesh.facets.vertex(f, 0));
+    Vertex_handle_rt vh = rt->locate_seed(p, Vertex_handle_rt());
+    if (rt->get_neighbors(vh->info().tag).size() < 3) continue;
+    samples.push_back(Sample{vh, f});
+  }
+
+  std::vector<BenchResult> results;
+  auto wanted = [&config](const char* name) {
+    return config.filter.empty() ||
+           std::string(name).find(config.filter) != std::string::npos;
+  };
+
+  ///////////////
+  // Predicates, bisectors between a seed and its first RT neighbors
+  // against the facet vertices
+  size_t nb_pred_ops = 0;
+  for (const Sample& s : samples)
+    nb_pred_ops += std::min<GEO::index_t>(
+        rt->get_neighbors(s.seed->info().tag).size(), 8);
+  auto for_each_pred = [&](const std::function<void(
+                               const double*, const double*, const double*,
+                               const double*, const double*, const double*,
+                               const double*)>& f) {
+    for (const Sample& s : samples) {
+      GEO::index_t t = s.seed->info().tag;
+      RTNeighborRange nbrs = rt->get_neighbors(t);
+      GEO::index_t n = std::min<GEO::index_t>(nbrs.size(), 8);
+      const double* q0 =
+          sf_mesh.vertices.point_ptr(sf_mesh.facets.vertex(s.facet, 0));
+      const double* q1 =
+          sf_mesh.vertices.point_ptr(sf_mesh.facets.vertex(s.facet, 1));
+      const double* q2 =
+          sf_mesh.vertices.point_ptr(sf_mesh.facets.vertex(s.facet, 2));
+      for (GEO::index_t k = 0; k < n; k++) {
+        f(rt->seed_point(t), rt->seed_point(nbrs[k]->info().tag),
+          rt->seed_point(nbrs[(k + 1) % nbrs.size()]->info().tag),
+          rt->seed_point(nbrs[(k + 2) % nbrs.size()]->info().tag), q0, q1,
+          q2);
+      }
+    }
+  };
+  if (wanted("power_side1_SOS")) {
+    results.push_back(run_bench(
+        "power_side1_SOS", nb_pred_ops, config.reps, nullptr, [&]() {
+          int sum = 0;
+          for_each_pred([&](const double* p0, const double* p1, const double*,
+                            const double*, const double* q0, const double*,
+                            const double*) {
+            sum += matfp::PCK::power_side1_SOS(p0, p0[3], p1, p1[3], q0);
+          });
+          g_sink = g_sink + sum;
+        }));
+  }
+  if (wanted("power_side2_SOS")) {
+    results.push_back(run_bench(
+        "power_side2_SOS", nb_pred_ops, config.reps, nullptr, [&]() {
+          int sum = 0;
+          for_each_pred([&](const double* p0, const double* p1,
+                            const double* p2, const double*, const double* q0,
+                            const double* q1, const double*) {
+            sum += matfp::PCK::power_side2_SOS(p0, p0[3], p1, p1[3], p2,
+                                               p2[3], q0, q1);
+          });
+          g_sink = g_sink + sum;
+        }));
+  }
+  if (wanted("power_side3_SOS")) {
+    results.push_back(run_bench(
+        "power_side3_SOS", nb_pred_ops, config.reps, nullptr, [&]() {
+          int sum = 0;
+          for_each_pred([&](const double* p0, const double* p1,
+                            const double* p2, const double* p3,
+                            const double* q0, const double* q1,
+                            const double* q2) {
+            sum += matfp::PCK::power_side3_SOS(p0, p0[3], p1, p1[3], p2,
+                                               p2[3], p3, p3[3], q0, q1, q2);
+          });
+          g_sink = g_sink + sum;
+        }));
+  }
+
+  ///////////////
+  // Clipping a facet by each bisector of its seed,
+  // clipped vertices are kept for the vertex map kernel
+  GEO::Attribute<double> no_weight;
+  matfp::RPDPointArena intersections(3);
+  matfp::PolygonCGAL F, target;
+  std::vector<std::pair<GEO::index_t, matfp::SymbolicVertex>> sym_vertices;
+  size_t nb_clips = 0;
+  for (const Sample& s : samples)
+    nb_clips += rt->get_neighbors(s.seed->info().tag).size();
+  auto clip_all = [&](bool keep_sym, matfp::RPDPrecision precision) {
+    for (const Sample& s : samples) {
+      Vertex_handle_rt i = s.seed;
+      F.initialize_from_mesh_facet(&sf_mesh, s.facet, true, no_weight);
+      for (Vertex_handle_rt& j : rt->get_neighbors(i->info().tag)) {
+        F.clip_by_plane<3>(target, intersections, &sf_mesh, rt.get(), i, j,
+                           precision, true);
+        if (!keep_sym) continue;
+        for (GEO::index_t k = 0; k < target.nb_vertices(); k++)
+          sym_vertices.emplace_back(i->info().tag, target.vertex(k).sym());
+      }
+    }
+  };
+  const std::pair<const char*, matfp::RPDPrecision> clip_benches[] = {
+      {"clip_by_plane_exact", matfp::RPD_EXACT},
+      {"clip_by_plane_filtered", matfp::RPD_FILTERED},
+      {"clip_by_plane_fast", matfp::RPD_FAST}};
+  for (const auto& bench : clip_benches) {
+    if (!wanted(bench.first)) continue;
+    results.push_back(run_bench(
+        bench.first, nb_clips, config.reps, [&]() { intersections.clear(); },
+        [&]() {
+          clip_all(false, bench.second);
+          g_sink = g_sink + target.nb_vertices();
+        }));
+  }
+
+  ///////////////
+  if (wanted("find_or_create_vertex")) {
+    clip_all(true, matfp::RPD_EXACT);
+    intersections.clear();
+    results.push_back(run_bench(
+        "find_or_create_vertex", sym_vertices.size(), config.reps, nullptr,
+        [&]() {
+          matfp::RPDVertexMap vertex_map;
+          vertex_map.reserve(samples.size());
+          GEO::index_t sum = 0;
+          for (const auto& sv : sym_vertices)
+            sum += vertex_map.find_or_create_vertex(sv.first, sv.second);
+          g_sink = g_sink + sum;
+        }));
+  }
+
+  ///////////////
+  if (wanted("get_neighbors")) {
+    results.push_back(run_bench(
+        "get_neighbors", nb_tags, config.reps, nullptr, [&]() {
+          GEO::index_t sum = 0;
+          for (int t = 0; t < nb_tags; t++) {
+            if (!rt->is_in_rt(t)) continue;
+            for (Vertex_handle_rt& n : rt->get_neighbors(t))
+              sum += n->info().tag;
+          }
+          g_sink = g_sink + sum;
+        }));
+  }
+
+  ///////////////
+  if (wanted("compute_RPD")) {
+    matfp::RestrictedPowerDiagram_var rpd =
+        matfp::RestrictedPowerDiagram::create(rt.get(), &sf_mesh);
+    GEO::Mesh rpd_mesh;
+    std::map<GEO::index_t, std::set<GEO::index_t>> rpd_seed_adj;
+    std::map<GEO::index_t, std::set<GEO::index_t>> rpd_vs_bisectors;
+    results.push_back(run_bench(
+        "compute_RPD", 1, config.rpd_reps,
+        [&]() {
+          rpd_mesh.clear();
+          rpd_seed_adj.clear();
+          rpd_vs_bisectors.clear();
+        },
+        [&]() {
+          rpd->compute_RPD(rpd_mesh, &rpd_seed_adj, &rpd_vs_bisectors);
+          g_sink = g_sink + rpd_mesh.facets.nb();
+        }));
+  }
+
+  if (!config.json_path.empty() &&
+      !json_write(config, sf_mesh, all_medial_spheres.size(), results))
+    return 1;
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include "shrinking.h"
+
+#include <geogram/basic/process.h>
+
+#include <cmath>
+
+#include "profiler.h"
+
+namespace {
+
+enum BallStatus : char { ACTIVE = 0, CONVERGED = 1, DROPPED = 2 };
+
+// per ball shrinking state, one entry per pin
+struct Balls {
+  std::vector<Vector3> centers;
+  std::vector<double> radii;
+  std::vector<Vector3> qs;
+  std::vector<int> q_fids;
+  std::vector<int> nb_iters;
+  std::vector<BallStatus> status;
+
+  void init(const std::vector<Vector3>& pins,
+            const std::vector<Vector3>& pin_normals) {
+    size_t nb = pins.size();
+    centers.resize(nb);
+    radii.assign(nb, INIT_RADIUS);
+    qs.resize(nb);
+    q_fids.assign(nb, -1);
+    nb_iters.assign(nb, 0);
+    status.assign(nb, ACTIVE);
+    for (size_t i = 0; i < nb; i++)
+      centers[i] = pins[i] - pin_normals[i] * radii[i];
+  }
+};
+
+}  // namespace
+
+void get_facet_pins(const GEO::Mesh& sf_mesh, std::vector<Vector3>& pins,
+                    std::vector<Vector3>& pin_normals,
+                    std::vector<int>& pin_fids) {
+  GEO::index_t nb = sf_mesh.facets.nb();
+  pins.resize(nb);
+  pin_normals.resize(nb);
+  pin_fids.resize(nb);
+  GEO::parallel_for(0, nb, [&](GEO::index_t f) {
+    pins[f] = get_mesh_facet_centroid(sf_mesh, f);
+    pin_normals[f] = get_mesh_facet_normal(sf_mesh, f);
+    pin_fids[f] = f;
+  });
+}
+
+int shrink_spheres(const GEO::Mesh& sf_mesh, const AABBWrapper& aabb_wrapper,
+                   const std::vector<Vector3>& pins,
+                   const std::vector<Vector3>& pin_normals,
+                   const std::vector<int>& pin_fids,
+                   std::vector<MedialSphere>& all_medial_spheres,
+                   SphereSpatialHash& sphere_hash,
+                   const ShrinkingParams& shrink_params) {
+  PROFILE_ZONE("shrink spheres");
+  assert(pins.size() == pin_normals.size() && pins.size() == pin_fids.size());
+  const double eps = shrink_params.eps_radius;
+  Balls balls;
+  balls.init(pins, pin_normals);
+
+  std::vector<GEO::index_t> active(pins.size());
+  for (GEO::index_t i = 0; i < active.size(); i++) active[i] = i;
+  std::vector<Vector3> centers, nearest_ps;
+  std::vector<int> nearest_fids;
+  std::vector<double> sq_dists;
+  int nb_rounds = 0;
+  while (!active.empty()) {
+    nb_rounds++;
+    size_t nb = active.size();
+    centers.resize(nb);
+    nearest_ps.resize(nb);
+    nearest_fids.resize(nb);
+    sq_dists.resize(nb);
+    for (size_t k = 0; k < nb; k++) centers[k] = balls.centers[active[k]];
+    aabb_wrapper.get_nearest_points_on_sf(centers.data(), nb,
+                                          nearest_ps.data(),
+                                          nearest_fids.data(), sq_dists.data());
+
+    GEO::parallel_for(0, GEO::index_t(nb), [&](GEO::index_t k) {
+      GEO::index_t i = active[k];
+      double& radius = balls.radii[i];
+      // no surface point inside the ball: tangent to the last q, if any
+      if (std::sqrt(sq_dists[k]) >= radius - eps) {
+        balls.status[i] = balls.q_fids[i] == -1 ? DROPPED : CONVERGED;
+        return;
+      }
+      // ball through p and q, tangent at p
+      const Vector3& p = pins[i];
+      const Vector3& n = pin_normals[i];
+      Vector3 pq = p - nearest_ps[k];
+      double denom = 2. * GEO::dot(n, pq);
+      if (denom <= 0.) {
+        balls.status[i] = DROPPED;
+        return;
+      }
+      double new_radius = GEO::length2(pq) / denom;
+      bool is_converged = radius - new_radius < eps;
+      radius = new_radius;
+      balls.centers[i] = p - n * radius;
+      balls.qs[i] = nearest_ps[k];
+      balls.q_fids[i] = nearest_fids[k];
+      if (is_converged)
+        balls.status[i] = CONVERGED;
+      else if (++balls.nb_iters[i] >= shrink_params.max_iter)
+        balls.status[i] = DROPPED;
+    });
+
+    // early termination: converged balls leave the batch
+    size_t nb_active = 0;
+    for (size_t k = 0; k < nb; k++)
+      if (balls.status[active[k]] == ACTIVE) active[nb_active++] = active[k];
+    active.resize(nb_active);
+  }
+
+  std::vector<MedialSphere> new_spheres;
+  for (size_t i = 0; i < pins.size(); i++) {
+    if (balls.status[i] != CONVERGED) continue;
+    new_spheres.emplace_back(-1, pins[i], pin_normals[i], SphereType::T_2);
+    MedialSphere& msphere = new_spheres.back();
+    msphere.center = balls.centers[i];
+    msphere.radius = balls.radii[i];
+    msphere.ss.p_fid = pin_fids[i];
+    msphere.ss.q = balls.qs[i];
+    msphere.ss.q_fid = balls.q_fids[i];
+    msphere.ss.q_normal = get_mesh_facet_normal(sf_mesh, balls.q_fids[i]);
+    msphere.update_tan_planes_from_ss_params();
+  }
+  printf("[Shrinking] %zu balls, %zu converged, %d rounds\n", pins.size(),
+         new_spheres.size(), nb_rounds);
+  return add_new_spheres_validate(all_medial_spheres, sphere_hash,
+                                  new_spheres);
+}
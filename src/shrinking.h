@@ -0,0 +1,49 @@
+#ifndef H_SHRINKING_H
+#define H_SHRINKING_H
+
+#include <geogram/mesh/mesh.h>
+
+#include <vector>
+
+#include "input_types.h"
+#include "medial_sphere.h"
+
+// Shrinking ball: a ball tangent to the surface at pin p with normal n is
+// shrunk from INIT_RADIUS until it contains no surface point, which makes
+// it tangent to a second point q (see ss_params), i.e. a medial sphere.
+struct ShrinkingParams {
+  int max_iter = 50;
+  // converged once the radius changes less than this, in [0,scale_max]^3
+  double eps_radius = SCALAR_ZERO_4;
+};
+
+/**
+ * @brief Pins on all surface facets: centroids and facet normals.
+ */
+void get_facet_pins(const GEO::Mesh& sf_mesh, std::vector<Vector3>& pins,
+                    std::vector<Vector3>& pin_normals,
+                    std::vector<int>& pin_fids);
+
+/**
+ * @brief Shrinks one ball per pin, all balls in parallel. Each iteration
+ * queries the nearest surface points of all balls not converged yet in one
+ * batch (AABBWrapper::get_nearest_points_on_sf).
+ *
+ * Converged balls become T_2 spheres with tangent planes from their
+ * ss_params, added to all_medial_spheres unless duplicated (see
+ * add_new_spheres_validate). Balls that never shrink (open side of the
+ * surface) or do not converge in max_iter are dropped.
+ *
+ * @param pin_normals outward normals, normalized
+ * @param pin_fids matching GEO::Mesh facets
+ * @return number of spheres added
+ */
+int shrink_spheres(const GEO::Mesh& sf_mesh, const AABBWrapper& aabb_wrapper,
+                   const std::vector<Vector3>& pins,
+                   const std::vector<Vector3>& pin_normals,
+                   const std::vector<int>& pin_fids,
+                   std::vector<MedialSphere>& all_medial_spheres,
+                   SphereSpatialHash& sphere_hash,
+                   const ShrinkingParams& shrink_params = ShrinkingParams());
+
+#endif  // H_SHRINKING_H
@@ -0,0 +1,201 @@
+#include "sphere_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "profiler.h"
+
+SphereFileView::~SphereFileView() { close(); }
+
+void SphereFileView::close() {
+  if (data_ != nullptr) munmap(data_, size_);
+  data_ = nullptr;
+  size_ = 0;
+  records_ = nullptr;
+  stride_ = 0;
+  nb_spheres_ = 0;
+  flags_ = 0;
+}
+
+bool SphereFileView::open(const std::string& path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    printf("[SphereFile] cannot open %s\n", path.c_str());
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      std::size_t(st.st_size) < sizeof(SphereFileHeader)) {
+    printf("[SphereFile] %s: too small for a header\n", path.c_str());
+    ::close(fd);
+    return false;
+  }
+  size_ = std::size_t(st.st_size);
+  void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);  // the mapping stays valid
+  if (data == MAP_FAILED) {
+    printf("[SphereFile] %s: mmap failed\n", path.c_str());
+    size_ = 0;
+    return false;
+  }
+  data_ = data;
+  madvise(data_, size_, MADV_SEQUENTIAL);
+
+  const SphereFileHeader& H = header();
+  std::size_t expected_stride = (H.flags & SPHERE_FILE_QUANTIZED)
+                                    ? sizeof(SphereRecordQ)
+                                    : sizeof(SphereRecord);
+  bool ok = std::memcmp(H.magic, SPHERE_FILE_MAGIC, 8) == 0 &&
+            H.version == SPHERE_FILE_VERSION &&
+            H.record_stride == expected_stride &&
+            H.header_size >= sizeof(SphereFileHeader) &&
+            H.header_size <= size_ &&
+            (size_ - H.header_size) / H.record_stride >= H.nb_spheres;
+  if (!ok) {
+    printf("[SphereFile] %s: invalid header (version %u)\n", path.c_str(),
+           H.version);
+    close();
+    return false;
+  }
+  flags_ = H.flags;
+  nb_spheres_ = std::size_t(H.nb_spheres);
+  stride_ = H.record_stride;
+  records_ = static_cast<const unsigned char*>(data_) + H.header_size;
+  return true;
+}
+
+void SphereFileView::get_sphere(std::size_t i, double center[3],
+                                double& radius) const {
+  const unsigned char* r = records_ + i * stride_;
+  if (!is_quantized()) {
+    const SphereRecord& R = *reinterpret_cast<const SphereRecord*>(r);
+    center[0] = R.center[0];
+    center[1] = R.center[1];
+    center[2] = R.center[2];
+    radius = R.radius;
+    return;
+  }
+  const SphereRecordQ& R = *reinterpret_cast<const SphereRecordQ*>(r);
+  const SphereFileHeader& H = header();
+  for (int k = 0; k < 3; k++)
+    center[k] = H.quant_min[k] + double(R.q[k]) * H.quant_step[k];
+  radius = H.quant_min[3] + double(R.q[3]) * H.quant_step[3];
+}
+
+SphereType SphereFileView::type(std::size_t i) const {
+  const unsigned char* r = records_ + i * stride_;
+  return SphereType(is_quantized()
+                        ? reinterpret_cast<const SphereRecordQ*>(r)->type
+                        : reinterpret_cast<const SphereRecord*>(r)->type);
+}
+
+bool save_spheres_binary(const std::vector<MedialSphere>& all_medial_spheres,
+                         const std::string& path, bool is_save_type,
+                         bool is_quantized) {
+  PROFILE_ZONE("io save_spheres_binary");
+  FILE* f = fopen(path.c_str(), "wb");
+  if (f == nullptr) {
+    printf("[SphereFile] cannot open %s\n", path.c_str());
+    return false;
+  }
+  SphereFileHeader H;
+  std::memset(&H, 0, sizeof(H));
+  std::memcpy(H.magic, SPHERE_FILE_MAGIC, 8);
+  H.version = SPHERE_FILE_VERSION;
+  H.flags = 0;
+  if (is_save_type) H.flags |= SPHERE_FILE_HAS_TYPE;
+  if (is_quantized) H.flags |= SPHERE_FILE_QUANTIZED;
+  H.nb_spheres = all_medial_spheres.size();
+  H.record_stride = is_quantized ? sizeof(SphereRecordQ) : sizeof(SphereRecord);
+  H.header_size = sizeof(SphereFileHeader);
+
+  // quantization grid: bbox of centers and range of radii
+  if (is_quantized && !all_medial_spheres.empty()) {
+    double qmax[4];
+    for (int k = 0; k < 4; k++) {
+      H.quant_min[k] = HUGE_VAL;
+      qmax[k] = -HUGE_VAL;
+    }
+    for (const auto& msphere : all_medial_spheres) {
+      const double v[4] = {msphere.center[0], msphere.center[1],
+                           msphere.center[2], msphere.radius};
+      for (int k = 0; k < 4; k++) {
+        H.quant_min[k] = std::min(H.quant_min[k], v[k]);
+        qmax[k] = std::max(qmax[k], v[k]);
+      }
+    }
+    for (int k = 0; k < 4; k++)
+      H.quant_step[k] = (qmax[k] - H.quant_min[k]) / 65535.;
+  }
+  bool ok = fwrite(&H, sizeof(H), 1, f) == 1;
+
+  // written by blocks to bound memory
+  const std::size_t block = 1 << 16;
+  std::vector<unsigned char> buffer(block * H.record_stride);
+  for (std::size_t begin = 0; ok && begin < all_medial_spheres.size();
+       begin += block) {
+    std::size_t end = std::min(begin + block, all_medial_spheres.size());
+    std::memset(buffer.data(), 0, buffer.size());
+    for (std::size_t i = begin; i < end; i++) {
+      const MedialSphere& msphere = all_medial_spheres[i];
+      std::int32_t type = is_save_type ? msphere.type : SphereType::T_UNK;
+      unsigned char* r = buffer.data() + (i - begin) * H.record_stride;
+      if (!is_quantized) {
+        SphereRecord& R = *reinterpret_cast<SphereRecord*>(r);
+        for (int k = 0; k < 3; k++) R.center[k] = msphere.center[k];
+        R.radius = msphere.radius;
+        R.type = type;
+        continue;
+      }
+      SphereRecordQ& R = *reinterpret_cast<SphereRecordQ*>(r);
+      const double v[4] = {msphere.center[0], msphere.center[1],
+                           msphere.center[2], msphere.radius};
+      for (int k = 0; k < 4; k++) {
+        double q = H.quant_step[k] == 0.
+                       ? 0.
+                       : std::round((v[k] - H.quant_min[k]) / H.quant_step[k]);
+        R.q[k] = std::uint16_t(std::min(std::max(q, 0.), 65535.));
+      }
+      R.type = type;
+    }
+    ok = fwrite(buffer.data(), H.record_stride, end - begin, f) == end - begin;
+  }
+  fclose(f);
+  if (!ok) {
+    printf("[SphereFile] %s: write failed\n", path.c_str());
+    return false;
+  }
+  printf("[SphereFile] saved %zu spheres to %s, quantized: %d\n",
+         all_medial_spheres.size(), path.c_str(), is_quantized);
+  return true;
+}
+
+bool load_spheres_binary(const std::string& path,
+                         std::vector<MedialSphere>& all_medial_spheres) {
+  PROFILE_ZONE("io load_spheres_binary");
+  SphereFileView view;
+  if (!view.open(path)) return false;
+  all_medial_spheres.clear();
+  all_medial_spheres.reserve(view.nb_spheres());
+  double center[3], radius;
+  for (std::size_t i = 0; i < view.nb_spheres(); i++) {
+    view.get_sphere(i, center, radius);
+    all_medial_spheres.emplace_back(
+        int(i), Vector3(center[0], center[1], center[2]), radius,
+        SphereType::T_2);
+    SphereType type = view.type(i);
+    if (view.has_type() && type != SphereType::T_UNK)
+      all_medial_spheres.back().type = type;
+  }
+  printf("[SphereFile] loaded %zu spheres from %s\n", view.nb_spheres(),
+         path.c_str());
+  return true;
+}
@@ -0,0 +1,118 @@
+#ifndef H_SPHERE_FILE_H
+#define H_SPHERE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "medial_sphere.h"
+
+// Binary medial sphere container (.sphb), read through mmap without parsing.
+//
+// [SphereFileHeader][record 0][record 1]...
+//
+// Records have a fixed stride (header.record_stride), either SphereRecord
+// (double precision) or, with SPHERE_FILE_QUANTIZED, SphereRecordQ where
+// each of x,y,z,radius is stored as quant_min[k] + q[k] * quant_step[k].
+// All values are little-endian, as on all platforms we build on.
+
+#define SPHERE_FILE_MAGIC "SPHBIN\0\0"
+#define SPHERE_FILE_VERSION 1
+
+enum SphereFileFlag : std::uint32_t {
+  SPHERE_FILE_HAS_TYPE = 1u << 0,   // record type is meaningful
+  SPHERE_FILE_QUANTIZED = 1u << 1,  // records are SphereRecordQ
+};
+
+struct SphereFileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t flags;
+  std::uint64_t nb_spheres;
+  std::uint32_t record_stride;  // bytes
+  std::uint32_t header_size;    // offset of the first record
+  double quant_min[4];          // x,y,z,radius, if quantized
+  double quant_step[4];
+};
+
+struct SphereRecord {
+  double center[3];
+  double radius;
+  std::int32_t type;  // SphereType
+  std::int32_t padding;
+};
+
+struct SphereRecordQ {
+  std::uint16_t q[4];  // x,y,z,radius
+  std::int32_t type;   // SphereType
+};
+
+static_assert(sizeof(SphereFileHeader) == 96, "SphereFileHeader layout");
+static_assert(sizeof(SphereRecord) == 40, "SphereRecord layout");
+static_assert(sizeof(SphereRecordQ) == 12, "SphereRecordQ layout");
+
+/**
+ * @brief Read-only memory mapped .sphb file. Records are decoded on access,
+ * nothing is parsed or copied when opening.
+ */
+class SphereFileView {
+ public:
+  SphereFileView() = default;
+  ~SphereFileView();
+  SphereFileView(const SphereFileView&) = delete;
+  SphereFileView& operator=(const SphereFileView&) = delete;
+
+  /**
+   * @brief Maps the file and checks its header, unmaps any previous file.
+   *
+   * @return false if the file cannot be mapped or is not a valid .sphb
+   */
+  bool open(const std::string& path);
+  void close();
+
+  bool is_open() const { return data_ != nullptr; }
+  std::size_t nb_spheres() const { return nb_spheres_; }
+  bool has_type() const { return flags_ & SPHERE_FILE_HAS_TYPE; }
+  bool is_quantized() const { return flags_ & SPHERE_FILE_QUANTIZED; }
+
+  // raw records, nullptr if quantized
+  const SphereRecord* records() const {
+    return is_quantized() ? nullptr
+                          : reinterpret_cast<const SphereRecord*>(records_);
+  }
+
+  void get_sphere(std::size_t i, double center[3], double& radius) const;
+  SphereType type(std::size_t i) const;
+
+ private:
+  const SphereFileHeader& header() const {
+    return *reinterpret_cast<const SphereFileHeader*>(data_);
+  }
+
+  void* data_ = nullptr;
+  std::size_t size_ = 0;
+  const unsigned char* records_ = nullptr;
+  std::size_t stride_ = 0;
+  std::size_t nb_spheres_ = 0;
+  std::uint32_t flags_ = 0;
+};
+
+/**
+ * @brief Saves spheres as .sphb, deleted spheres included (as .sph).
+ *
+ * @param is_save_type stores MedialSphere::type
+ * @param is_quantized 16 bits per coordinate and radius, relative to the
+ * bbox of the spheres
+ */
+bool save_spheres_binary(const std::vector<MedialSphere>& all_medial_spheres,
+                         const std::string& path, bool is_save_type,
+                         bool is_quantized = false);
+
+/**
+ * @brief Loads all spheres of a .sphb into MedialSphere, ids are file order.
+ */
+bool load_spheres_binary(const std::string& path,
+                         std::vector<MedialSphere>& all_medial_spheres);
+
+#endif  // H_SPHERE_FILE_H
@@ -2,16 +2,20 @@
 #define _STOPWATCH_H_
 
 #include <iostream>
-#if defined(__linux__)
-#include <sys/times.h>
-#elif defined(WIN32) || defined(_WIN64)
-#include <windows.h>
-#endif
 
+#include "profiler.h"
+
+// Prints the time of a task on destruction, and records it as a profiler
+// zone (see profiler.h) when RPD_PROFILING is defined.
 class Stopwatch {
  public:
   Stopwatch(const char* taskname)
-      : taskname_(taskname), start_(now()), last_tick_(now()) {
+      : taskname_(taskname),
+#ifdef RPD_PROFILING
+        zone_(taskname),
+#endif
+        start_(now()),
+        last_tick_(start_) {
     // std::cout << taskname_ << "..." << std::endl;
   }
 
@@ -21,26 +25,21 @@ class Stopwatch {
   }
 
   void tick(const char* tickname = "tick") {
-    double elapsed = now() - start_;
+    double t = now();
     std::cout << taskname_ << "==>" << tickname
-              << " :  delta = " << now() - last_tick_ << "s    sum= " << elapsed
+              << " :  delta = " << t - last_tick_ << "s    sum= " << t - start_
               << std::endl;
-    last_tick_ = now();
+    last_tick_ = t;
   }
 
-  static double now() {
-#if defined(__linux__)
-    tms now_tms;
-    return double(times(&now_tms)) / 100.0;
-#elif defined(WIN32) || defined(_WIN64)
-    return double(GetTickCount()) / 1000.0;
-#else
-    return 0.0;
-#endif
-  }
+  // seconds, monotonic clock with ns resolution
+  static double now() { return double(profiler::now_ns()) * 1e-9; }
 
  private:
   const char* taskname_;
+#ifdef RPD_PROFILING
+  profiler::Zone zone_;
+#endif
   double start_;
   double last_tick_;
 };
@@ -1,73 +1,215 @@
 #include "triangulation.h"
 
+#include <geogram/basic/process.h>
+
+#include <algorithm>
+
+#include "profiler.h"
+
 /**
- * @brief Given sphere + 8 bbox, we generate RT. Since some spheres may not
- * exist in RT (bcs of weights), we purge the all_medial_spheres to those valid
- * in RT.
+ * @brief Assign RT tags: spheres use tag == all_id, 8 bbox points are
+ * tagged after all spheres. Also fills tag_to_vh and nb_vertices.
  *
- * @param params provides 8 bbox info
- * @param all_medial_spheres will be updated after RT
+ * @param num_spheres number of valid spheres in RT
  * @param rt
  */
-void generate_RT_CGAL_and_purge_spheres(
-    const Parameter& params, std::vector<MedialSphere>& all_medial_spheres,
-    RegularTriangulationNN& rt) {
-  int num_spheres = all_medial_spheres.size();
-  printf("[RT] generate RT for %d spheres\n", num_spheres);
-  rt.clean();
-  // add all medial spheres
-  for (int mid = 0; mid < num_spheres; mid++) {
-    const MedialSphere& msphere = all_medial_spheres.at(mid);
-    // do not add deleted sphere in RT
-    // so later we can purge them after RT
-    if (msphere.is_deleted) continue;
-    Point_rt p(msphere.center[0], msphere.center[1], msphere.center[2]);
-    Weight weight = std::pow(msphere.radius, 2);
-    Vertex_handle_rt vh;
-    vh = rt.insert(Weighted_point(p, weight));
-    if (vh == nullptr) continue;  // THIS IS IMPORTANT
-    // update RT
-    vh->info().all_id = msphere.id;
+static void assign_RT_tags(const int num_spheres, RegularTriangulationNN& rt) {
+  int bbox_tag = num_spheres;
+  for (Finite_vertices_iterator_rt vit = rt.finite_vertices_begin();
+       vit != rt.finite_vertices_end(); vit++) {
+    Vertex_handle_rt vh = vit;
+    if (vh->info().all_id == -1)
+      vh->info().tag = bbox_tag++;
+    else
+      vh->info().tag = vh->info().all_id;
+    rt.set_tag_to_vh(vh->info().tag, vh);
   }
+  rt.set_nb_vertices(bbox_tag);
+}
 
-  // add 8 bbox, vh->info().all_id = -1
+/**
+ * @brief Inserts sphere points + 8 bbox points in RT, then assigns tags and
+ * builds the neighbor CSR.
+ *
+ * @param num_spheres number of spheres, including deleted ones (not in
+ * wpoints)
+ * @param wpoints sphere points, info().all_id is the sphere id
+ * @return old sphere id -> purged id (-1 if not in RT), empty if all
+ * spheres are in RT
+ */
+static std::vector<int> insert_spheres_RT(
+    const Parameter& params, const int num_spheres,
+    std::vector<std::pair<Weighted_point, RVI>>& wpoints,
+    RegularTriangulationNN& rt, bool is_bulk) {
+  // 8 bbox points have info().all_id = -1
   assert(params.bb_points.size() / 3 == 8);
   for (int i = 0; i < 8; i++) {
     Point_rt p(params.bb_points[i * 3], params.bb_points[i * 3 + 1],
                params.bb_points[i * 3 + 2]);
     Weight weight = SCALAR_FEATURE_RADIUS;
-    Vertex_handle_rt vh;
-    vh = rt.insert(Weighted_point(p, weight));
-    if (vh == nullptr) continue;  // THIS IS IMPORTANT
+    wpoints.push_back(std::make_pair(Weighted_point(p, weight), RVI()));
+  }
+
+  if (is_bulk) {
+    PROFILE_ZONE("RT insert");
+#ifdef CGAL_LINKED_WITH_TBB
+    // lock grid over the bbox for concurrent insertion
+    CGAL::Bbox_3 bbox;
+    for (const auto& wp : wpoints) bbox += wp.first.point().bbox();
+    Rt::Lock_data_structure locking_ds(bbox, 50);
+    rt.set_lock_data_structure(&locking_ds);
+#endif
+    // CGAL spatially sorts the range before inserting,
+    // hidden points do not create vertices
+    rt.insert(wpoints.begin(), wpoints.end());
+#ifdef CGAL_LINKED_WITH_TBB
+    rt.set_lock_data_structure(nullptr);
+#endif
+  } else {
+    PROFILE_ZONE("RT insert");
+    for (const auto& wp : wpoints) {
+      Vertex_handle_rt vh;
+      vh = rt.insert(wp.first);
+      if (vh == nullptr) continue;  // THIS IS IMPORTANT
+      // update RT
+      vh->info() = wp.second;
+    }
   }
   printf("[RT] number_of_vertices - 8: %ld, number_of_finite_edges: %ld\n",
          rt.number_of_vertices() - 8, rt.number_of_finite_edges());
   // no need to purge
-  if (num_spheres == rt.number_of_vertices() - 8) return;
+  std::vector<int> old_to_new;
+  if (num_spheres == rt.number_of_vertices() - 8) {
+    assign_RT_tags(num_spheres, rt);
+    rt.build_neighbor_csr();
+    return old_to_new;
+  }
 
   // purge non-exist RT vertices (spheres)
-  std::vector<MedialSphere> valid_medial_spheres;
+  PROFILE_ZONE("RT purge");
+  // sort valid vertices by all_id, independent of insertion order
+  std::vector<Vertex_handle_rt> valid_vhs;
+  valid_vhs.reserve(rt.number_of_vertices());
   for (Finite_vertices_iterator_rt vit = rt.finite_vertices_begin();
        vit != rt.finite_vertices_end(); vit++) {
     // skip 8 bbox points
     if (vit->info().all_id == -1) continue;
-    // start purging
-    int valid_id = valid_medial_spheres.size();
-    Vertex_handle_rt vh = vit;
-    int all_id = vh->info().all_id;
-    assert(all_id != -1);
-    MedialSphere new_msphere = all_medial_spheres.at(all_id);  // copy
+    valid_vhs.push_back(vit);
+  }
+  std::sort(valid_vhs.begin(), valid_vhs.end(),
+            [](const Vertex_handle_rt& a, const Vertex_handle_rt& b) {
+              return a->info().all_id < b->info().all_id;
+            });
+  old_to_new.assign(num_spheres, -1);
+  for (int valid_id = 0; valid_id < valid_vhs.size(); valid_id++) {
+    Vertex_handle_rt& vh = valid_vhs[valid_id];
+    assert(vh->info().all_id != -1);
+    old_to_new[vh->info().all_id] = valid_id;
     vh->info().all_id = valid_id;
-    new_msphere.id = valid_id;
-    valid_medial_spheres.push_back(new_msphere);
   }
-  all_medial_spheres.clear();
-  all_medial_spheres = valid_medial_spheres;
+  assert(valid_vhs.size() == rt.number_of_vertices() - 8);
+  assign_RT_tags(valid_vhs.size(), rt);
+  rt.build_neighbor_csr();
+  return old_to_new;
+}
+
+/**
+ * @brief Given sphere + 8 bbox, we generate RT. Since some spheres may not
+ * exist in RT (bcs of weights), we purge the all_medial_spheres to those valid
+ * in RT.
+ *
+ * Valid spheres keep their relative order (ascending all_id), so purged ids
+ * do not depend on insertion order or on CGAL vertex storage. Spheres are
+ * moved in place, not copied.
+ *
+ * @param params provides 8 bbox info
+ * @param all_medial_spheres will be updated after RT
+ * @param rt
+ * @param is_bulk true: insert all points at once, spatially sorted by CGAL
+ * (and concurrently if CGAL is linked with TBB), false: one by one in
+ * all_medial_spheres order
+ */
+void generate_RT_CGAL_and_purge_spheres(
+    const Parameter& params, std::vector<MedialSphere>& all_medial_spheres,
+    RegularTriangulationNN& rt, bool is_bulk) {
+  PROFILE_ZONE("RT build");
+  int num_spheres = all_medial_spheres.size();
+  printf("[RT] generate RT for %d spheres, is_bulk: %d\n", num_spheres,
+         is_bulk);
+  rt.clean();
+
+  // do not add deleted sphere in RT
+  // so later we can purge them after RT
+  std::vector<std::pair<Weighted_point, RVI>> wpoints;
+  wpoints.reserve(num_spheres + 8);
+  for (int mid = 0; mid < num_spheres; mid++) {
+    const MedialSphere& msphere = all_medial_spheres.at(mid);
+    if (msphere.is_deleted) continue;
+    Point_rt p(msphere.center[0], msphere.center[1], msphere.center[2]);
+    Weight weight = std::pow(msphere.radius, 2);
+    RVI info;
+    info.all_id = msphere.id;
+    wpoints.push_back(std::make_pair(Weighted_point(p, weight), info));
+  }
+
+  std::vector<int> old_to_new =
+      insert_spheres_RT(params, num_spheres, wpoints, rt, is_bulk);
+  if (old_to_new.empty()) return;
+  compact_medial_spheres(all_medial_spheres, old_to_new);
   printf("[RT] purged spheres %d->%ld, rt.number_of_vertices: %ld\n",
-         num_spheres, valid_medial_spheres.size(), rt.number_of_vertices());
+         num_spheres, all_medial_spheres.size(), rt.number_of_vertices());
   assert(all_medial_spheres.size() == rt.number_of_vertices() - 8);
 }
 
+/**
+ * @brief Build flat neighbor table (CSR) of all tagged RT vertices, so RPD
+ * does not walk CGAL circulators for every (facet, seed) pair.
+ *
+ * Adjacency is gathered from finite edges in one pass (CGAL incident
+ * queries mark cells and are not safe to run concurrently), then each row is
+ * sorted by descending tag in parallel, matching the clipping order RPD used
+ * to get from finite_adjacent_vertices + sort.
+ */
+void RegularTriangulationNN::build_neighbor_csr() {
+  PROFILE_ZONE("RT neighbor CSR");
+  const GEO::index_t n = nb_vertices;
+  nbr_patch_of.clear();
+  nbr_patches.clear();
+  nbr_offsets.assign(n + 1, 0);
+  for (Finite_edges_iterator_rt eit = finite_edges_begin();
+       eit != finite_edges_end(); ++eit) {
+    const int t0 = eit->first->vertex(eit->second)->info().tag;
+    const int t1 = eit->first->vertex(eit->third)->info().tag;
+    if (t0 < 0 || t1 < 0) continue;
+    nbr_offsets[t0 + 1]++;
+    nbr_offsets[t1 + 1]++;
+  }
+  for (GEO::index_t t = 0; t < n; t++) nbr_offsets[t + 1] += nbr_offsets[t];
+
+  nbr_handles.assign(nbr_offsets[n], Vertex_handle_rt());
+  std::vector<GEO::index_t> cursor(nbr_offsets.begin(), nbr_offsets.end() - 1);
+  for (Finite_edges_iterator_rt eit = finite_edges_begin();
+       eit != finite_edges_end(); ++eit) {
+    Vertex_handle_rt v0 = eit->first->vertex(eit->second);
+    Vertex_handle_rt v1 = eit->first->vertex(eit->third);
+    const int t0 = v0->info().tag;
+    const int t1 = v1->info().tag;
+    if (t0 < 0 || t1 < 0) continue;
+    nbr_handles[cursor[t0]++] = v1;
+    nbr_handles[cursor[t1]++] = v0;
+  }
+
+  GEO::parallel_for(0, n, [this](GEO::index_t t) {
+    std::sort(nbr_handles.begin() + nbr_offsets[t],
+              nbr_handles.begin() + nbr_offsets[t + 1],
+              [](const Vertex_handle_rt& a, const Vertex_handle_rt& b) {
+                return a->info().tag > b->info().tag;
+              });
+  });
+  printf("[RT] neighbor CSR: %d vertices, %ld adjacencies\n", nb_vertices,
+         nbr_handles.size());
+}
+
 /**
  * @brief
  *
@@ -142,4 +284,276 @@ void get_PC_vertices(const RegularTriangulationNN& rt,
     pc_vertices.push_back(Vector3(bp[0], bp[1], bp[2]));
   }
   printf("found pc_vertices: %ld\n", pc_vertices.size());
-}
\ No newline at end of file
+}
+
+/////////////////////////////////////////////////////////
+// Incremental updates
+/////////////////////////////////////////////////////////
+
+void RegularTriangulationNN::collect_neighbor_tags(const Vertex_handle_rt& vh,
+                                                   std::set<int>& tags) const {
+  std::vector<Vertex_handle_rt> one_neighs;
+  finite_adjacent_vertices(vh, std::back_inserter(one_neighs));
+  for (const auto& neigh : one_neighs) tags.insert(neigh->info().tag);
+}
+
+// 8 bbox points are re-tagged to [first_tag, first_tag + 8).
+// Only old and new bbox tags are changed: neighbor rows store handles and
+// stay sorted, bbox tags being the largest ones before and after.
+void RegularTriangulationNN::move_bbox_tags(const int first_tag,
+                                            std::set<int>& changed) {
+  const int old_first = nb_vertices - 8;
+  std::vector<Vertex_handle_rt> bbox_vhs;
+  for (int tag = old_first; tag < nb_vertices; tag++) {
+    bbox_vhs.push_back(tag_to_vh[tag]);
+    tag_to_vh[tag] = Vertex_handle_rt();
+    changed.insert(tag);
+  }
+  nb_vertices = first_tag + 8;
+  if (tag_to_vh.size() < (size_t)nb_vertices) tag_to_vh.resize(nb_vertices);
+  for (int i = 0; i < 8; i++) {
+    bbox_vhs[i]->info().tag = first_tag + i;
+    set_tag_to_vh(first_tag + i, bbox_vhs[i]);
+    changed.insert(first_tag + i);
+  }
+}
+
+void RegularTriangulationNN::reserve_sphere_tags(const int nb_tags,
+                                                 std::set<int>& changed) {
+  if (nb_tags <= nb_vertices - 8) return;
+  // empty tags in between are not in RT
+  move_bbox_tags(nb_tags + std::max(64, nb_tags / 4), changed);
+}
+
+/**
+ * @brief Insert one sphere with given tag (== all_id). Vertices hidden by
+ * the new one are removed from RT and reported in hidden.
+ *
+ * @return Vertex_handle_rt null if wp itself is hidden
+ */
+Vertex_handle_rt RegularTriangulationNN::insert_sphere(
+    const int tag, const Weighted_point& wp, std::set<int>& changed,
+    std::vector<int>& hidden) {
+  assert(!is_in_rt(tag));
+  // keep bbox tags after all sphere tags
+  reserve_sphere_tags(tag + 1, changed);
+
+  Cell_handle_rt c = locate(wp);
+  std::vector<Vertex_handle_rt> hidden_vhs;
+  vertices_inside_conflict_zone(wp, c, std::back_inserter(hidden_vhs));
+  for (const auto& hvh : hidden_vhs) {
+    const int htag = hvh->info().tag;
+    // hidden vertices were adjacent to the conflict zone
+    collect_neighbor_tags(hvh, changed);
+    hidden.push_back(htag);
+    changed.insert(htag);
+    tag_to_vh[htag] = Vertex_handle_rt();
+  }
+
+  Vertex_handle_rt vh = insert(wp, c);
+  if (vh == nullptr) return vh;  // THIS IS IMPORTANT
+  vh->info().tag = tag;
+  vh->info().all_id = tag;
+  set_tag_to_vh(tag, vh);
+  changed.insert(tag);
+  collect_neighbor_tags(vh, changed);
+  return vh;
+}
+
+void RegularTriangulationNN::remove_sphere(const int tag,
+                                           std::set<int>& changed) {
+  if (!is_in_rt(tag)) return;
+  assert(tag < nb_vertices - 8);  // never remove bbox
+  Vertex_handle_rt vh = tag_to_vh[tag];
+  collect_neighbor_tags(vh, changed);
+  changed.insert(tag);
+  tag_to_vh[tag] = Vertex_handle_rt();
+  remove(vh);
+}
+
+// removal + insertion, CGAL may return a new handle
+Vertex_handle_rt RegularTriangulationNN::move_sphere(const int tag,
+                                                     const Weighted_point& wp,
+                                                     std::set<int>& changed,
+                                                     std::vector<int>& hidden) {
+  remove_sphere(tag, changed);
+  return insert_sphere(tag, wp, changed, hidden);
+}
+
+void RegularTriangulationNN::refresh_caches(const std::set<int>& changed) {
+  // kd-tree points and tags are stale, RPD rebuilds it if missing
+  if (!changed.empty()) locator_kdtree.reset();
+
+  // seed cache
+  if (!seed_data.empty()) {
+    seed_data.resize(4 * (size_t)nb_vertices, 0.);
+    for (const int tag : changed) {
+      if (!is_in_rt(tag)) continue;
+      const Weighted_point& wp = tag_to_vh[tag]->point();
+      double* p = &seed_data[4 * (size_t)tag];
+      p[0] = CGAL::to_double(wp.x());
+      p[1] = CGAL::to_double(wp.y());
+      p[2] = CGAL::to_double(wp.z());
+      p[3] = CGAL::to_double(wp.weight());
+    }
+  }
+
+  // neighbor rows, rebuild all if too many patched rows
+  if (nbr_offsets.empty()) return;
+  if (nbr_patches.size() + changed.size() > (size_t)nb_vertices / 4) {
+    build_neighbor_csr();
+    return;
+  }
+  if (nbr_patch_of.size() < (size_t)nb_vertices)
+    nbr_patch_of.resize(nb_vertices, -1);
+  for (const int tag : changed) {
+    if (tag < 0 || tag >= nb_vertices) continue;
+    if (nbr_patch_of[tag] < 0) {
+      nbr_patch_of[tag] = nbr_patches.size();
+      nbr_patches.emplace_back();
+    }
+    std::vector<Vertex_handle_rt>& row = nbr_patches[nbr_patch_of[tag]];
+    row.clear();
+    if (!is_in_rt(tag)) continue;
+    finite_adjacent_vertices(tag_to_vh[tag], std::back_inserter(row));
+    std::sort(row.begin(), row.end(),
+              [](const Vertex_handle_rt& a, const Vertex_handle_rt& b) {
+                return a->info().tag > b->info().tag;
+              });
+  }
+}
+
+void RegularTriangulationNN::build_seed_locator() {
+  PROFILE_ZONE("RT seed locator");
+  locator_points.clear();
+  locator_tags.clear();
+  for (Finite_vertices_iterator_rt vit = finite_vertices_begin();
+       vit != finite_vertices_end(); ++vit) {
+    const Weighted_point& wp = vit->point();
+    locator_points.push_back(CGAL::to_double(wp.x()));
+    locator_points.push_back(CGAL::to_double(wp.y()));
+    locator_points.push_back(CGAL::to_double(wp.z()));
+    locator_tags.push_back(vit->info().tag);
+  }
+  locator_kdtree = GEO::NearestNeighborSearch::create(3, "BNN");
+  locator_kdtree->set_points(locator_tags.size(), locator_points.data());
+}
+
+/**
+ * @brief Greedy walk on the RT 1-skeleton. If pt is not in the power cell
+ * of vh, one of its neighbors has a strictly smaller power distance, so the
+ * walk ends in the power cell containing pt (exact predicates).
+ * Among seeds at equal power distance, returns the lowest tag as required
+ * by the symbolic perturbation.
+ *
+ * @return null handle if more than max_steps steps
+ */
+Vertex_handle_rt RegularTriangulationNN::walk_to_seed(const Point& pt,
+                                                      Vertex_handle_rt vh,
+                                                      GEO::index_t max_steps,
+                                                      GEO::index_t& nb_steps) {
+  Rt::Geom_traits::Compare_power_distance_3 cmp =
+      geom_traits().compare_power_distance_3_object();
+  for (;;) {
+    Vertex_handle_rt next = vh;
+    for (Vertex_handle_rt& n : get_neighbors(vh->info().tag)) {
+      if (cmp(pt, n->point(), next->point()) == CGAL::SMALLER) next = n;
+    }
+    if (next == vh) break;
+    vh = next;
+    if (++nb_steps > max_steps) return Vertex_handle_rt();
+  }
+  // seeds at equal power distance share a power face containing pt,
+  // so they are all neighbors of vh
+  Vertex_handle_rt lowest = vh;
+  for (Vertex_handle_rt& n : get_neighbors(vh->info().tag)) {
+    if (n->info().tag < lowest->info().tag &&
+        cmp(pt, n->point(), vh->point()) == CGAL::EQUAL)
+      lowest = n;
+  }
+  return lowest;
+}
+
+Vertex_handle_rt RegularTriangulationNN::locate_seed(
+    const double* p, Vertex_handle_rt hint, GEO::index_t max_hint_steps,
+    GEO::index_t* nb_steps) {
+  Point pt(p[0], p[1], p[2]);
+  GEO::index_t steps = 0;
+  Vertex_handle_rt result;
+  if (has_neighbor_csr()) {
+    if (hint != Vertex_handle_rt())
+      result = walk_to_seed(pt, hint, max_hint_steps, steps);
+    if (result == Vertex_handle_rt() && has_seed_locator()) {
+      int tag = locator_tags[locator_kdtree->get_nearest_neighbor(p)];
+      if (is_in_rt(tag))
+        result = walk_to_seed(pt, tag_to_vh[tag], GEO::index_t(-1), steps);
+    }
+  }
+  // no neighbor table or stale locator
+  if (result == Vertex_handle_rt()) result = nearest_power_vertex(pt);
+  if (nb_steps != nullptr) *nb_steps = steps;
+  return result;
+}
+
+/**
+ * @brief Update RT for changed spheres only, instead of clean and rebuild.
+ * Each sphere in changed_sphere_ids is
+ *   - removed if is_deleted
+ *   - inserted if new (e.g. add_new_sphere_validate)
+ *   - moved if center/radius changed (e.g. apply_perturb)
+ * Unlike generate_RT_CGAL_and_purge_spheres(), all_medial_spheres is not
+ * compacted, so tag == all_id == MedialSphere::id stays valid. Spheres hidden
+ * in RT are marked is_deleted, as they would be purged in a full rebuild.
+ *
+ * @param all_medial_spheres
+ * @param changed_sphere_ids ids of added, deleted or perturbed spheres
+ * @param rt must have been generated by generate_RT_CGAL_and_purge_spheres
+ * @param changed_tags return tags of vertices whose star changed
+ */
+void update_RT_CGAL_incremental(std::vector<MedialSphere>& all_medial_spheres,
+                                const std::vector<int>& changed_sphere_ids,
+                                RegularTriangulationNN& rt,
+                                std::set<int>& changed_tags) {
+  PROFILE_ZONE("RT update");
+  changed_tags.clear();
+  std::vector<int> hidden;
+  int num_insert = 0, num_remove = 0, num_move = 0;
+  // bbox tags are moved at most once per update
+  int nb_tags = 0;
+  for (const int id : changed_sphere_ids) {
+    if (all_medial_spheres.at(id).is_deleted) continue;
+    nb_tags = std::max(nb_tags, id + 1);
+  }
+  rt.reserve_sphere_tags(nb_tags, changed_tags);
+  for (const int id : changed_sphere_ids) {
+    MedialSphere& msphere = all_medial_spheres.at(id);
+    assert(msphere.id == id);
+    if (msphere.is_deleted) {
+      if (!rt.is_in_rt(id)) continue;
+      rt.remove_sphere(id, changed_tags);
+      num_remove++;
+      continue;
+    }
+    Point_rt p(msphere.center[0], msphere.center[1], msphere.center[2]);
+    Weighted_point wp(p, std::pow(msphere.radius, 2));
+    if (!rt.is_in_rt(id)) {
+      if (rt.insert_sphere(id, wp, changed_tags, hidden) == nullptr)
+        hidden.push_back(id);
+      num_insert++;
+    } else if (rt.get_vh(id)->point().point() != p ||
+               rt.get_vh(id)->point().weight() != wp.weight()) {
+      if (rt.move_sphere(id, wp, changed_tags, hidden) == nullptr)
+        hidden.push_back(id);
+      num_move++;
+    }
+  }
+  for (const int id : hidden) {
+    if (id < (int)all_medial_spheres.size())
+      all_medial_spheres[id].is_deleted = true;
+  }
+  rt.refresh_caches(changed_tags);
+  printf(
+      "[RT] incremental: inserted %d, removed %d, moved %d, hidden %ld, "
+      "star changed %ld\n",
+      num_insert, num_remove, num_move, hidden.size(), changed_tags.size());
+}
@@ -5,9 +5,11 @@
 #include <CGAL/Regular_triangulation_cell_base_3.h>
 #include <CGAL/Regular_triangulation_vertex_base_3.h>
 #include <CGAL/Triangulation_3.h>
+#include <CGAL/Triangulation_cell_base_3.h>
 #include <CGAL/Triangulation_cell_base_with_info_3.h>
 #include <CGAL/Triangulation_vertex_base_with_info_3.h>
 #include <geogram/delaunay/periodic_delaunay_3d.h>
+#include <geogram/points/nn_search.h>
 
 #include "medial_sphere.h"
 #include "params.h"
@@ -37,9 +39,19 @@ typedef Kf::Weighted_point_3 Weighted_point;
 
 typedef CGAL::Regular_triangulation_vertex_base_3<Kf> Vb0_rt;
 typedef CGAL::Triangulation_vertex_base_with_info_3<RVI, Kf, Vb0_rt> Vb_rt;
-typedef CGAL::Regular_triangulation_cell_base_3<Kf> Cb0_rt;
+// hidden points are discarded: a sphere hidden in RT is purged, so removing
+// a vertex must not re-insert it (without info) in incremental updates
+typedef CGAL::Regular_triangulation_cell_base_3<
+    Kf, CGAL::Triangulation_cell_base_3<Kf>, CGAL::Discard_hidden_points>
+    Cb0_rt;
 typedef CGAL::Triangulation_cell_base_with_info_3<RTI, Kf, Cb0_rt> Cb_rt;
+#ifdef CGAL_LINKED_WITH_TBB
+// allows concurrent bulk insertion, see generate_RT_CGAL_and_purge_spheres()
+typedef CGAL::Triangulation_data_structure_3<Vb_rt, Cb_rt, CGAL::Parallel_tag>
+    Tds_rt;
+#else
 typedef CGAL::Triangulation_data_structure_3<Vb_rt, Cb_rt> Tds_rt;
+#endif
 typedef CGAL::Regular_triangulation_3<Kf, Tds_rt> Rt;
 typedef CGAL::Triangulation_3<Kf, Tds_rt> Tr;
 
@@ -57,6 +69,23 @@ typedef Rt::Finite_edges_iterator Finite_edges_iterator_rt;
 typedef Rt::Finite_vertices_iterator Finite_vertices_iterator_rt;
 typedef Rt::Tetrahedron Tetrahedron_rt;
 
+// Non-owning view of one row of RegularTriangulationNN neighbor CSR
+class RTNeighborRange {
+ public:
+  RTNeighborRange() : begin_(nullptr), end_(nullptr) {}
+  RTNeighborRange(Vertex_handle_rt* b, Vertex_handle_rt* e)
+      : begin_(b), end_(e) {}
+
+  inline GEO::index_t size() const { return GEO::index_t(end_ - begin_); }
+  inline Vertex_handle_rt& operator[](GEO::index_t i) { return begin_[i]; }
+  inline Vertex_handle_rt* begin() { return begin_; }
+  inline Vertex_handle_rt* end() { return end_; }
+
+ private:
+  Vertex_handle_rt* begin_;
+  Vertex_handle_rt* end_;
+};
+
 ///////////////
 class RegularTriangulationNN : public Rt, public GEO::Counted {
  public:
@@ -71,6 +100,13 @@ class RegularTriangulationNN : public Rt, public GEO::Counted {
   inline void clean() {
     this->clear();
     tag_to_vh.clear();
+    seed_data.clear();
+    nbr_offsets.clear();
+    nbr_handles.clear();
+    nbr_patch_of.clear();
+    nbr_patches.clear();
+    locator_kdtree.reset();
+    locator_tags.clear();
     nb_vertices = 0;
   }
 
@@ -109,20 +145,22 @@ class RegularTriangulationNN : public Rt, public GEO::Counted {
     if (tag_to_vh.empty()) {
       printf("tag_to_vh cannot be empty\n");
       assert(false);
-    } else if (tag_to_vh.find(tag) == tag_to_vh.end()) {
+    } else if (tag >= tag_to_vh.size() ||
+               tag_to_vh[tag] == Vertex_handle_rt()) {
       printf("tag %d cannot be found at tag_to_vh \n", tag);
       printf("tag not match tag_to_vh value\n");
       assert(false);
-    } else if (tag != tag_to_vh.at(tag)->info().tag) {
-      printf("tag %d has tag_to_vh %d \n", tag, tag_to_vh.at(tag)->info().tag);
+    } else if (tag != tag_to_vh[tag]->info().tag) {
+      printf("tag %d has tag_to_vh %d \n", tag, tag_to_vh[tag]->info().tag);
       printf("tag not match tag_to_vh value\n");
       assert(false);
-    } else
-      return tag_to_vh.at(tag);
+    }
+    return tag_to_vh[tag];
   };
 
   inline void set_tag_to_vh(int tag, Vertex_handle_rt& vh) {
-    tag_to_vh.insert(std::pair<int, Vertex_handle_rt>(tag, vh));
+    if (tag >= (int)tag_to_vh.size()) tag_to_vh.resize(tag + 1);
+    tag_to_vh[tag] = vh;
   }
 
   inline std::vector<double> get_double_vector(const Weighted_point& wp) const {
@@ -181,6 +219,112 @@ class RegularTriangulationNN : public Rt, public GEO::Counted {
   };
   /////////////////////////////////////////////////////////
 
+  /////////////////////////////////////////////////////////
+  ///// Seed cache
+  ///// contiguous (x,y,z,w) per tag, built by the first RPD computation
+  ///// after RT generation and patched by refresh_caches(), so clipping
+  ///// never touches tag_to_vh or allocates
+
+  inline void build_seed_cache() {
+    seed_data.assign(4 * (size_t)nb_vertices, 0.);
+    for (Finite_vertices_iterator_rt vit = finite_vertices_begin();
+         vit != finite_vertices_end(); ++vit) {
+      const int tag = vit->info().tag;
+      if (tag < 0) continue;
+      assert(tag < nb_vertices);
+      const Weighted_point& wp = vit->point();
+      double* p = &seed_data[4 * (size_t)tag];
+      p[0] = CGAL::to_double(wp.x());
+      p[1] = CGAL::to_double(wp.y());
+      p[2] = CGAL::to_double(wp.z());
+      p[3] = CGAL::to_double(wp.weight());
+    }
+  }
+
+  inline bool has_seed_cache() const {
+    return seed_data.size() == 4 * (size_t)nb_vertices;
+  }
+
+  // pointer to (x,y,z,w), valid until next build_seed_cache()/clean()
+  inline const double* seed_point(const GEO::index_t tag) const {
+    geo_debug_assert(4 * (size_t)tag < seed_data.size());
+    return &seed_data[4 * (size_t)tag];
+  }
+
+  inline double seed_weight(const GEO::index_t tag) const {
+    geo_debug_assert(4 * (size_t)tag + 3 < seed_data.size());
+    return seed_data[4 * (size_t)tag + 3];
+  }
+
+  /////////////////////////////////////////////////////////
+  ///// Neighbor CSR
+  ///// finite RT neighbors of each tag, sorted by descending tag
+  ///// (the order RPD clips bisectors in), see build_neighbor_csr()
+
+  void build_neighbor_csr();
+
+  inline bool has_neighbor_csr() const {
+    // tags beyond the CSR are patched by refresh_caches()
+    return !nbr_offsets.empty() &&
+           (nbr_offsets.size() >= (size_t)nb_vertices + 1 ||
+            nbr_patch_of.size() >= (size_t)nb_vertices);
+  }
+
+  inline RTNeighborRange get_neighbors(const GEO::index_t tag) {
+    // rows updated incrementally, see refresh_caches()
+    if (tag < nbr_patch_of.size() && nbr_patch_of[tag] >= 0) {
+      std::vector<Vertex_handle_rt>& row = nbr_patches[nbr_patch_of[tag]];
+      return RTNeighborRange(row.data(), row.data() + row.size());
+    }
+    Vertex_handle_rt* base = nbr_handles.data();
+    // tags beyond the CSR and never patched are not in RT
+    if (tag + 1 >= nbr_offsets.size()) return RTNeighborRange(base, base);
+    return RTNeighborRange(base + nbr_offsets[tag],
+                           base + nbr_offsets[tag + 1]);
+  }
+
+  /////////////////////////////////////////////////////////
+  ///// Seed location
+  ///// power cell containing a point, by walking the neighbor CSR from a
+  ///// hint, kd-tree over seed centers gives the start when no hint
+
+  void build_seed_locator();
+
+  inline bool has_seed_locator() const { return !locator_kdtree.is_null(); }
+
+  // if hint walk exceeds max_hint_steps, restart from the kd-tree
+  // nb_steps (optional) returns the number of walk steps
+  Vertex_handle_rt locate_seed(const double* p, Vertex_handle_rt hint,
+                               GEO::index_t max_hint_steps = 32,
+                               GEO::index_t* nb_steps = nullptr);
+
+  /////////////////////////////////////////////////////////
+  ///// Incremental updates
+  ///// tag == all_id for spheres, 8 bbox tags always after all sphere tags.
+  ///// changed: tags of vertices whose star changed (incl. removed ones)
+  ///// hidden: tags of vertices hidden (removed) by an insertion
+
+  // makes room for sphere tags [0, nb_tags), bbox tags are moved with some
+  // headroom so that appending spheres rarely moves them again
+  void reserve_sphere_tags(const int nb_tags, std::set<int>& changed);
+
+  Vertex_handle_rt insert_sphere(const int tag, const Weighted_point& wp,
+                                 std::set<int>& changed,
+                                 std::vector<int>& hidden);
+  void remove_sphere(const int tag, std::set<int>& changed);
+  Vertex_handle_rt move_sphere(const int tag, const Weighted_point& wp,
+                               std::set<int>& changed,
+                               std::vector<int>& hidden);
+
+  // update seed cache and neighbor rows of changed tags only, drop the
+  // seed locator; RPD builds missing caches and locator
+  void refresh_caches(const std::set<int>& changed);
+
+  inline bool is_in_rt(const int tag) const {
+    return tag >= 0 && tag < (int)tag_to_vh.size() &&
+           tag_to_vh[tag] != Vertex_handle_rt();
+  }
+
   inline double get_weight(const Weighted_point& wp) const {
     return CGAL::to_double(wp.weight());
   }
@@ -190,11 +334,34 @@ class RegularTriangulationNN : public Rt, public GEO::Counted {
   }
 
  protected:
-  // vertex tag -> vertex handle
-  std::map<int, Vertex_handle_rt> tag_to_vh;
+  // vertex tag -> vertex handle, indexed by tag
+  std::vector<Vertex_handle_rt> tag_to_vh;
 
   // nb_vertices >= number_of_vertices()
-  int nb_vertices;
+  int nb_vertices = 0;
+
+  // seed cache, size 4 * nb_vertices, see build_seed_cache()
+  std::vector<double> seed_data;
+
+  // neighbors of tag t are nbr_handles[nbr_offsets[t], nbr_offsets[t+1])
+  // unless nbr_patch_of[t] >= 0, then nbr_patches[nbr_patch_of[t]]
+  std::vector<GEO::index_t> nbr_offsets;
+  std::vector<Vertex_handle_rt> nbr_handles;
+  std::vector<int> nbr_patch_of;
+  std::vector<std::vector<Vertex_handle_rt>> nbr_patches;
+
+  // kd-tree over centers of seeds in RT, point i has tag locator_tags[i]
+  GEO::NearestNeighborSearch_var locator_kdtree;
+  std::vector<double> locator_points;
+  std::vector<int> locator_tags;
+
+ private:
+  Vertex_handle_rt walk_to_seed(const Point& pt, Vertex_handle_rt vh,
+                                GEO::index_t max_steps,
+                                GEO::index_t& nb_steps);
+  void collect_neighbor_tags(const Vertex_handle_rt& vh,
+                             std::set<int>& tags) const;
+  void move_bbox_tags(const int first_tag, std::set<int>& changed);
 };
 
 /**
@@ -204,7 +371,12 @@ typedef GEO::SmartPointer<RegularTriangulationNN> RegularTriangulationNN_var;
 
 void generate_RT_CGAL_and_purge_spheres(
     const Parameter& params, std::vector<MedialSphere>& all_medial_spheres,
-    RegularTriangulationNN& rt);
+    RegularTriangulationNN& rt, bool is_bulk = true);
+
+void update_RT_CGAL_incremental(std::vector<MedialSphere>& all_medial_spheres,
+                                const std::vector<int>& changed_sphere_ids,
+                                RegularTriangulationNN& rt,
+                                std::set<int>& changed_tags);
 
 int get_RT_vertex_neighbors(const RegularTriangulationNN& rt, const int& n_site,
                             std::vector<int>& site_knn);